@@ -0,0 +1,80 @@
+#!/bin/sh
+#
+# Cache simulator miss-ratio curve checks
+# CSF Assignment 3
+#
+# Checks csim mrc against itself and the LRU simulator:
+#  - sampling at rate 1 gives the exact curve, with no error
+#  - the exact curve gives the misses of the LRU simulator
+#  - sampling at a low rate either says n/a or covers the exact curve
+# Usage: sh check_mrc.sh [path to csim]
+
+CSIM=${1:-./csim}
+TMP=${TMPDIR:-/tmp}/check_mrc.$$
+mkdir -p "$TMP" || exit 1
+trap 'rm -rf "$TMP"' EXIT
+failures=0
+
+fail() {
+    echo "FAIL: $*"
+    failures=$((failures + 1))
+}
+
+# rows of a curve as "blocks ratio error" (error 0 if exact)
+curve() {
+    "$CSIM" mrc "$@" | awk 'NR > 1 && $1 ~ /^[0-9]+$/ { print $2, $7, (NF > 7 ? $8 : 0) }'
+}
+
+# every row of a sampled curve either says n/a or lies within its error of the exact one
+covers() {
+    awk 'NR == FNR { exact[$1] = $2; next }
+         $2 == "n/a" { next }
+         !($1 in exact) { next }
+         { d = $2 - exact[$1]; if (d < 0) d = -d; if (d > $3 + 1e-6) { print $1; bad = 1 } }
+         END { exit bad }' "$1" "$2"
+}
+
+# a random trace of 200000 accesses, mostly to blocks never seen again
+awk 'BEGIN { srand(1); for (i = 0; i < 200000; i++)
+             printf "%s 0x%x 0\n", (rand() < 0.5 ? "l" : "s"), int(rand() * 4194304) * 4 }' > "$TMP/random.trace"
+
+for trace in read01.trace read02.trace read03.trace write01.trace write02.trace; do
+    [ -f "$trace" ] || continue
+    for sets in 1 2 4 16; do
+        curve --sets $sets 16 < "$trace" > "$TMP/exact"
+
+        # rate 1 samples every block
+        curve --sets $sets --rate 1 16 < "$trace" > "$TMP/rate1"
+        if ! awk 'NR == FNR { exact[$1] = $2; next }
+                  $2 != exact[$1] || $3 + 0 != 0 { exit 1 }' "$TMP/exact" "$TMP/rate1"; then
+            fail "$trace, $sets sets: rate 1 differs from the exact curve"
+        fi
+
+        # the LRU simulator agrees on every row (traces whose accesses stay within a block)
+        while read blocks ratio error; do
+            "$CSIM" $sets $blocks 16 write-allocate write-back lru < "$trace" > "$TMP/lru"
+            grep -q "Split accesses" "$TMP/lru" && continue
+            if ! awk -v ratio="$ratio" '/Total loads|Total stores/ { n += $3 }
+                                         /Load misses|Store misses/ { m += $3 }
+                                         END { d = m / n - ratio; exit (d > 1e-6 || d < -1e-6) }' "$TMP/lru"; then
+                fail "$trace, $sets sets, $blocks blocks: the LRU simulator disagrees"
+            fi
+        done < "$TMP/exact"
+
+        # a tenth of a tiny trace is too little to estimate from
+        curve --sets $sets --rate 0.1 16 < "$trace" > "$TMP/low"
+        covers "$TMP/exact" "$TMP/low" > /dev/null || fail "$trace, $sets sets: rate 0.1 misses the exact curve"
+    done
+done
+
+for sets in 1 256; do
+    curve --sets $sets 16 < "$TMP/random.trace" > "$TMP/exact"
+    curve --sets $sets --rate 0.005 16 < "$TMP/random.trace" > "$TMP/low"
+    covers "$TMP/exact" "$TMP/low" > /dev/null || fail "random trace, $sets sets: rate 0.005 misses the exact curve"
+done
+
+if [ $failures -gt 0 ]; then
+    echo "$failures mrc checks failed"
+    exit 1
+fi
+echo "mrc checks passed"
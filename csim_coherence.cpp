@@ -0,0 +1,389 @@
+/*
+ * Cache simulator multicore coherence
+ * CSF Assignment 3
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <stdlib.h>
+#include <unistd.h>
+#include "csim_coherence.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using namespace std;
+
+/*
+ * Reads a coherence file. It holds the lines of a hierarchy file, the
+ * first level being the private cache of every core (which must be
+ * write-allocate and write-back) and the others shared, plus:
+ *  cores N
+ *  protocol mesi|moesi
+ * Blank lines and lines starting with '#' are ignored.
+ *
+ * Parameters:
+ *  path - file to read
+ *  config - receives the system
+ *
+ * Returns:
+ *  true if successful
+ *  false if the file could not be read or is invalid
+ */
+bool read_coherence_file(const char * path, CoherenceConfig & config) {
+    ifstream in(path);
+    if (!in) {
+        cerr << "Could not read coherence file " << path << endl;
+        return false;
+    }
+
+    HierarchyConfig levels;
+    string line;
+    int line_no = 0;
+    while (getline(in, line)) {
+        line_no++;
+        stringstream ss(line);
+        vector<string> fields;
+        string field;
+        while (ss >> field) {
+            fields.push_back(field);
+        }
+        if (fields.empty() || fields[0][0] == '#') {
+            continue;
+        }
+
+        bool ok;
+        if (fields[0] == "cores") {
+            config.n_cores = fields.size() == 2 ? atoi(fields[1].c_str()) : 0;
+            ok = config.n_cores >= 1 && config.n_cores <= COHERENCE_MAX_CORES;
+        } else if (fields[0] == "protocol") {
+            ok = fields.size() == 2 && (fields[1] == "mesi" || fields[1] == "moesi");
+            config.protocol = ok && fields[1] == "moesi" ? PROTOCOL_MOESI : PROTOCOL_MESI;
+        } else {
+            ok = parse_hierarchy_line(fields, levels);
+        }
+        if (!ok) {
+            cerr << "Invalid coherence line " << line_no << endl;
+            return false;
+        }
+    }
+
+    if (levels.levels.empty()) {
+        cerr << "Coherence file " << path << " has no private level" << endl;
+        return false;
+    }
+    config.private_level = levels.levels[0];
+    config.shared.levels.assign(levels.levels.begin() + 1, levels.levels.end());
+    config.shared.memory_latency = levels.memory_latency;
+
+    const CacheConfig & cache = config.private_level.cache;
+    if (!cache.is_write_allocate || cache.is_write_through) {
+        cerr << "Private level must be write-allocate and write-back" << endl;
+        return false;
+    }
+    for (size_t i = 0; i < levels.levels.size(); i++) {
+        if (levels.levels[i].is_instruction) {
+            cerr << "Coherence files cannot split levels" << endl;
+            return false;
+        }
+        if (levels.levels[i].prefetch != PREFETCH_NONE) { // the cores share no clock to time prefetches by
+            cerr << "Coherence files cannot prefetch" << endl;
+            return false;
+        }
+    }
+    return config.shared.levels.empty() || check_hierarchy(config.shared);
+}
+
+/*
+ * Constructs a CoherentSystem object.
+ *
+ * Parameters:
+ *  config - the cores, protocol and levels
+ *
+ * Returns:
+ *  a new CoherentSystem object
+ */
+CoherentSystem::CoherentSystem(const CoherenceConfig & config) : shared(config.shared) {
+    this->protocol = config.protocol;
+    this->private_config = config.private_level;
+
+    cores.reserve(config.n_cores);
+    for (int i = 0; i < config.n_cores; i++) {
+        cores.push_back(CacheSimulator(private_config.cache));
+    }
+    touched.resize(config.n_cores);
+}
+
+/*
+ * Returns the parts of a block (one bit per 1/64th) an access touches.
+ *
+ * Parameters:
+ *  address - first byte accessed
+ *  size - bytes accessed (0 if unknown, counted as 1)
+ */
+uint64_t CoherentSystem::touch_mask(uint64_t address, uint32_t size) {
+    uint32_t block_size = private_config.cache.block_size;
+    uint32_t offset = (uint32_t) (address & (block_size - 1));
+    uint32_t last = offset + (size > 0 ? size : 1) - 1;
+    if (last >= block_size) { // the access runs into the next block; count this block's part
+        last = block_size - 1;
+    }
+
+    // scale byte offsets to 64 parts (small blocks give each byte several parts)
+    uint32_t first_part = (uint32_t) ((uint64_t) offset * 64 / block_size);
+    uint32_t last_part = (uint32_t) (((uint64_t) last + 1) * 64 / block_size) - 1;
+    uint64_t high = last_part == 63 ? ~(uint64_t) 0 : ((uint64_t) 1 << (last_part + 1)) - 1;
+    return high & ~(((uint64_t) 1 << first_part) - 1);
+}
+
+/*
+ * Removes every copy of a block except one core's, counting
+ * invalidations and false sharing.
+ *
+ * Parameters:
+ *  entry - directory entry of the block
+ *  block - address of the block
+ *  core - core keeping its copy (the writer)
+ *  mask - parts of the block the writer touches
+ *
+ * Returns:
+ *  cycles spent
+ */
+uint64_t CoherentSystem::invalidate_others(DirectoryEntry & entry, uint64_t block, int core, uint64_t mask) {
+    uint64_t others = entry.sharers & ~((uint64_t) 1 << core);
+    if (others == 0) {
+        return 0;
+    }
+
+    while (others != 0) {
+        int other = __builtin_ctzll(others);
+        others &= others - 1;
+
+        bool was_dirty; // the directory knows the state; dirty data moves to the writer
+        cores[other].invalidate_block(block, was_dirty);
+        stats.invalidations++;
+
+        unordered_map<uint64_t, uint64_t>::iterator parts = touched[other].find(block);
+        if (parts != touched[other].end()) {
+            if ((parts->second & mask) == 0) { // the copy was only lost to block granularity
+                stats.false_sharing++;
+            }
+            touched[other].erase(parts);
+        }
+    }
+    entry.sharers &= (uint64_t) 1 << core;
+    return private_config.latency; // wait for the acknowledgements
+}
+
+/*
+ * Places a block in a core's private cache and drops the core's
+ * victim from the directory, writing it back if dirty.
+ *
+ * Parameters:
+ *  core - core whose cache to fill
+ *  block - address of the block
+ *
+ * Returns:
+ *  cycles spent
+ */
+uint64_t CoherentSystem::fill(int core, uint64_t block) {
+    Eviction victim = cores[core].fill_block(block, false);
+    if (!victim.is_valid) {
+        return 0;
+    }
+
+    touched[core].erase(victim.address);
+    unordered_map<uint64_t, DirectoryEntry>::iterator it = directory.find(victim.address);
+    if (it == directory.end()) {
+        return 0;
+    }
+    DirectoryEntry & entry = it->second;
+    uint64_t cycles = 0;
+    entry.sharers &= ~((uint64_t) 1 << core);
+    if (entry.owner == core) {
+        if (entry.owner_state == STATE_MODIFIED || entry.owner_state == STATE_OWNED) {
+            stats.writebacks++;
+            cycles = shared.write_back(0, victim.address);
+        }
+        entry.owner = -1; // any remaining copies are shared
+    }
+    if (entry.sharers == 0) {
+        directory.erase(it);
+    }
+    return cycles;
+}
+
+/*
+ * Load an address.
+ *
+ * Parameters:
+ *  core - core making the access
+ *  address - the address in main memory to load
+ *  size - bytes accessed (0 if unknown)
+ */
+void CoherentSystem::load(int core, uint64_t address, uint32_t size) {
+    CacheSimulator & cache = cores[core];
+    uint64_t block = address & ~(uint64_t) (private_config.cache.block_size - 1);
+    uint64_t mask = touch_mask(address, size);
+    uint64_t cycles = private_config.latency;
+    cache.total_loads++;
+
+    if (cache.access_block(address, false)) { // hit in any state
+        cache.total_load_hits++;
+        touched[core][block] |= mask;
+    } else {
+        cache.total_load_misses++;
+        stats.bus_reads++;
+
+        DirectoryEntry & entry = directory[block];
+        if (entry.owner >= 0) { // the owner answers, then shares the block
+            stats.interventions++;
+            cycles += private_config.latency;
+            if (entry.owner_state == STATE_MODIFIED && protocol == PROTOCOL_MOESI) {
+                entry.owner_state = STATE_OWNED; // keeps answering for the dirty block
+            } else if (entry.owner_state == STATE_MODIFIED) {
+                stats.writebacks++; // MESI cannot share dirty data
+                cycles += shared.write_back(0, block);
+                entry.owner = -1;
+            } else if (entry.owner_state == STATE_EXCLUSIVE) {
+                entry.owner = -1;
+            }
+        } else { // clean in memory
+            bool dirty;
+            cycles += shared.access(shared.data_level, address, false, dirty);
+        }
+
+        if (entry.sharers == 0) { // nobody else holds it
+            entry.owner = core;
+            entry.owner_state = STATE_EXCLUSIVE;
+        }
+        entry.sharers |= (uint64_t) 1 << core;
+        touched[core][block] = mask;
+        cycles += fill(core, block);
+    }
+
+    cache.total_cycles += cycles;
+    total_cycles += cycles;
+}
+
+/*
+ * Store an address.
+ *
+ * Parameters:
+ *  core - core making the access
+ *  address - the address in main memory to store
+ *  size - bytes accessed (0 if unknown)
+ */
+void CoherentSystem::store(int core, uint64_t address, uint32_t size) {
+    CacheSimulator & cache = cores[core];
+    uint64_t block = address & ~(uint64_t) (private_config.cache.block_size - 1);
+    uint64_t mask = touch_mask(address, size);
+    uint64_t cycles = private_config.latency;
+    cache.total_stores++;
+
+    bool is_hit = cache.access_block(address, false);
+    DirectoryEntry & entry = directory[block];
+    if (is_hit) {
+        cache.total_store_hits++;
+        if (entry.owner != core || entry.owner_state == STATE_OWNED) { // shared or owned: upgrade
+            stats.upgrades++;
+            cycles += invalidate_others(entry, block, core, mask);
+        }
+        // exclusive becomes modified silently
+        touched[core][block] |= mask;
+    } else {
+        cache.total_store_misses++;
+        stats.bus_read_exclusives++;
+        if (entry.owner >= 0) { // the owner hands the block over
+            stats.interventions++;
+            cycles += private_config.latency;
+        } else { // read for ownership
+            bool dirty;
+            cycles += shared.access(shared.data_level, address, false, dirty);
+        }
+        cycles += invalidate_others(entry, block, core, mask);
+        entry.sharers |= (uint64_t) 1 << core;
+        touched[core][block] = mask;
+    }
+    entry.owner = core;
+    entry.owner_state = STATE_MODIFIED;
+    if (!is_hit) {
+        cycles += fill(core, block);
+    }
+
+    cache.total_cycles += cycles;
+    total_cycles += cycles;
+}
+
+/*
+ * Simulates a batch of accesses. Core numbers are taken modulo the
+ * number of cores, and instruction fetches count as loads.
+ *
+ * Parameters:
+ *  accesses - first access to simulate
+ *  n - number of accesses
+ */
+void CoherentSystem::replay(const Access * accesses, size_t n) {
+    int n_cores = cores.size();
+    for (size_t i = 0; i < n; i++) {
+        const Access & access = accesses[i];
+        if (access.op == ACCESS_STORE) { // operation: store
+            store(access.core % n_cores, access.address, access.size);
+        } else { // operation: load or instruction fetch
+            load(access.core % n_cores, access.address, access.size);
+        }
+    }
+}
+
+/*
+ * Prints statistics of every core, the coherence traffic, then the
+ * statistics of the shared levels and memory.
+ */
+void CoherentSystem::print_counts() {
+    for (size_t i = 0; i < cores.size(); i++) {
+        string prefix = "Core" + to_string(i) + " " + private_config.name + " ";
+        cores[i].print_counts(cout, prefix.c_str());
+    }
+    cout << "Bus reads: " << stats.bus_reads << endl;
+    cout << "Bus read-exclusives: " << stats.bus_read_exclusives << endl;
+    cout << "Upgrades: " << stats.upgrades << endl;
+    cout << "Invalidations: " << stats.invalidations << endl;
+    cout << "Interventions: " << stats.interventions << endl;
+    cout << "False sharing: " << stats.false_sharing << endl;
+    cout << "Private writebacks: " << stats.writebacks << endl;
+    shared.print_level_counts(cout);
+    cout << "Total cycles: " << total_cycles << endl;
+}
+
+/*
+ * Simulates the multicore system described by a file against the trace
+ * on stdin, whose accesses carry core numbers.
+ * Usage: csim coherence FILE
+ *
+ * Returns:
+ *  0 if the simulation was successful
+ *  1 if the simulation was unsuccessful
+ */
+int coherence_main(int argc, char * argv[]) {
+    if (argc != 3) {
+        cerr << "Invalid arguments" << endl;
+        return 1;
+    }
+
+    CoherenceConfig config;
+    if (!read_coherence_file(argv[2], config)) {
+        return 1;
+    }
+    CoherentSystem system(config);
+
+    bool ok = replay_trace(STDIN_FILENO, [&system](const Access * accesses, size_t n) {
+        system.replay(accesses, n);
+    });
+    if (!ok) {
+        return 1;
+    }
+    system.print_counts();
+    return 0;
+}
@@ -0,0 +1,189 @@
+/*
+ * Cache simulator multicore coherence
+ * CSF Assignment 3
+ */
+
+#ifndef __CSIM_COHERENCE_H__
+#define __CSIM_COHERENCE_H__
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include "csim_hierarchy.h"
+
+// coherence protocols
+#define PROTOCOL_MESI 0
+#define PROTOCOL_MOESI 1
+
+// cores are tracked in 64-bit sharer masks
+#define COHERENCE_MAX_CORES 64
+
+// coherence states of a block held by a core (a core that does not hold it is invalid)
+#define STATE_SHARED 0    // clean, maybe held by others too
+#define STATE_EXCLUSIVE 1 // clean, held by no other core
+#define STATE_OWNED 2     // dirty, shared with others; this core answers for it (MOESI only)
+#define STATE_MODIFIED 3  // dirty, held by no other core
+
+// a multicore system, as given in a coherence file
+struct CoherenceConfig {
+    int n_cores = 1;
+    int protocol = PROTOCOL_MESI;
+    LevelConfig private_level; // cache every core has for itself
+    HierarchyConfig shared;    // levels shared by all cores, and memory
+};
+
+/*
+ * Reads a coherence file. It holds the lines of a hierarchy file, the
+ * first level being the private cache of every core (which must be
+ * write-allocate and write-back) and the others shared, plus:
+ *  cores N
+ *  protocol mesi|moesi
+ * Blank lines and lines starting with '#' are ignored.
+ *
+ * Parameters:
+ *  path - file to read
+ *  config - receives the system
+ *
+ * Returns:
+ *  true if successful
+ *  false if the file could not be read or is invalid
+ */
+bool read_coherence_file(const char * path, CoherenceConfig & config);
+
+// directory entry of a block held by at least one private cache
+struct DirectoryEntry {
+    uint64_t sharers = 0;           // cores holding the block, in any state
+    int owner = -1;                 // core holding it exclusive, owned or modified (-1 if all share it)
+    int owner_state = STATE_SHARED; // state of the owner's copy
+};
+
+// coherence traffic of a multicore system
+struct CoherenceStats {
+    uint64_t bus_reads = 0;           // read misses broadcast to the other cores
+    uint64_t bus_read_exclusives = 0; // write misses broadcast to the other cores
+    uint64_t upgrades = 0;            // writes to shared or owned blocks, which invalidate the other copies
+    uint64_t invalidations = 0;       // copies removed from other cores
+    uint64_t interventions = 0;       // misses served by another core's exclusive, owned or modified copy
+    uint64_t false_sharing = 0;       // invalidations of copies whose bytes the writer did not touch
+    uint64_t writebacks = 0;          // dirty blocks written from a private cache to the shared levels
+};
+
+/*
+ * Private caches of several cores, kept coherent by a directory with the
+ * MESI or MOESI protocol, in front of shared levels. The directory knows
+ * the state of every privately held block; the private CacheSimulators
+ * only track which blocks they hold and their replacement order.
+ *
+ * A miss that another core can answer costs the private latency
+ * (a cache-to-cache transfer) instead of a trip to the shared levels.
+ * Invalidating other copies costs the private latency once.
+ * To detect false sharing, each core remembers which 1/64ths of each
+ * block it has accessed since it obtained the block.
+ */
+class CoherentSystem {
+public:
+    int protocol;
+    LevelConfig private_config; // configuration of every private cache
+    std::vector<CacheSimulator> cores; // private cache of every core
+    CacheHierarchy shared; // shared levels and memory
+    std::unordered_map<uint64_t, DirectoryEntry> directory; // privately held blocks
+    std::vector< std::unordered_map<uint64_t, uint64_t> > touched; // per core, parts of each block it accessed
+    CoherenceStats stats;
+    uint64_t total_cycles = 0;
+
+    /*
+     * Constructs a CoherentSystem object.
+     *
+     * Parameters:
+     *  config - the cores, protocol and levels
+     *
+     * Returns:
+     *  a new CoherentSystem object
+     */
+    explicit CoherentSystem(const CoherenceConfig & config);
+
+    /*
+     * Load an address.
+     *
+     * Parameters:
+     *  core - core making the access
+     *  address - the address in main memory to load
+     *  size - bytes accessed (0 if unknown)
+     */
+    void load(int core, uint64_t address, uint32_t size);
+
+    /*
+     * Store an address.
+     *
+     * Parameters:
+     *  core - core making the access
+     *  address - the address in main memory to store
+     *  size - bytes accessed (0 if unknown)
+     */
+    void store(int core, uint64_t address, uint32_t size);
+
+    /*
+     * Simulates a batch of accesses. Core numbers are taken modulo the
+     * number of cores, and instruction fetches count as loads.
+     *
+     * Parameters:
+     *  accesses - first access to simulate
+     *  n - number of accesses
+     */
+    void replay(const Access * accesses, size_t n);
+
+    /*
+     * Prints statistics of every core, the coherence traffic, then the
+     * statistics of the shared levels and memory.
+     */
+    void print_counts();
+
+    /*
+     * Returns the parts of a block (one bit per 1/64th) an access touches.
+     *
+     * Parameters:
+     *  address - first byte accessed
+     *  size - bytes accessed (0 if unknown, counted as 1)
+     */
+    uint64_t touch_mask(uint64_t address, uint32_t size);
+
+    /*
+     * Removes every copy of a block except one core's, counting
+     * invalidations and false sharing.
+     *
+     * Parameters:
+     *  entry - directory entry of the block
+     *  block - address of the block
+     *  core - core keeping its copy (the writer)
+     *  mask - parts of the block the writer touches
+     *
+     * Returns:
+     *  cycles spent
+     */
+    uint64_t invalidate_others(DirectoryEntry & entry, uint64_t block, int core, uint64_t mask);
+
+    /*
+     * Places a block in a core's private cache and drops the core's
+     * victim from the directory, writing it back if dirty.
+     *
+     * Parameters:
+     *  core - core whose cache to fill
+     *  block - address of the block
+     *
+     * Returns:
+     *  cycles spent
+     */
+    uint64_t fill(int core, uint64_t block);
+};
+
+/*
+ * Simulates the multicore system described by a file against the trace
+ * on stdin, whose accesses carry core numbers.
+ * Usage: csim coherence FILE
+ *
+ * Returns:
+ *  0 if the simulation was successful
+ *  1 if the simulation was unsuccessful
+ */
+int coherence_main(int argc, char * argv[]);
+
+#endif
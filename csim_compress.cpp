@@ -0,0 +1,637 @@
+/*
+ * Cache simulator compressed trace input
+ * CSF Assignment 3
+ */
+
+#include <iostream>
+#include <algorithm>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <lzma.h>
+#include "csim_compress.h"
+#include "csim_pool.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using namespace std;
+
+// fixed part of a gzip member header, up to XLEN
+#define GZIP_HEADER_SIZE 12
+// CRC32 and ISIZE after a member's deflate data
+#define GZIP_TRAILER_SIZE 8
+// header of a BGZF frame: the fixed part and the BC subfield
+#define BGZF_HEADER_SIZE 18
+// empty frame bgzip writes at the end of a file
+static const unsigned char BGZF_EOF[] = {
+    0x1f, 0x8b, 0x08, 0x04, 0, 0, 0, 0, 0, 0xff, 0x06, 0, 'B', 'C', 0x02, 0, 0x1b, 0, 0x03, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+/*
+ * Returns the number of threads to decompress or compress with.
+ */
+static int compression_threads() {
+    unsigned n = thread::hardware_concurrency();
+    return n > 0 ? (int) n : 1;
+}
+
+/*
+ * Reads a little-endian 16-bit number.
+ */
+static uint32_t get_le16(const unsigned char * p) {
+    return p[0] | (uint32_t) p[1] << 8;
+}
+
+/*
+ * Reads a little-endian 32-bit number.
+ */
+static uint32_t get_le32(const unsigned char * p) {
+    return p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+/*
+ * Writes a little-endian number of a given number of bytes.
+ */
+static void put_le(unsigned char * p, uint32_t value, int n_bytes) {
+    for (int i = 0; i < n_bytes; i++) {
+        p[i] = (unsigned char) (value >> (8 * i));
+    }
+}
+
+/*
+ * Returns the compression of a trace from its first bytes.
+ *
+ * Parameters:
+ *  begin - first byte of the trace
+ *  end - one past the last byte available (at least COMPRESSION_SNIFF_SIZE
+ *        bytes unless the trace is shorter)
+ *
+ * Returns:
+ *  COMPRESSION_NONE, COMPRESSION_GZIP, COMPRESSION_BGZF or COMPRESSION_XZ
+ */
+int trace_compression(const char * begin, const char * end) {
+    const unsigned char * p = (const unsigned char *) begin;
+    size_t n = end - begin;
+    if (n >= 6 && memcmp(p, "\xfd" "7zXZ\0", 6) == 0) {
+        return COMPRESSION_XZ;
+    }
+    if (n < 3 || p[0] != 0x1f || p[1] != 0x8b || p[2] != 8) {
+        return COMPRESSION_NONE;
+    }
+    // BGZF: an extra field whose first subfield is BC, holding the member size
+    if (n >= COMPRESSION_SNIFF_SIZE && (p[3] & 4) != 0 && get_le16(p + 10) >= 6
+        && p[12] == 'B' && p[13] == 'C' && get_le16(p + 14) == 2) {
+        return COMPRESSION_BGZF;
+    }
+    return COMPRESSION_GZIP;
+}
+
+/*
+ * Starts decompressing a trace.
+ *
+ * Parameters:
+ *  compression - COMPRESSION_GZIP, COMPRESSION_BGZF or COMPRESSION_XZ
+ *  data - compressed bytes already in memory (e.g. a mapped file)
+ *  n - number of bytes at data
+ *  fd - file descriptor the rest of the trace is read from (-1 if none)
+ *
+ * Returns:
+ *  a new InflatedTrace object
+ */
+InflatedTrace::InflatedTrace(int compression, const char * data, size_t n, int fd)
+    : compression(compression), data(data), n_data(n), fd(fd) {
+    worker = thread(&InflatedTrace::run, this);
+}
+
+/*
+ * Stops decompressing and joins the threads.
+ */
+InflatedTrace::~InflatedTrace() {
+    {
+        lock_guard<mutex> guard(lock);
+        is_stopping = true;
+    }
+    changed.notify_all();
+    worker.join();
+}
+
+/*
+ * Copies the next inflated bytes, blocking until some are ready.
+ *
+ * Parameters:
+ *  buffer - where to copy them
+ *  size - most bytes to copy
+ *
+ * Returns:
+ *  number of bytes copied (0 at the end of the trace)
+ *  -1 if the trace is corrupt or could not be read (reported to cerr)
+ */
+ssize_t InflatedTrace::read(char * buffer, size_t size) {
+    unique_lock<mutex> guard(lock);
+    changed.wait(guard, [this] { return !blocks.empty() || is_done; });
+    if (blocks.empty()) {
+        return is_failed ? -1 : 0;
+    }
+    vector<char> & block = blocks.front();
+    size_t n = min(size, block.size() - offset);
+    memcpy(buffer, block.data() + offset, n);
+    offset += n;
+    if (offset == block.size()) {
+        queued_bytes -= block.size();
+        blocks.pop_front();
+        offset = 0;
+        changed.notify_all();
+    }
+    return n;
+}
+
+/*
+ * Thread body: decompresses the whole trace.
+ */
+void InflatedTrace::run() {
+    bool ok;
+    if (compression == COMPRESSION_BGZF) {
+        ok = inflate_bgzf();
+    } else if (compression == COMPRESSION_XZ) {
+        ok = inflate_xz();
+    } else {
+        ok = inflate_gzip();
+    }
+    lock_guard<mutex> guard(lock);
+    is_done = true;
+    is_failed = !ok;
+    changed.notify_all();
+}
+
+/*
+ * Reads compressed bytes, from memory first, then from the file.
+ *
+ * Parameters:
+ *  buffer - where to put them
+ *  size - most bytes to read
+ *
+ * Returns:
+ *  number of bytes read (0 at the end of the input)
+ *  -1 if reading failed
+ */
+ssize_t InflatedTrace::read_input(char * buffer, size_t size) {
+    if (n_data > 0) {
+        size_t n = min(size, n_data);
+        memcpy(buffer, data, n);
+        data += n;
+        n_data -= n;
+        return n;
+    }
+    if (fd < 0) {
+        return 0;
+    }
+    while (true) {
+        ssize_t n = ::read(fd, buffer, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            cerr << "Could not read trace" << endl;
+        }
+        return n;
+    }
+}
+
+/*
+ * Reads exactly size compressed bytes, unless the input ends first.
+ *
+ * Returns:
+ *  number of bytes read
+ *  -1 if reading failed
+ */
+ssize_t InflatedTrace::read_input_fully(char * buffer, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = read_input(buffer + done, size - done);
+        if (n < 0) {
+            return -1;
+        }
+        if (n == 0) {
+            break;
+        }
+        done += n;
+    }
+    return done;
+}
+
+/*
+ * Queues an inflated block, blocking while the queue is full.
+ *
+ * Returns:
+ *  false if the reader has gone away and decompression should stop
+ */
+bool InflatedTrace::push(vector<char> & block) {
+    unique_lock<mutex> guard(lock);
+    changed.wait(guard, [this] { return queued_bytes < INFLATE_QUEUE_BYTES || is_stopping; });
+    if (is_stopping) {
+        return false;
+    }
+    queued_bytes += block.size();
+    blocks.push_back(std::move(block));
+    block = vector<char>();
+    changed.notify_all();
+    return true;
+}
+
+/*
+ * Inflates one BGZF frame.
+ *
+ * Parameters:
+ *  frame - the whole gzip member
+ *  header_size - bytes of the member's header
+ *  out - receives the inflated bytes
+ *
+ * Returns:
+ *  true if the frame inflated to the size and CRC its trailer records
+ */
+static bool inflate_frame(const vector<char> & frame, size_t header_size, vector<char> & out) {
+    const unsigned char * trailer = (const unsigned char *) frame.data() + frame.size() - GZIP_TRAILER_SIZE;
+    uint32_t crc = get_le32(trailer);
+    uint32_t size = get_le32(trailer + 4);
+    if (size > BGZF_MAX_FRAME) {
+        return false;
+    }
+    out.resize(size);
+    unsigned char empty; // zlib refuses a null output buffer, as an empty frame would have
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, -15) != Z_OK) { // raw deflate: the gzip wrapper was parsed already
+        return false;
+    }
+    stream.next_in = (Bytef *) frame.data() + header_size;
+    stream.avail_in = frame.size() - header_size - GZIP_TRAILER_SIZE;
+    stream.next_out = size > 0 ? (Bytef *) out.data() : &empty;
+    stream.avail_out = size;
+    int result = inflate(&stream, Z_FINISH);
+    bool ok = result == Z_STREAM_END && stream.avail_out == 0;
+    inflateEnd(&stream);
+    return ok && crc32(0, (const Bytef *) out.data(), size) == crc;
+}
+
+/*
+ * Inflates a BGZF trace frame by frame, rounds of frames in parallel.
+ *
+ * Returns:
+ *  true if successful
+ */
+bool InflatedTrace::inflate_bgzf() {
+    WorkStealingPool pool(compression_threads());
+    size_t round_size = (size_t) pool.get_n_threads() * BGZF_FRAMES_PER_THREAD;
+    vector< vector<char> > frames(round_size);
+    vector<size_t> header_sizes(round_size);
+    vector< vector<char> > inflated(round_size);
+    vector<char> ok(round_size);
+    bool is_end = false;
+    while (!is_end) {
+        // split off a round of frames by their recorded sizes
+        size_t n_frames = 0;
+        while (n_frames < round_size) {
+            vector<char> & frame = frames[n_frames];
+            frame.resize(GZIP_HEADER_SIZE);
+            ssize_t n = read_input_fully(frame.data(), GZIP_HEADER_SIZE);
+            if (n < 0) {
+                return false;
+            }
+            if (n == 0) {
+                is_end = true;
+                break;
+            }
+            const unsigned char * p = (const unsigned char *) frame.data();
+            if (n < GZIP_HEADER_SIZE || p[0] != 0x1f || p[1] != 0x8b || p[2] != 8 || (p[3] & 4) == 0) {
+                cerr << "Corrupt compressed trace" << endl;
+                return false;
+            }
+            size_t extra_size = get_le16(p + 10);
+            frame.resize(GZIP_HEADER_SIZE + extra_size);
+            if (read_input_fully(frame.data() + GZIP_HEADER_SIZE, extra_size) != (ssize_t) extra_size) {
+                cerr << "Truncated compressed trace" << endl;
+                return false;
+            }
+
+            // the BC subfield holds the member size - 1
+            size_t member_size = 0;
+            for (size_t i = 0; i + 4 <= extra_size; ) {
+                const unsigned char * field = (const unsigned char *) frame.data() + GZIP_HEADER_SIZE + i;
+                size_t field_size = get_le16(field + 2);
+                if (field[0] == 'B' && field[1] == 'C' && field_size == 2 && i + 6 <= extra_size) {
+                    member_size = get_le16(field + 4) + 1;
+                }
+                i += 4 + field_size;
+            }
+            header_sizes[n_frames] = GZIP_HEADER_SIZE + extra_size;
+            if (member_size < header_sizes[n_frames] + GZIP_TRAILER_SIZE) {
+                cerr << "Corrupt compressed trace" << endl;
+                return false;
+            }
+            frame.resize(member_size);
+            size_t rest = member_size - header_sizes[n_frames];
+            if (read_input_fully(frame.data() + header_sizes[n_frames], rest) != (ssize_t) rest) {
+                cerr << "Truncated compressed trace" << endl;
+                return false;
+            }
+            n_frames++;
+        }
+
+        vector<size_t> tasks(n_frames);
+        for (size_t i = 0; i < n_frames; i++) {
+            tasks[i] = i;
+        }
+        pool.run(tasks, [&](size_t i) {
+            ok[i] = inflate_frame(frames[i], header_sizes[i], inflated[i]);
+        });
+        for (size_t i = 0; i < n_frames; i++) {
+            if (!ok[i]) {
+                cerr << "Corrupt compressed trace" << endl;
+                return false;
+            }
+            if (!inflated[i].empty() && !push(inflated[i])) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/*
+ * Inflates a gzip trace member by member.
+ *
+ * Returns:
+ *  true if successful
+ */
+bool InflatedTrace::inflate_gzip() {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, 15 + 16) != Z_OK) { // gzip wrapper
+        return false;
+    }
+    vector<char> input(INFLATE_BLOCK_SIZE);
+    vector<char> block(INFLATE_BLOCK_SIZE);
+    stream.next_out = (Bytef *) block.data();
+    stream.avail_out = block.size();
+    bool is_input_done = false;
+    bool in_member = true;
+    bool ok = true;
+    while (ok) {
+        if (stream.avail_in == 0 && !is_input_done) {
+            ssize_t n = read_input(input.data(), input.size());
+            if (n < 0) {
+                ok = false;
+                break;
+            }
+            is_input_done = n == 0;
+            stream.next_in = (Bytef *) input.data();
+            stream.avail_in = n;
+        }
+        if (stream.avail_in == 0 && is_input_done) {
+            if (in_member) {
+                cerr << "Truncated compressed trace" << endl;
+                ok = false;
+            }
+            break;
+        }
+        if (!in_member) { // another member follows
+            inflateReset(&stream);
+            in_member = true;
+        }
+
+        int result = inflate(&stream, Z_NO_FLUSH);
+        if (result == Z_STREAM_END) {
+            in_member = false;
+        } else if (result != Z_OK && result != Z_BUF_ERROR) {
+            cerr << "Corrupt compressed trace" << endl;
+            ok = false;
+        }
+        if (stream.avail_out == 0) {
+            if (!push(block)) {
+                ok = false;
+            }
+            block.resize(INFLATE_BLOCK_SIZE);
+            stream.next_out = (Bytef *) block.data();
+            stream.avail_out = block.size();
+        }
+    }
+    block.resize(block.size() - stream.avail_out);
+    if (ok && !block.empty()) {
+        ok = push(block);
+    }
+    inflateEnd(&stream);
+    return ok;
+}
+
+/*
+ * Decodes an xz trace.
+ *
+ * Returns:
+ *  true if successful
+ */
+bool InflatedTrace::inflate_xz() {
+    lzma_stream stream = LZMA_STREAM_INIT;
+    lzma_mt options;
+    memset(&options, 0, sizeof(options));
+    options.flags = LZMA_CONCATENATED;
+    options.threads = compression_threads();
+    options.memlimit_threading = lzma_physmem() / 4; // beyond this, decode on one thread
+    options.memlimit_stop = UINT64_MAX;
+    if (lzma_stream_decoder_mt(&stream, &options) != LZMA_OK) {
+        return false;
+    }
+    vector<char> input(INFLATE_BLOCK_SIZE);
+    vector<char> block(INFLATE_BLOCK_SIZE);
+    stream.next_out = (uint8_t *) block.data();
+    stream.avail_out = block.size();
+    lzma_action action = LZMA_RUN;
+    bool ok = true;
+    while (ok) {
+        if (stream.avail_in == 0 && action == LZMA_RUN) {
+            ssize_t n = read_input(input.data(), input.size());
+            if (n < 0) {
+                ok = false;
+                break;
+            }
+            if (n == 0) {
+                action = LZMA_FINISH;
+            }
+            stream.next_in = (const uint8_t *) input.data();
+            stream.avail_in = n;
+        }
+
+        lzma_ret result = lzma_code(&stream, action);
+        if (result != LZMA_OK && result != LZMA_STREAM_END) {
+            cerr << (result == LZMA_BUF_ERROR ? "Truncated compressed trace" : "Corrupt compressed trace") << endl;
+            ok = false;
+        }
+        if (stream.avail_out == 0 || result == LZMA_STREAM_END) {
+            block.resize(block.size() - stream.avail_out);
+            if (ok && !block.empty() && !push(block)) {
+                ok = false;
+            }
+            block.resize(INFLATE_BLOCK_SIZE);
+            stream.next_out = (uint8_t *) block.data();
+            stream.avail_out = block.size();
+        }
+        if (result == LZMA_STREAM_END) {
+            break;
+        }
+    }
+    lzma_end(&stream);
+    return ok;
+}
+
+/*
+ * Writes a whole buffer to a file descriptor.
+ *
+ * Returns:
+ *  true if successful
+ */
+static bool write_fully(int fd, const char * p, size_t n) {
+    while (n > 0) {
+        ssize_t written = write(fd, p, n);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        p += written;
+        n -= written;
+    }
+    return true;
+}
+
+/*
+ * Compresses one BGZF frame.
+ *
+ * Parameters:
+ *  input - uncompressed bytes (at most BGZF_FRAME_INPUT)
+ *  level - zlib compression level
+ *  frame - receives the gzip member
+ *
+ * Returns:
+ *  true if successful
+ */
+static bool deflate_frame(const vector<char> & input, int level, vector<char> & frame) {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    frame.resize(BGZF_MAX_FRAME);
+    size_t header_size = BGZF_HEADER_SIZE;
+    stream.next_in = (Bytef *) input.data();
+    stream.avail_in = input.size();
+    stream.next_out = (Bytef *) frame.data() + header_size;
+    stream.avail_out = BGZF_MAX_FRAME - header_size - GZIP_TRAILER_SIZE;
+    int result = deflate(&stream, Z_FINISH);
+    size_t data_size = stream.total_out;
+    deflateEnd(&stream);
+    if (result != Z_STREAM_END) {
+        return false;
+    }
+
+    unsigned char * p = (unsigned char *) frame.data();
+    memcpy(p, BGZF_EOF, header_size); // the EOF frame's header, with the size filled in below
+    size_t member_size = header_size + data_size + GZIP_TRAILER_SIZE;
+    put_le(p + 16, member_size - 1, 2);
+    put_le(p + header_size + data_size, crc32(0, (const Bytef *) input.data(), input.size()), 4);
+    put_le(p + header_size + data_size + 4, input.size(), 4);
+    frame.resize(member_size);
+    return true;
+}
+
+/*
+ * Compresses a file (e.g. a trace) as BGZF: gzip members of at most
+ * 64 KiB that record their own size, which gzip -d still reads and
+ * which csim inflates in parallel. Frames are compressed in parallel.
+ *
+ * Parameters:
+ *  in_fd - file descriptor to read from
+ *  out_fd - file descriptor to write to
+ *  level - zlib compression level (1-9)
+ *
+ * Returns:
+ *  true if successful
+ *  false if reading, compressing or writing failed
+ */
+bool compress_trace(int in_fd, int out_fd, int level) {
+    WorkStealingPool pool(compression_threads());
+    size_t round_size = (size_t) pool.get_n_threads() * BGZF_FRAMES_PER_THREAD;
+    vector< vector<char> > chunks(round_size);
+    vector< vector<char> > frames(round_size);
+    vector<char> ok(round_size);
+    bool is_end = false;
+    while (!is_end) {
+        size_t n_chunks = 0;
+        while (n_chunks < round_size && !is_end) {
+            vector<char> & chunk = chunks[n_chunks];
+            chunk.resize(BGZF_FRAME_INPUT);
+            size_t filled = 0;
+            while (filled < chunk.size()) {
+                ssize_t n = read(in_fd, chunk.data() + filled, chunk.size() - filled);
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n < 0) {
+                    cerr << "Could not read trace" << endl;
+                    return false;
+                }
+                if (n == 0) {
+                    is_end = true;
+                    break;
+                }
+                filled += n;
+            }
+            chunk.resize(filled);
+            if (filled > 0) {
+                n_chunks++;
+            }
+        }
+
+        vector<size_t> tasks(n_chunks);
+        for (size_t i = 0; i < n_chunks; i++) {
+            tasks[i] = i;
+        }
+        pool.run(tasks, [&](size_t i) {
+            ok[i] = deflate_frame(chunks[i], level, frames[i]);
+        });
+        for (size_t i = 0; i < n_chunks; i++) {
+            if (!ok[i] || !write_fully(out_fd, frames[i].data(), frames[i].size())) {
+                cerr << "Could not write compressed trace" << endl;
+                return false;
+            }
+        }
+    }
+    if (!write_fully(out_fd, (const char *) BGZF_EOF, sizeof(BGZF_EOF))) {
+        cerr << "Could not write compressed trace" << endl;
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Compresses the trace on stdin to BGZF on stdout.
+ * Usage: csim compress [level]
+ *
+ * Returns:
+ *  0 if compression successful
+ *  1 if compression unsuccessful
+ */
+int compress_main(int argc, char * argv[]) {
+    int level = Z_DEFAULT_COMPRESSION;
+    if (argc > 3 || (argc == 3 && (strlen(argv[2]) != 1 || argv[2][0] < '1' || argv[2][0] > '9'))) {
+        cerr << "Invalid arguments" << endl;
+        return 1;
+    }
+    if (argc == 3) {
+        level = argv[2][0] - '0';
+    }
+    return compress_trace(STDIN_FILENO, STDOUT_FILENO, level) ? 0 : 1;
+}
@@ -0,0 +1,202 @@
+/*
+ * Cache simulator compressed trace input
+ * CSF Assignment 3
+ */
+
+#ifndef __CSIM_COMPRESS_H__
+#define __CSIM_COMPRESS_H__
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// compressed formats a trace may come in
+#define COMPRESSION_NONE 0
+#define COMPRESSION_GZIP 1 // one or more gzip members, inflated in order
+#define COMPRESSION_BGZF 2 // gzip members that record their own size (bgzip, csim compress): inflated in parallel
+#define COMPRESSION_XZ 3   // xz streams; multi-block files (xz -T) are decoded in parallel
+
+// bytes of a trace needed to tell its compression apart
+#define COMPRESSION_SNIFF_SIZE 18
+
+// uncompressed bytes per BGZF frame written by compress_trace() (as bgzip,
+// so an incompressible frame still fits the 64 KiB frame size limit)
+#define BGZF_FRAME_INPUT 0xff00
+// largest BGZF frame
+#define BGZF_MAX_FRAME 65536
+// frames inflated per round, per thread
+#define BGZF_FRAMES_PER_THREAD 8
+
+// bytes per inflated block of a sequentially decoded stream
+#define INFLATE_BLOCK_SIZE (1 << 20)
+// most inflated bytes waiting to be parsed
+#define INFLATE_QUEUE_BYTES (16 << 20)
+
+/*
+ * Returns the compression of a trace from its first bytes.
+ *
+ * Parameters:
+ *  begin - first byte of the trace
+ *  end - one past the last byte available (at least COMPRESSION_SNIFF_SIZE
+ *        bytes unless the trace is shorter)
+ *
+ * Returns:
+ *  COMPRESSION_NONE, COMPRESSION_GZIP, COMPRESSION_BGZF or COMPRESSION_XZ
+ */
+int trace_compression(const char * begin, const char * end);
+
+/*
+ * Decompresses a trace on threads of its own, so decompression runs
+ * ahead of the parser instead of between its reads. Inflated bytes wait
+ * in a bounded queue of blocks, handed out in order by read().
+ *
+ * BGZF traces are split into their frames without inflating anything,
+ * and rounds of frames are inflated across a thread pool. Plain gzip is
+ * inflated on one thread, as its members cannot be found without
+ * decoding them. xz is decoded by liblzma's threaded decoder, which
+ * works on several blocks at once when the file has them.
+ */
+class InflatedTrace {
+public:
+    /*
+     * Starts decompressing a trace.
+     *
+     * Parameters:
+     *  compression - COMPRESSION_GZIP, COMPRESSION_BGZF or COMPRESSION_XZ
+     *  data - compressed bytes already in memory (e.g. a mapped file)
+     *  n - number of bytes at data
+     *  fd - file descriptor the rest of the trace is read from (-1 if none)
+     *
+     * Returns:
+     *  a new InflatedTrace object
+     */
+    InflatedTrace(int compression, const char * data, size_t n, int fd);
+
+    /*
+     * Stops decompressing and joins the threads.
+     */
+    ~InflatedTrace();
+
+    /*
+     * Copies the next inflated bytes, blocking until some are ready.
+     *
+     * Parameters:
+     *  buffer - where to copy them
+     *  size - most bytes to copy
+     *
+     * Returns:
+     *  number of bytes copied (0 at the end of the trace)
+     *  -1 if the trace is corrupt or could not be read (reported to cerr)
+     */
+    ssize_t read(char * buffer, size_t size);
+
+private:
+    int compression;
+    const char * data; // compressed bytes not yet consumed from memory
+    size_t n_data;
+    int fd;
+
+    std::deque< std::vector<char> > blocks; // inflated blocks, in order
+    size_t queued_bytes = 0;
+    size_t offset = 0;           // bytes of blocks.front() already read
+    bool is_done = false;        // no more blocks will come
+    bool is_failed = false;      // decompression failed
+    bool is_stopping = false;    // the reader has gone away
+    std::mutex lock;
+    std::condition_variable changed;
+    std::thread worker;
+
+    /*
+     * Thread body: decompresses the whole trace.
+     */
+    void run();
+
+    /*
+     * Inflates a BGZF trace frame by frame, rounds of frames in parallel.
+     *
+     * Returns:
+     *  true if successful
+     */
+    bool inflate_bgzf();
+
+    /*
+     * Inflates a gzip trace member by member.
+     *
+     * Returns:
+     *  true if successful
+     */
+    bool inflate_gzip();
+
+    /*
+     * Decodes an xz trace.
+     *
+     * Returns:
+     *  true if successful
+     */
+    bool inflate_xz();
+
+    /*
+     * Reads compressed bytes, from memory first, then from the file.
+     *
+     * Parameters:
+     *  buffer - where to put them
+     *  size - most bytes to read
+     *
+     * Returns:
+     *  number of bytes read (0 at the end of the input)
+     *  -1 if reading failed
+     */
+    ssize_t read_input(char * buffer, size_t size);
+
+    /*
+     * Reads exactly size compressed bytes, unless the input ends first.
+     *
+     * Returns:
+     *  number of bytes read
+     *  -1 if reading failed
+     */
+    ssize_t read_input_fully(char * buffer, size_t size);
+
+    /*
+     * Queues an inflated block, blocking while the queue is full.
+     *
+     * Returns:
+     *  false if the reader has gone away and decompression should stop
+     */
+    bool push(std::vector<char> & block);
+
+    InflatedTrace(const InflatedTrace &);
+    InflatedTrace & operator=(const InflatedTrace &);
+};
+
+/*
+ * Compresses a file (e.g. a trace) as BGZF: gzip members of at most
+ * 64 KiB that record their own size, which gzip -d still reads and
+ * which csim inflates in parallel. Frames are compressed in parallel.
+ *
+ * Parameters:
+ *  in_fd - file descriptor to read from
+ *  out_fd - file descriptor to write to
+ *  level - zlib compression level (1-9)
+ *
+ * Returns:
+ *  true if successful
+ *  false if reading, compressing or writing failed
+ */
+bool compress_trace(int in_fd, int out_fd, int level);
+
+/*
+ * Compresses the trace on stdin to BGZF on stdout.
+ * Usage: csim compress [level]
+ *
+ * Returns:
+ *  0 if compression successful
+ *  1 if compression unsuccessful
+ */
+int compress_main(int argc, char * argv[]);
+
+#endif
@@ -12,12 +12,14 @@
 #include <fstream>
 #include <sstream>
 #include <vector>
-#include <map>
 #include <utility>
 #include <string.h>
 #include <cmath>
 #include <iomanip>
+#include <unistd.h>
 #include "csim_functions.h"
+#include "csim_trace.h"
+#include "csim_simd.h"
 
 using std::cout;
 using std::endl;
@@ -26,7 +28,7 @@ using std::exception;
 using namespace std;
 
 /*
- * Constructs a CacheSimulator object without the is_lru parameter.
+ * Constructs a CacheSimulator object without the eviction parameter.
  *
  * Parameters:
  *  n_sets - number of sets in cache
@@ -34,6 +36,7 @@ using namespace std;
  *  block_size - size of each block in bytes
  *  is_write_allocate - is the cache write-allocate or no-write-allocate
  *  is_write_through - is the cache write-through or write-back
+ *  file_data - accesses for run_simulation() (may be empty when streaming)
  * 
  * Returns: 
  *  a new CacheSimulator object
@@ -43,20 +46,21 @@ CacheSimulator::CacheSimulator(const int n_sets,
                                const int block_size,  
                                const bool is_write_allocate, 
                                const bool is_write_through,
-                               const std::vector< std::pair<int, uint32_t> > file_data) {
+                               std::vector<Access> file_data) {
     this->n_sets = n_sets;
     this->n_blocks = n_blocks;
     this->block_size = block_size;
     this->is_write_allocate = is_write_allocate;
     this->is_write_through = is_write_through;
-    this->is_lru = -1;
-    this->file_data = file_data;
+    this->eviction = EVICT_NONE;
+    this->file_data = std::move(file_data);
 
-    this->cache.resize(n_sets); // set number of sets to n_sets
+    init_sets();
+    select_kernels();
 }
 
 /*
- * Constructs a CacheSimulator object with the is_lru parameter.
+ * Constructs a CacheSimulator object with the eviction parameter.
  *
  * Parameters:
  *  n_sets - number of sets in cache
@@ -64,7 +68,8 @@ CacheSimulator::CacheSimulator(const int n_sets,
  *  block_size - size of each block in bytes
  *  is_write_allocate - is the cache write-allocate or no-write-allocate
  *  is_write_through - is the cache write-through or write-back
- *  is_lru - does the cache use lru (least-recently-used) or fifo (first-in-first-out) evictions
+ *  eviction - eviction policy (EVICT_LRU, EVICT_FIFO, ...; 1 and 0 still mean lru and fifo)
+ *  file_data - accesses for run_simulation() (may be empty when streaming)
  * 
  * Returns: 
  *  a new CacheSimulator object
@@ -74,30 +79,66 @@ CacheSimulator::CacheSimulator(const int n_sets,
                                const int block_size, 
                                const bool is_write_allocate, 
                                const bool is_write_through, 
-                               const int is_lru,
-                               const std::vector< std::pair<int, uint32_t> > file_data) {
+                               const int eviction,
+                               std::vector<Access> file_data) {
     this->n_sets = n_sets;
     this->n_blocks = n_blocks;
     this->block_size = block_size;
     this->is_write_allocate = is_write_allocate;
     this->is_write_through = is_write_through;
-    this->is_lru = is_lru;
-    this->file_data = file_data;
+    this->eviction = eviction;
+    this->file_data = std::move(file_data);
 
-    this->cache.resize(n_sets); // set number of sets to n_sets
+    init_sets();
+    select_kernels();
+}
+
+/*
+ * Constructs a CacheSimulator object from a parsed configuration.
+ *
+ * Parameters:
+ *  config - cache configuration
+ * 
+ * Returns: 
+ *  a new CacheSimulator object
+ */
+CacheSimulator::CacheSimulator(const CacheConfig & config) {
+    this->n_sets = config.n_sets;
+    this->n_blocks = config.n_blocks;
+    this->block_size = config.block_size;
+    this->is_write_allocate = config.is_write_allocate;
+    this->is_write_through = config.is_write_through;
+    this->eviction = config.eviction;
+
+    init_sets();
+    select_kernels();
 }
 
 /*
  * Prints statistics. 
  */
 void CacheSimulator::print_counts() {     
-    cout << "Total loads: " << total_loads << endl;
-    cout << "Total stores: " << total_stores << endl;
-    cout << "Load hits: " << total_load_hits << endl;
-    cout << "Load misses: " << total_load_misses << endl;
-    cout << "Store hits: " << total_store_hits << endl;
-    cout << "Store misses: " << total_store_misses << endl;
-    cout << "Total cycles: " << total_cycles << endl;
+    print_counts(cout, "");
+}
+
+/*
+ * Prints statistics, one per line, each line starting with a prefix.
+ *
+ * Parameters:
+ *  out - stream to print to
+ *  prefix - text to print before each line
+ */
+void CacheSimulator::print_counts(ostream & out, const char * prefix) const {
+    out << prefix << "Total loads: " << total_loads << endl;
+    out << prefix << "Total stores: " << total_stores << endl;
+    out << prefix << "Load hits: " << total_load_hits << endl;
+    out << prefix << "Load misses: " << total_load_misses << endl;
+    out << prefix << "Store hits: " << total_store_hits << endl;
+    out << prefix << "Store misses: " << total_store_misses << endl;
+    out << prefix << "Total cycles: " << total_cycles << endl;
+    if (total_split_accesses > 0) {
+        out << prefix << "Split accesses: " << total_split_accesses << endl;
+    }
 }
 
 /*
@@ -109,16 +150,8 @@ void CacheSimulator::print_counts() {
  * Returns:
  *  index
  */
-uint32_t CacheSimulator::get_index(uint32_t address) {
-    // make index 0 for fully associative caches
-    if (n_sets == 1) {
-        return 0;
-    }
-    
-    // else get index from num sets
-    int index_bits = get_log2(n_sets);
-    int32_t mask = (1 << index_bits) - 1;
-    return (address >> get_log2(block_size)) & mask;
+uint32_t CacheSimulator::get_index(uint64_t address) {
+    return (address >> offset_bits) & index_mask; // index_mask is 0 for fully associative caches
 }
 
 /*
@@ -130,281 +163,384 @@ uint32_t CacheSimulator::get_index(uint32_t address) {
  * Returns:
  *  tag
  */
-uint32_t CacheSimulator::get_tag(uint32_t address) {
+uint64_t CacheSimulator::get_tag(uint64_t address) {
     // for fully associative caches, index + tag combine to become the tag
-    if (n_sets == 1) {
-        return address >> get_log2(block_size);
+    return address >> tag_shift;
+}
+
+/*
+ * Allocates the flat block arrays of every set.
+ */
+void CacheSimulator::init_sets() {
+    offset_bits = get_log2(block_size);
+    index_mask = n_sets - 1;
+    tag_shift = offset_bits + get_log2(n_sets);
+    wide_mask = tag_shift + 32 < 64 ? UINT64_MAX << (tag_shift + 32) : 0;
+
+    size_t n_slots = (size_t) n_sets * n_blocks;
+    cache.assign(n_sets, Set());
+    tags.assign(n_slots, 0);
+    wide_tags.clear();
+    is_wide = false;
+    valid_bits.assign((n_slots + 63) / 64, 0);
+    dirty_bits.assign((n_slots + 63) / 64, 0);
+
+    // highly associative sets get a hashed tag index at most half full
+    if (n_blocks > HASH_MIN_BLOCKS) {
+        index_size = 2 * n_blocks;
+        tag_index.assign((size_t) n_sets * index_size, NO_BLOCK);
     }
+}
 
-    return address >> (get_log2(block_size) + get_log2(n_sets));
+/*
+ * Returns true if a slot holds a valid block.
+ *
+ * Parameters:
+ *  index - index of cache
+ *  block_index - index of block within set
+ */
+bool CacheSimulator::is_valid(uint32_t index, uint32_t block_index) {
+    size_t slot = (size_t) index * n_blocks + block_index;
+    return (valid_bits[slot >> 6] >> (slot & 63)) & 1;
 }
 
 /*
- * Returns true if instruction is cache hit, false if cache miss.
+ * Returns true if a slot holds a dirty block.
  *
  * Parameters:
  *  index - index of cache
- *  tag - target tag of block
- * 
- * Returns:
- *  index of block within set if cache hit
- *  -1 if cache miss
+ *  block_index - index of block within set
  */
-int32_t CacheSimulator::is_hit(uint32_t index, uint32_t tag) {
-    Set &s = cache[index];
-    auto i = s.indices.find(tag);
-    if (i != s.indices.end()) { // hit
-        uint32_t index_of_slot = i->second;
-        return index_of_slot;
-    } else { // miss
-        return -1;
-    }
+bool CacheSimulator::is_dirty(uint32_t index, uint32_t block_index) {
+    size_t slot = (size_t) index * n_blocks + block_index;
+    return (dirty_bits[slot >> 6] >> (slot & 63)) & 1;
 }
 
 /*
- * Update access timestamp(s) if using lru evictions.
+ * Sets or clears the dirty bit of a slot.
  *
  * Parameters:
  *  index - index of cache
- *  tag - target tag of block
- *  prev_access_ts - access timestamp of previously evicted, replaced, or added block
+ *  block_index - index of block within set
+ *  dirty - new value of the dirty bit
  */
-void CacheSimulator::update_access_ts(uint32_t index, uint32_t tag, uint32_t prev_access_ts) {
-    Set & target_set = cache[index];
-    size_t set_length = cache[index].blocks.size();
-    for (uint32_t i = 0; i < set_length; i++) {
-        Block & block = target_set.blocks[i];
-        if (block.access_ts < prev_access_ts && block.tag != tag) {
-            block.access_ts++;
+void CacheSimulator::set_dirty(uint32_t index, uint32_t block_index, bool dirty) {
+    size_t slot = (size_t) index * n_blocks + block_index;
+    uint64_t bit = (uint64_t) 1 << (slot & 63);
+    if (dirty) {
+        dirty_bits[slot >> 6] |= bit;
+    } else {
+        dirty_bits[slot >> 6] &= ~bit;
+    }
+}
+
+/*
+ * Returns the first slot of a set that holds no valid block.
+ *
+ * Parameters:
+ *  index - index of cache (must have a free slot)
+ */
+uint32_t CacheSimulator::first_invalid(uint32_t index) {
+    size_t base = (size_t) index * n_blocks;
+    if (n_blocks < 64) { // n_blocks is a power of 2, so the set lies within one word
+        uint64_t bits = valid_bits[base >> 6] >> (base & 63);
+        return __builtin_ctzll(~bits);
+    }
+    for (size_t w = base >> 6; ; w++) {
+        if (~valid_bits[w] != 0) {
+            return (uint32_t) ((w << 6) - base) + __builtin_ctzll(~valid_bits[w]);
         }
     }
 }
 
 /*
- * Evict a block from a set within a cache using lru evictions.
+ * Returns the tags of every slot, in the array of width Tag.
+ */
+template <>
+uint32_t * CacheSimulator::tag_slots<uint32_t>() {
+    return tags.data();
+}
+
+template <>
+uint64_t * CacheSimulator::tag_slots<uint64_t>() {
+    return wide_tags.data();
+}
+
+/*
+ * Moves the tags to 64-bit storage and switches to the kernels for it.
+ */
+void CacheSimulator::widen_tags() {
+    // tags that fit in 32 bits keep their home in the tag index, so it stays valid
+    wide_tags.assign(tags.begin(), tags.end());
+    std::vector<uint32_t>().swap(tags);
+    is_wide = true;
+    bind_policy_kernels();
+}
+
+/*
+ * Stores a new tag in a slot, keeping the tag index up to date.
  *
  * Parameters:
  *  index - index of cache
- *  tag - target tag of block
+ *  block_index - index of block within set
+ *  tag - new tag of block
  */
-void CacheSimulator::evict_by_lru(uint32_t index, uint32_t tag) {
-    // find the block that is least recently used in the set (has the highest timestamp value)
-    // then use that slot for a new block 
-    Set & target_set = cache[index];
-    size_t set_length = target_set.blocks.size();
-    uint32_t lru_ts = 0;
-    uint32_t block_index = 0;
-    for (uint32_t i = 0; i < set_length; i++) {
-        Block & block = target_set.blocks[i];
-        if (block.access_ts > lru_ts) {
-            lru_ts = block.access_ts;
-            block_index = i;
+template <class Tag>
+void CacheSimulator::set_tag(uint32_t index, uint32_t block_index, Tag tag) {
+    Tag * slots = tag_slots<Tag>();
+    if (index_size == 0) {
+        slots[(size_t) index * n_blocks + block_index] = tag;
+        return;
+    }
+    if (is_valid(index, block_index)) { // remove old tag
+        index_erase<Tag>(index, block_index);
+    }
+    slots[(size_t) index * n_blocks + block_index] = tag;
+    index_insert<Tag>(index, block_index);
+}
+
+/*
+ * Returns the home position of a tag in a set's tag index (the same
+ * for a tag that fits in 32 bits whichever width it is stored in).
+ */
+uint32_t CacheSimulator::index_home(uint64_t tag) {
+    uint32_t folded = (uint32_t) (tag ^ (tag >> 32));
+    return (folded * 2654435761u) & (index_size - 1); // multiplicative (Fibonacci) hashing
+}
+
+/*
+ * Looks up a tag in a set's tag index.
+ *
+ * Returns:
+ *  index of block within set if found
+ *  -1 if not found
+ */
+template <class Tag>
+int32_t CacheSimulator::index_find(uint32_t index, Tag tag) {
+    const uint32_t * table = &tag_index[(size_t) index * index_size];
+    const Tag * set_tags = tag_slots<Tag>() + (size_t) index * n_blocks;
+    uint32_t mask = index_size - 1;
+    for (uint32_t i = index_home(tag); table[i] != NO_BLOCK; i = (i + 1) & mask) {
+        if (set_tags[table[i]] == tag) {
+            return table[i];
         }
     }
+    return -1;
+}
 
-    Block & block = target_set.blocks[block_index];
-    
-    // if write-back and block to be evicted is dirty, write dirty block to memory
-    if (!is_write_through && block.dirty) {
-        total_cycles += 25 * block_size;
+/*
+ * Removes the entry of a valid slot from a set's tag index.
+ */
+template <class Tag>
+void CacheSimulator::index_erase(uint32_t index, uint32_t block_index) {
+    uint32_t * table = &tag_index[(size_t) index * index_size];
+    const Tag * set_tags = tag_slots<Tag>() + (size_t) index * n_blocks;
+    uint32_t mask = index_size - 1;
+    uint32_t i = index_home(set_tags[block_index]);
+    while (table[i] != block_index) {
+        i = (i + 1) & mask;
     }
 
-    target_set.indices.erase(block.tag); // remove old (tag, block_index) pair from map
-    target_set.indices.insert({tag, block_index}); // add (tag, block_index) pair to set map
+    // shift later entries of the probe run back so lookups never stop early
+    for (uint32_t j = (i + 1) & mask; table[j] != NO_BLOCK; j = (j + 1) & mask) {
+        uint32_t home = index_home(set_tags[table[j]]);
+        if (((j - home) & mask) >= ((j - i) & mask)) { // entry j may move to the hole at i
+            table[i] = table[j];
+            i = j;
+        }
+    }
+    table[i] = NO_BLOCK;
+}
+
+/*
+ * Adds the entry of a slot to a set's tag index.
+ */
+template <class Tag>
+void CacheSimulator::index_insert(uint32_t index, uint32_t block_index) {
+    uint32_t * table = &tag_index[(size_t) index * index_size];
+    uint32_t mask = index_size - 1;
+    uint32_t i = index_home(tag_slots<Tag>()[(size_t) index * n_blocks + block_index]);
+    while (table[i] != NO_BLOCK) {
+        i = (i + 1) & mask;
+    }
+    table[i] = block_index;
+}
 
-    // replace slot with new block
-    block.tag = tag;
-    block.valid = true;
-    block.access_ts = 0;
-    block.load_ts = total_stores + total_loads;
+/*
+ * Compares every tag of a set against a target tag, in the SIMD kernel
+ * for the tags' width.
+ */
+static inline uint32_t match_set_tags(const uint32_t * tags, uint32_t n, uint32_t tag) {
+    return simd.match_tags(tags, n, tag);
+}
 
-    // increment all counters
-    update_access_ts(index, tag, 0xffffffff);
+static inline uint32_t match_set_tags(const uint64_t * tags, uint32_t n, uint64_t tag) {
+    return simd.match_wide_tags(tags, n, tag);
 }
 
 /*
- * Evict a block from a set within a cache using fifo evictions.
+ * Returns true if instruction is cache hit, false if cache miss.
  *
  * Parameters:
  *  index - index of cache
  *  tag - target tag of block
  * 
  * Returns:
- *  index of evicted block
+ *  index of block within set if cache hit
+ *  -1 if cache miss
  */
-void CacheSimulator::evict_by_fifo(uint32_t index, uint32_t tag) {
-    // find the block that is least recently loaded in the set (has the lowest timestamp value)
-    // then use that slot for a new block 
-    Set & target_set = cache[index];
-    size_t set_length = target_set.blocks.size();
-    uint32_t fifo_ts = 0xffffffff;
-    uint32_t block_index = 0;
-    for (uint32_t i = 0; i < set_length; i++) {
-        Block & block = target_set.blocks[i];
-        if (block.load_ts < fifo_ts) {
-            fifo_ts = block.load_ts;
-            block_index = i;
-        }
+int32_t CacheSimulator::is_hit(uint32_t index, uint64_t tag) {
+    if (is_wide) {
+        return lookup<true, uint64_t>(index, tag);
     }
-
-    Block & block = target_set.blocks[block_index];
-    
-    // if write-back and block to be evicted is dirty, write dirty block to memory
-    if (!is_write_through && block.dirty) {
-        total_cycles += 25 * block_size;
+    if (tag > UINT32_MAX) { // every tag held fits in 32 bits
+        return -1;
     }
-
-    target_set.indices.erase(block.tag); // remove old (tag, block_index) pair from map
-    target_set.indices.insert({tag, block_index}); // add (tag, block_index) pair to set map
-
-    // replace slot with new block
-    block.tag = tag;
-    block.valid = true;
-    block.access_ts = 0;
-    block.load_ts = total_stores + total_loads;
+    return lookup<true, uint32_t>(index, (uint32_t) tag);
 }
 
 /*
- * Add a block to the cache during a cache miss.
+ * Looks up a tag in a set, with tags of width Tag. Direct-mapped sets
+ * compare their only tag.
  *
  * Parameters:
  *  index - index of cache
  *  tag - target tag of block
+ *
+ * Returns:
+ *  index of block within set if cache hit
+ *  -1 if cache miss
  */
-void CacheSimulator::add_block(uint32_t index, uint32_t tag) {
-    Set & target_set = cache[index];
-    size_t set_size = target_set.blocks.size();
-
-    if (n_blocks > (int) set_size) { // space left in set?
-        // add (tag, block_index) pair to set map
-        target_set.indices.insert({tag, set_size});
-        
-        // create new block
-        Block * block = new Block();
-        block->tag = tag;
-        block->valid = true;
-        block->access_ts = 0;
-        block->load_ts = total_loads + total_stores;
-        if (!is_write_through) { // if write-back, mark block as dirty
-            block->dirty = true; 
-        }
-        
-        // add to set vector
-        target_set.blocks.push_back(*block);
-
-        if (is_lru == 1) { // lru
-            update_access_ts(index, tag, 0xffffffff);
-        } 
-    } else if (n_blocks == 1) { // no space left in direct-mapped cache
-        Block & block = target_set.blocks[0];
-
-        target_set.indices.erase(block.tag); // remove old (tag, block_index) pair from set map
-        target_set.indices.insert({tag, 0}); // add (tag, block_index) pair to set map
+template <bool Associative, class Tag>
+int32_t CacheSimulator::lookup(uint32_t index, Tag tag) {
+    const Tag * slots = tag_slots<Tag>();
+    if (!Associative) {
+        return (slots[index] == tag && is_valid(index, 0)) ? 0 : -1;
+    }
+    if (index_size != 0) { // highly associative: hashed lookup
+        return index_find<Tag>(index, tag);
+    }
 
-        // replace slot with new block
-        block.tag = tag;
-        block.valid = true;
-        block.access_ts = 0;
-        block.load_ts = total_loads + total_stores;
-    } else { // no space left in associative cache -> lru or fifo evictions
-        if (is_lru == 1) { // lru
-            evict_by_lru(index, tag);
-        } else { // fifo
-            evict_by_fifo(index, tag);
-        }
+    // compare all of the set's contiguous tags at once; free slots may hold
+    // stale tags, so only matches in valid slots count
+    size_t base = (size_t) index * n_blocks;
+    uint32_t matches = match_set_tags(slots + base, n_blocks, tag);
+    matches &= (uint32_t) (valid_bits[base >> 6] >> (base & 63));
+    if (matches != 0) { // hit
+        return __builtin_ctz(matches);
     }
+    return -1; // miss
 }
 
 /*
- * Update a block at a certain slot within a certain set 
- * during a cache hit.
- * 
+ * Add a block to the cache during a cache miss, evicting the
+ * policy's victim if the set is full.
+ *
  * Parameters:
  *  index - index of cache
  *  tag - target tag of block
- *  block_index - index of block within set
  */
-void CacheSimulator::update_cache_replica(uint32_t index, uint32_t tag, uint32_t block_index) {
+template <class Policy, bool WriteThrough, bool Associative, class Tag>
+void CacheSimulator::add_block_kernel(uint32_t index, Tag tag) {
     Set & target_set = cache[index];
-    Block & block = target_set.blocks[block_index];
 
-    // if write-back and block to be evicted is dirty, write dirty block to memory
-    if (!is_write_through && block.dirty) {
-        total_cycles += 25 * block_size;
-    }
+    if ((uint32_t) n_blocks > target_set.n_valid) { // space left in set?
+        uint32_t block_index = Associative ? first_invalid(index) : 0;
+        size_t slot = (size_t) index * n_blocks + block_index;
 
-    target_set.indices.erase(block.tag); // remove old (tag, block_index) pair from map
-    target_set.indices.insert({tag, block_index}); // add (tag, block_index) pair to set map
-    
-    block.tag = tag; // replace tag
-    // set access_ts to 0
-    uint32_t prev_access_ts = block.access_ts;
-    block.access_ts = 0;
-    // if write-back, mark block as dirty
-    if (!is_write_through) {
-        block.dirty = true;
-    }
+        // fill slot with new block
+        set_tag<Tag>(index, block_index, tag);
+        valid_bits[slot >> 6] |= (uint64_t) 1 << (slot & 63);
+        target_set.n_valid++;
+        if (!WriteThrough) { // if write-back, mark block as dirty
+            set_dirty(index, block_index, true);
+        }
+        static_cast<Policy &>(*replacement).on_fill(index, block_index, false, access_base + total_loads + total_stores);
+    } else if (!Associative) { // no space left in direct-mapped cache
+        // replace slot with new block
+        tag_slots<Tag>()[index] = tag;
+    } else { // no space left in associative cache -> evict the policy's victim
+        Policy & policy = static_cast<Policy &>(*replacement);
+        uint32_t block_index = policy.victim(index);
+
+        // if write-back and block to be evicted is dirty, write dirty block to memory
+        if (!WriteThrough && is_dirty(index, block_index)) {
+            total_cycles += MEMORY_BLOCK_CYCLES(block_size);
+        }
 
-    // update access timestamps of blocks with timestamp < replaced block's timestamp
-    if (is_lru == 1) {
-        update_access_ts(index, tag, prev_access_ts);
+        // replace slot with new block
+        set_tag<Tag>(index, block_index, tag);
+        policy.on_fill(index, block_index, true, access_base + total_loads + total_stores);
     }
 }
 
-/* 
- * Load an address.
- * 
+/*
+ * Load an address, specialized for one configuration.
+ *
  * Parameters:
  *  address - the address in main memory to load
  */
-void CacheSimulator::load(uint32_t address) {
+template <class Policy, bool WriteThrough, bool WriteAllocate, bool Associative, class Tag>
+void CacheSimulator::load_kernel(uint64_t address) {
+    if (needs_wide<Tag>(address)) {
+        widen_tags();
+        load(address);
+        return;
+    }
     uint32_t index = get_index(address);
-    uint32_t tag = get_tag(address);
+    Tag tag = (Tag) get_tag(address);
 
-    int32_t block_index = is_hit(index, tag); 
+    int32_t block_index = lookup<Associative, Tag>(index, tag);
     if (block_index >= 0) { // cache hit
-        if (is_lru == 1) {
-            Block & block = cache[index].blocks[block_index];
-            uint32_t prev_access_ts = block.access_ts; // save access_ts of block
-            block.access_ts = 0; // reset access_ts
-            update_access_ts(index, tag, prev_access_ts); // update counters with access ts < prev_access_ts
-        }
+        static_cast<Policy &>(*replacement).on_hit(index, block_index);
         total_load_hits++;
     } else { // cache miss
-        add_block(index, tag);
+        add_block_kernel<Policy, WriteThrough, Associative, Tag>(index, tag);
         total_load_misses++;
-        total_cycles += 25 * block_size; // load from memory
+        total_cycles += MEMORY_BLOCK_CYCLES(block_size); // load from memory
     }
 
-    total_cycles++; // access data in cache
+    total_cycles += CACHE_ACCESS_CYCLES; // access data in cache
     total_loads++;
 }
 
-/* 
- * Store an address.
- * 
+/*
+ * Store an address, specialized for one configuration.
+ *
  * Parameters:
  *  address - the address in main memory to store
  */
-void CacheSimulator::store(uint32_t address) {
+template <class Policy, bool WriteThrough, bool WriteAllocate, bool Associative, class Tag>
+void CacheSimulator::store_kernel(uint64_t address) {
+    if (needs_wide<Tag>(address)) {
+        widen_tags();
+        store(address);
+        return;
+    }
     uint32_t index = get_index(address);
-    uint32_t tag = get_tag(address);
-    
-    int32_t block_index = is_hit(index, tag);
+    Tag tag = (Tag) get_tag(address);
+
+    int32_t block_index = lookup<Associative, Tag>(index, tag);
     if (block_index >= 0) { // cache hit
         total_store_hits++;
-        if (is_write_through) {
-            total_cycles += 100; // store new value in memory
+        if (WriteThrough) {
+            total_cycles += MEMORY_WORD_CYCLES; // store new value in memory
+        } else {
+            // if block is already dirty, write dirty block to memory
+            if (is_dirty(index, block_index)) {
+                total_cycles += MEMORY_BLOCK_CYCLES(block_size);
+            }
+            set_dirty(index, block_index, true);
         }
-        update_cache_replica(index, tag, block_index);
-        total_cycles++; // store in cache
+        static_cast<Policy &>(*replacement).on_hit(index, block_index);
+        total_cycles += CACHE_ACCESS_CYCLES; // store in cache
     } else { // cache miss
-        if (is_write_allocate) { // retrieve from memory and load into cache
-            add_block(index, tag);
-            total_cycles += 25 * block_size; // retrieve from memory
-            total_cycles++;
+        if (WriteAllocate) { // retrieve from memory and load into cache
+            add_block_kernel<Policy, WriteThrough, Associative, Tag>(index, tag);
+            total_cycles += MEMORY_BLOCK_CYCLES(block_size); // retrieve from memory
+            total_cycles += CACHE_ACCESS_CYCLES;
         } else { // no-write-allocate
-            total_cycles += 100; // store new value in memory
+            total_cycles += MEMORY_WORD_CYCLES; // store new value in memory
         }
         total_store_misses++;
     }
@@ -412,142 +548,480 @@ void CacheSimulator::store(uint32_t address) {
 }
 
 /*
- * Runs the cache simulation. 
+ * Simulates a batch of accesses, specialized for one configuration.
+ *
+ * Parameters:
+ *  accesses - first access to simulate
+ *  n - number of accesses
  */
-void CacheSimulator::run_simulation() {
-    for (unsigned long i = 0; i < file_data.size(); i++) {
-        if (file_data[i].first == 1) { // operation: store
-            store(file_data[i].second);
+template <class Policy, bool WriteThrough, bool WriteAllocate, bool Associative, class Tag>
+void CacheSimulator::replay_kernel(const Access * accesses, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (needs_wide<Tag>(accesses[i].address)) { // finish the batch with 64-bit tags
+            widen_tags();
+            replay(accesses + i, n - i);
+            return;
+        }
+        if ((accesses[i].address & (block_size - 1)) + accesses[i].size > (uint64_t) block_size) {
+            // crosses into the next block: one access per block
+            if (accesses[i].op == ACCESS_STORE) {
+                store(accesses[i].address, accesses[i].size);
+            } else {
+                load(accesses[i].address, accesses[i].size);
+            }
+            if (sizeof(Tag) < sizeof(uint64_t) && is_wide) { // a block needed 64-bit tags
+                replay(accesses + i + 1, n - i - 1);
+                return;
+            }
+            continue;
+        }
+        if (accesses[i].op == ACCESS_STORE) { // operation: store
+            store_kernel<Policy, WriteThrough, WriteAllocate, Associative, Tag>(accesses[i].address);
         } else { // operation: load
-            load(file_data[i].second);
+            load_kernel<Policy, WriteThrough, WriteAllocate, Associative, Tag>(accesses[i].address);
         }
     }
-    print_counts();
 }
 
 /*
- * Return log2 of an integer.
+ * Looks up the block holding an address without counting the access
+ * or charging cycles, for caches driven by a hierarchy. A hit updates
+ * the replacement metadata and, for writes to a write-back cache,
+ * marks the block dirty.
  *
  * Parameters:
- *  num - the integer to get log2 of
- * 
+ *  address - any address within the block
+ *  is_write - is the block being written?
+ *
  * Returns:
- *  log2 of num
+ *  true if the block is in the cache
  */
-int CacheSimulator::get_log2(int num) {
-    float x = log2(num);
-    x = x + 0.5 - (x < 0);
-    return (int) x;
+template <class Policy, bool Associative, class Tag>
+bool CacheSimulator::access_block_kernel(uint64_t address, bool is_write) {
+    if (needs_wide<Tag>(address)) { // every block held has a narrower tag
+        return false;
+    }
+    uint32_t index = get_index(address);
+    int32_t block_index = lookup<Associative, Tag>(index, (Tag) get_tag(address));
+    if (block_index < 0) {
+        return false;
+    }
+    static_cast<Policy &>(*replacement).on_hit(index, block_index);
+    if (is_write && !is_write_through) {
+        set_dirty(index, block_index, true);
+    }
+    return true;
 }
 
 /*
- * Prints invalid arguments to cerr and returns 1.
+ * Places the block holding an address in the cache, evicting the
+ * policy's victim if its set is full.
  *
- * Returns: 1
+ * Parameters:
+ *  address - any address within the block (must not be in the cache)
+ *  dirty - does the block hold data not yet written back?
+ *
+ * Returns:
+ *  the evicted block, if any
  */
-int invalid_args() {
-    cerr << "Invalid arguments" << endl;
-    return 1;
+template <class Policy, bool Associative, class Tag>
+Eviction CacheSimulator::fill_block_kernel(uint64_t address, bool dirty) {
+    if (needs_wide<Tag>(address)) {
+        widen_tags();
+        return fill_block(address, dirty);
+    }
+    Policy & policy = static_cast<Policy &>(*replacement);
+    uint32_t index = get_index(address);
+    Tag tag = (Tag) get_tag(address);
+    Set & target_set = cache[index];
+    Eviction evicted;
+
+    uint32_t block_index;
+    bool was_valid = target_set.n_valid == (uint32_t) n_blocks;
+    if (!was_valid) { // space left in set
+        block_index = Associative ? first_invalid(index) : 0;
+        size_t slot = (size_t) index * n_blocks + block_index;
+        set_tag<Tag>(index, block_index, tag);
+        valid_bits[slot >> 6] |= (uint64_t) 1 << (slot & 63);
+        target_set.n_valid++;
+    } else { // evict the policy's victim
+        block_index = policy.victim(index);
+        uint64_t old_tag = tag_slots<Tag>()[(size_t) index * n_blocks + block_index];
+        evicted.is_valid = true;
+        evicted.address = (old_tag << tag_shift) | ((uint64_t) index << offset_bits);
+        evicted.is_dirty = is_dirty(index, block_index);
+        set_tag<Tag>(index, block_index, tag);
+    }
+    set_dirty(index, block_index, dirty);
+    policy.on_fill(index, block_index, was_valid, access_base + total_loads + total_stores);
+    return evicted;
 }
 
 /*
- * Load valid arguments and run cache simulation.
- * 
+ * Removes the block holding an address from the cache, if present.
+ *
+ * Parameters:
+ *  address - any address within the block
+ *  was_dirty - receives whether the removed block was dirty
+ *
  * Returns:
- *  0 if cache simulation successful
- *  1 if cache simulation unsuccessful
+ *  true if the block was in the cache
  */
-int main(int argc, char * argv[]) {
-    // validate arguments
-    if (argc < 6 || argc > 7) {
-       return(invalid_args());
+template <class Policy, bool Associative, class Tag>
+bool CacheSimulator::invalidate_block_kernel(uint64_t address, bool & was_dirty) {
+    if (needs_wide<Tag>(address)) { // every block held has a narrower tag
+        return false;
+    }
+    uint32_t index = get_index(address);
+    int32_t block_index = lookup<Associative, Tag>(index, (Tag) get_tag(address));
+    if (block_index < 0) {
+        return false;
+    }
+
+    was_dirty = is_dirty(index, block_index);
+    if (index_size != 0) { // drop the tag while the slot is still valid
+        index_erase<Tag>(index, block_index);
+    }
+    size_t slot = (size_t) index * n_blocks + block_index;
+    valid_bits[slot >> 6] &= ~((uint64_t) 1 << (slot & 63));
+    set_dirty(index, block_index, false);
+    cache[index].n_valid--;
+    static_cast<Policy &>(*replacement).on_invalidate(index, block_index);
+    return true;
+}
+
+/*
+ * Points the kernel pointers at one specialization.
+ */
+template <class Policy, bool WriteThrough, bool WriteAllocate, bool Associative, class Tag>
+void CacheSimulator::bind_kernels() {
+    load_fn = &CacheSimulator::load_kernel<Policy, WriteThrough, WriteAllocate, Associative, Tag>;
+    store_fn = &CacheSimulator::store_kernel<Policy, WriteThrough, WriteAllocate, Associative, Tag>;
+    replay_fn = &CacheSimulator::replay_kernel<Policy, WriteThrough, WriteAllocate, Associative, Tag>;
+    access_block_fn = &CacheSimulator::access_block_kernel<Policy, Associative, Tag>;
+    fill_block_fn = &CacheSimulator::fill_block_kernel<Policy, Associative, Tag>;
+    invalidate_block_fn = &CacheSimulator::invalidate_block_kernel<Policy, Associative, Tag>;
+}
+
+/*
+ * Picks the kernels of a policy matching the write policies.
+ */
+template <class Policy, bool Associative, class Tag>
+static void bind_write_kernels(CacheSimulator & cache) {
+    if (cache.is_write_through && cache.is_write_allocate) {
+        cache.bind_kernels<Policy, true, true, Associative, Tag>();
+    } else if (cache.is_write_through) {
+        cache.bind_kernels<Policy, true, false, Associative, Tag>();
+    } else if (cache.is_write_allocate) {
+        cache.bind_kernels<Policy, false, true, Associative, Tag>();
     } else {
-        vector< pair<int, uint32_t> > file_data;
-        // read in memory trace data
-        string trace_data;
-        while (getline(cin, trace_data)) {
-            stringstream ss(trace_data);
-            string fields[3], field; // fields[0]: s or l, fields[1]: memory address (0xhexadecimal), fields[2]: integer (ignore)
-            int counter = 0;
-            while (ss >> field) {
-                fields[counter] = field;
-                counter++;
-            }
+        cache.bind_kernels<Policy, false, false, Associative, Tag>();
+    }
+}
 
-            // store data from each line in a vector
-            // pair with fields[0] and fields[1] stored in vector; fields[2] is ignored for this assignment
-            string address = fields[1].erase(0, 2); // removes 0x from the beginning of address
-            bool is_store = fields[0] == "s";
-            file_data.push_back(make_pair(is_store, std::stoul(address, nullptr, 16)));
-        }
+/*
+ * Picks the kernels of a policy matching the write policies and tag width.
+ */
+template <class Policy, bool Associative>
+static void bind_tag_kernels(CacheSimulator & cache) {
+    if (cache.is_wide) {
+        bind_write_kernels<Policy, Associative, uint64_t>(cache);
+    } else {
+        bind_write_kernels<Policy, Associative, uint32_t>(cache);
+    }
+}
 
-        int n_sets, n_blocks, block_size;
-        try {
-            n_sets = atoi(argv[1]);
-            n_blocks = atoi(argv[2]);
-            block_size = atoi(argv[3]);
-        } catch (std::exception & e) {
-            return(invalid_args());
+/*
+ * Creates the replacement policy and picks the kernels matching
+ * the configuration. Called once by the constructors.
+ */
+void CacheSimulator::select_kernels() {
+    if (n_blocks == 1) { // direct-mapped: nothing to replace
+        replacement.reset(new NoReplacement());
+    } else {
+        switch (eviction) {
+        case EVICT_LRU:
+            replacement.reset(new LruPolicy(n_sets, n_blocks));
+            break;
+        case EVICT_TREE_PLRU:
+            replacement.reset(new TreePlruPolicy(n_sets, n_blocks));
+            break;
+        case EVICT_BIT_PLRU:
+            replacement.reset(new BitPlruPolicy(n_sets, n_blocks));
+            break;
+        case EVICT_SRRIP:
+        case EVICT_BRRIP:
+        case EVICT_DRRIP:
+            replacement.reset(new RripPolicy(n_sets, n_blocks, eviction));
+            break;
+        case EVICT_RANDOM:
+            replacement.reset(new RandomPolicy(n_blocks));
+            break;
+        case EVICT_LFU:
+            replacement.reset(new LfuPolicy(n_sets, n_blocks));
+            break;
+        case EVICT_CLOCK:
+            replacement.reset(new ClockPolicy(n_sets, n_blocks));
+            break;
+        default: // fifo, also used when an associative cache was given no policy
+            replacement.reset(new FifoPolicy(n_sets, n_blocks));
+            break;
         }
+    }
+    bind_policy_kernels();
+}
 
-        // if n_sets is 0, negative, or not power of 2, error
-        // if n_blocks is 0, negative, or not power of 2, error
-        // if block_size is less than 4 or not power of 2, error
-        if (n_sets <= 0 || (n_sets & (n_sets - 1)) != 0 
-            || n_blocks <= 0 || (n_blocks & (n_blocks - 1)) != 0 
-            || block_size < 4 || (block_size & (block_size - 1)) != 0) {
-            return(invalid_args());
-        }
+/*
+ * Picks the kernels matching the configuration and the current tag
+ * width, for the replacement policy already created.
+ */
+void CacheSimulator::bind_policy_kernels() {
+    if (n_blocks == 1) {
+        bind_tag_kernels<NoReplacement, false>(*this);
+        return;
+    }
 
-        bool is_write_allocate;
-        // argv[3] must be "write-allocate" or "no-write-allocate"
-        if (strcmp(argv[4], "write-allocate" ) == 0 ) {
-            is_write_allocate = true;
-        } else if ( strcmp(argv[4], "no-write-allocate" ) == 0) {
-            is_write_allocate = false;
-        } else {
-            return(invalid_args());
-        }
+    switch (eviction) {
+    case EVICT_LRU:
+        bind_tag_kernels<LruPolicy, true>(*this);
+        break;
+    case EVICT_TREE_PLRU:
+        bind_tag_kernels<TreePlruPolicy, true>(*this);
+        break;
+    case EVICT_BIT_PLRU:
+        bind_tag_kernels<BitPlruPolicy, true>(*this);
+        break;
+    case EVICT_SRRIP:
+    case EVICT_BRRIP:
+    case EVICT_DRRIP:
+        bind_tag_kernels<RripPolicy, true>(*this);
+        break;
+    case EVICT_RANDOM:
+        bind_tag_kernels<RandomPolicy, true>(*this);
+        break;
+    case EVICT_LFU:
+        bind_tag_kernels<LfuPolicy, true>(*this);
+        break;
+    case EVICT_CLOCK:
+        bind_tag_kernels<ClockPolicy, true>(*this);
+        break;
+    default:
+        bind_tag_kernels<FifoPolicy, true>(*this);
+        break;
+    }
+}
 
-        bool is_write_through;
-        // argv[4] must be "write-through" or "write-back"
-        if (strcmp(argv[5], "write-through" ) == 0) {
-            // is_write_through is true
-            is_write_through = true;
-        } else if (strcmp(argv[5], "write-back" ) == 0) {
-            // is_write_through is false
-            is_write_through = false;
-        } else {
-            return(invalid_args());
-        }
-        // no-write-allocate cannot be combined with with write-back
-        if (!is_write_allocate && !is_write_through) {
-            return(invalid_args());
+/* 
+ * Load an address. A load that crosses into the next block is split
+ * into a load of every block it touches.
+ * 
+ * Parameters:
+ *  address - the address in main memory to load
+ *  size - bytes loaded (0 if unknown)
+ */
+void CacheSimulator::load(uint64_t address, uint32_t size) {
+    uint64_t n = blocks_spanned(address, size);
+    (this->*load_fn)(address);
+    if (n > 1) {
+        total_split_accesses++;
+        for (uint64_t i = 1; i < n; i++) {
+            (this->*load_fn)(((address >> offset_bits) + i) << offset_bits);
         }
+    }
+}
 
-        // check if lru/fifo arg provided
-        if (argc > 6) {
-            int is_lru;
-            if (strcmp(argv[6], "lru") == 0 ) {
-                is_lru = 1;
-            } else if (strcmp(argv[6], "fifo" ) == 0) {
-                is_lru = 0;
-            } else {
-                return(invalid_args());
-            }
-            // construct CacheSimulator with is_lru arg
-            CacheSimulator * cache = new CacheSimulator(n_sets, n_blocks, block_size, is_write_allocate, is_write_through, is_lru, file_data);
-            cache->run_simulation();
-        } else {
-            // if no lru/fifo arg provided, cache must be direct-mapped
-            if (n_blocks != 1) {
-                return(invalid_args());
-            }
-            // construct CacheSimulator without is_lru arg
-            CacheSimulator * cache = new CacheSimulator(n_sets, n_blocks, block_size, is_write_allocate, is_write_through, file_data);
-            cache->run_simulation();
+/* 
+ * Store an address. A store that crosses into the next block is split
+ * into a store to every block it touches.
+ * 
+ * Parameters:
+ *  address - the address in main memory to store
+ *  size - bytes stored (0 if unknown)
+ */
+void CacheSimulator::store(uint64_t address, uint32_t size) {
+    uint64_t n = blocks_spanned(address, size);
+    (this->*store_fn)(address);
+    if (n > 1) {
+        total_split_accesses++;
+        for (uint64_t i = 1; i < n; i++) {
+            (this->*store_fn)(((address >> offset_bits) + i) << offset_bits);
         }
     }
+}
+
+/*
+ * Simulates a batch of accesses.
+ *
+ * Parameters:
+ *  accesses - first access to simulate
+ *  n - number of accesses
+ */
+void CacheSimulator::replay(const Access * accesses, size_t n) {
+    (this->*replay_fn)(accesses, n);
+}
+
+/*
+ * Looks up the block holding an address for a hierarchy (see
+ * access_block_kernel()).
+ *
+ * Parameters:
+ *  address - any address within the block
+ *  is_write - is the block being written?
+ *
+ * Returns:
+ *  true if the block is in the cache
+ */
+bool CacheSimulator::access_block(uint64_t address, bool is_write) {
+    return (this->*access_block_fn)(address, is_write);
+}
+
+/*
+ * Places the block holding an address in the cache for a hierarchy
+ * (see fill_block_kernel()).
+ *
+ * Parameters:
+ *  address - any address within the block (must not be in the cache)
+ *  dirty - does the block hold data not yet written back?
+ *
+ * Returns:
+ *  the evicted block, if any
+ */
+Eviction CacheSimulator::fill_block(uint64_t address, bool dirty) {
+    return (this->*fill_block_fn)(address, dirty);
+}
+
+/*
+ * Removes the block holding an address from the cache, if present.
+ *
+ * Parameters:
+ *  address - any address within the block
+ *  was_dirty - receives whether the removed block was dirty
+ *
+ * Returns:
+ *  true if the block was in the cache
+ */
+bool CacheSimulator::invalidate_block(uint64_t address, bool & was_dirty) {
+    return (this->*invalidate_block_fn)(address, was_dirty);
+}
+
+/*
+ * Returns true if the block holding an address is in the cache, without
+ * updating anything.
+ *
+ * Parameters:
+ *  address - any address within the block
+ */
+bool CacheSimulator::contains(uint64_t address) {
+    return is_hit(get_index(address), get_tag(address)) >= 0;
+}
+
+/*
+ * Runs the cache simulation. 
+ */
+void CacheSimulator::run_simulation() {
+    replay(file_data.data(), file_data.size());
+    print_counts();
+}
+
+/*
+ * Return log2 of an integer.
+ *
+ * Parameters:
+ *  num - the integer to get log2 of
+ * 
+ * Returns:
+ *  log2 of num
+ */
+int CacheSimulator::get_log2(int num) {
+    float x = log2(num);
+    x = x + 0.5 - (x < 0);
+    return (int) x;
+}
+
+/*
+ * Parses and validates a cache configuration given as command line fields:
+ * n_sets n_blocks block_size write-allocate|no-write-allocate
+ * write-through|write-back [eviction policy, see parse_eviction_policy()]
+ *
+ * Parameters:
+ *  args - the fields
+ *  n_args - number of fields (5 or 6)
+ *  config - receives the configuration
+ *
+ * Returns:
+ *  CONFIG_VALID if the configuration is valid
+ *  CONFIG_BAD_VALUE if a field is malformed
+ *  CONFIG_BAD_COMBINATION if the fields are valid but cannot be combined
+ */
+int parse_cache_config(const char * const * args, int n_args, CacheConfig & config) {
+    if (n_args < 5 || n_args > 6) {
+        return CONFIG_BAD_VALUE;
+    }
+
+    config.n_sets = atoi(args[0]);
+    config.n_blocks = atoi(args[1]);
+    config.block_size = atoi(args[2]);
 
-	return 0;
-}
\ No newline at end of file
+    // args[3] must be "write-allocate" or "no-write-allocate"
+    if (strcmp(args[3], "write-allocate" ) == 0 ) {
+        config.is_write_allocate = true;
+    } else if ( strcmp(args[3], "no-write-allocate" ) == 0) {
+        config.is_write_allocate = false;
+    } else {
+        return CONFIG_BAD_VALUE;
+    }
+
+    // args[4] must be "write-through" or "write-back"
+    if (strcmp(args[4], "write-through" ) == 0) {
+        config.is_write_through = true;
+    } else if (strcmp(args[4], "write-back" ) == 0) {
+        config.is_write_through = false;
+    } else {
+        return CONFIG_BAD_VALUE;
+    }
+
+    // check if eviction policy arg provided
+    config.eviction = EVICT_NONE;
+    if (n_args > 5 && !parse_eviction_policy(args[5], config.eviction)) {
+        return CONFIG_BAD_VALUE;
+    }
+    return validate_cache_config(config);
+}
+
+/*
+ * Validates a cache configuration, however it was filled in: set and
+ * block counts must be positive powers of 2, the block size a power of 2
+ * of at least 4 bytes, no-write-allocate needs write-through, and only a
+ * direct-mapped cache may leave the eviction policy out.
+ *
+ * Parameters:
+ *  config - the configuration
+ *
+ * Returns:
+ *  CONFIG_VALID if the configuration is valid
+ *  CONFIG_BAD_VALUE if a field is out of range
+ *  CONFIG_BAD_COMBINATION if the fields are valid but cannot be combined
+ */
+int validate_cache_config(const CacheConfig & config) {
+    // if n_sets is 0, negative, or not power of 2, error
+    // if n_blocks is 0, negative, or not power of 2, error
+    // if block_size is less than 4 or not power of 2, error
+    if (config.n_sets <= 0 || (config.n_sets & (config.n_sets - 1)) != 0 
+        || config.n_blocks <= 0 || (config.n_blocks & (config.n_blocks - 1)) != 0 
+        || config.block_size < 4 || (config.block_size & (config.block_size - 1)) != 0) {
+        return CONFIG_BAD_VALUE;
+    }
+    if (config.eviction < EVICT_NONE || config.eviction > EVICT_CLOCK) {
+        return CONFIG_BAD_VALUE;
+    }
+
+    // no-write-allocate cannot be combined with with write-back
+    if (!config.is_write_allocate && !config.is_write_through) {
+        return CONFIG_BAD_COMBINATION;
+    }
+    // if no eviction policy arg provided, cache must be direct-mapped
+    if (config.eviction == EVICT_NONE && config.n_blocks != 1) {
+        return CONFIG_BAD_COMBINATION;
+    }
+    return CONFIG_VALID;
+}
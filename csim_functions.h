@@ -8,23 +8,86 @@
 #ifndef __CSIM_FUNCTIONS_H__
 #define __CSIM_FUNCTIONS_H__
 #include <vector>
-#include <map>
 #include <utility>
+#include <memory>
+#include <ostream>
 #include <string.h>
 
-using namespace std;
+#include "csim_trace.h"
+#include "csim_policy.h"
 
-struct Block {
-    uint32_t tag;
-    bool valid = false;
-    bool dirty = false;
-    uint32_t load_ts;
-    uint32_t access_ts;
-}; 
+// cache parameters, as given on the command line (the defaults are a
+// valid direct-mapped cache of one 16-byte block)
+struct CacheConfig {
+    int n_sets = 1;
+    int n_blocks = 1;
+    int block_size = 16;
+    bool is_write_allocate = true;
+    bool is_write_through = false;
+    int eviction = EVICT_NONE; // EvictionPolicy, EVICT_NONE if not given (direct-mapped)
+};
+
+// results of parse_cache_config()
+#define CONFIG_VALID 0
+#define CONFIG_BAD_VALUE 1
+#define CONFIG_BAD_COMBINATION 2
+
+/*
+ * Parses and validates a cache configuration given as command line fields:
+ * n_sets n_blocks block_size write-allocate|no-write-allocate
+ * write-through|write-back [eviction policy, see parse_eviction_policy()]
+ *
+ * Parameters:
+ *  args - the fields
+ *  n_args - number of fields (5 or 6)
+ *  config - receives the configuration
+ *
+ * Returns:
+ *  CONFIG_VALID if the configuration is valid
+ *  CONFIG_BAD_VALUE if a field is malformed
+ *  CONFIG_BAD_COMBINATION if the fields are valid but cannot be combined
+ */
+int parse_cache_config(const char * const * args, int n_args, CacheConfig & config);
 
+/*
+ * Validates a cache configuration, however it was filled in: set and
+ * block counts must be positive powers of 2, the block size a power of 2
+ * of at least 4 bytes, no-write-allocate needs write-through, and only a
+ * direct-mapped cache may leave the eviction policy out.
+ *
+ * Parameters:
+ *  config - the configuration
+ *
+ * Returns:
+ *  CONFIG_VALID if the configuration is valid
+ *  CONFIG_BAD_VALUE if a field is out of range
+ *  CONFIG_BAD_COMBINATION if the fields are valid but cannot be combined
+ */
+int validate_cache_config(const CacheConfig & config);
+
+// cost model of the simulator, in cycles
+#define CACHE_ACCESS_CYCLES 1   // a load or store served by the cache
+#define MEMORY_WORD_CYCLES 100  // a 4-byte store straight to memory (write-through)
+// moving a block of block_size bytes to or from memory
+#define MEMORY_BLOCK_CYCLES(block_size) (MEMORY_WORD_CYCLES / 4 * (uint64_t) (block_size))
+
+// sets with more blocks than this are looked up through a hashed tag index
+// instead of a vectorized scan of their tags (simd.match_tags handles up to 32)
+#define HASH_MIN_BLOCKS 32
+
+/*
+ * Bookkeeping of one set. The blocks themselves are kept by CacheSimulator
+ * in flat per-field arrays, n_blocks consecutive slots per set.
+ */
 struct Set {
-    std::vector<Block> blocks; // vector of blocks
-    std::map<uint32_t, uint32_t> indices; // map of tag to index of slot
+    uint32_t n_valid = 0; // number of valid blocks
+};
+
+// a block evicted by CacheSimulator::fill_block()
+struct Eviction {
+    bool is_valid = false; // was a block evicted?
+    uint64_t address = 0;  // address of the block's first byte
+    bool is_dirty = false; // must the block be written back?
 };
 
 class CacheSimulator {
@@ -35,11 +98,36 @@ public:
     int block_size;
     bool is_write_allocate;
     bool is_write_through;
-    int is_lru;
+    int eviction;
 
-    // content
-    std::vector<Set> cache; // vector of all sets of blocks in the cache
-    std::vector< std::pair<int, uint32_t> > file_data; // vector of pairs of (load/store instruction, address)
+    // address split, precomputed from the arguments
+    uint32_t offset_bits = 0; // log2(block_size)
+    uint32_t index_mask = 0;  // n_sets - 1
+    uint32_t tag_shift = 0;   // log2(block_size) + log2(n_sets)
+    uint64_t wide_mask = 0;   // address bits whose tags need more than 32 bits
+
+    // content: block fields live in separate flat arrays, indexed by
+    // index * n_blocks + slot, so a set's tags are contiguous. Tags are
+    // packed in 32 bits until an address needs a wider one; the cache then
+    // moves them to wide_tags and switches to the 64-bit tag kernels.
+    std::vector<Set> cache; // bookkeeping of all sets in the cache
+    std::vector<uint32_t> tags; // tag of every slot, while all tags fit in 32 bits
+    std::vector<uint64_t> wide_tags; // tag of every slot, once some did not
+    bool is_wide = false; // are the tags in wide_tags?
+    std::vector<uint64_t> valid_bits; // valid bit of every slot
+    std::vector<uint64_t> dirty_bits; // dirty bit of every slot
+    std::vector<uint32_t> tag_index; // per set, open-addressing table of slots hashed by tag
+    uint32_t index_size = 0; // entries per set in tag_index (0 if sets are scanned)
+    std::unique_ptr<ReplacementPolicy> replacement; // replacement metadata, of the policy the kernels were built for
+    std::vector<Access> file_data; // accesses replayed by run_simulation()
+
+    // kernels specialized for this configuration, chosen by select_kernels()
+    void (CacheSimulator::*load_fn)(uint64_t address) = nullptr;
+    void (CacheSimulator::*store_fn)(uint64_t address) = nullptr;
+    void (CacheSimulator::*replay_fn)(const Access * accesses, size_t n) = nullptr;
+    bool (CacheSimulator::*access_block_fn)(uint64_t address, bool is_write) = nullptr;
+    Eviction (CacheSimulator::*fill_block_fn)(uint64_t address, bool dirty) = nullptr;
+    bool (CacheSimulator::*invalidate_block_fn)(uint64_t address, bool & was_dirty) = nullptr;
     
     // statistics
     uint64_t total_loads = 0;
@@ -49,9 +137,11 @@ public:
     uint64_t total_store_hits = 0;
     uint64_t total_store_misses = 0;
     uint64_t total_cycles = 0;
+    uint64_t total_split_accesses = 0; // accesses that crossed into another block, each counted once however many blocks it spans
+    uint64_t access_base = 0; // accesses of the trace simulated elsewhere (set-partitioned runs), for fill times
 
     /*
-     * Constructs a CacheSimulator object without the is_lru parameter.
+     * Constructs a CacheSimulator object without the eviction parameter.
      *
      * Parameters:
      *  n_sets - number of sets in cache
@@ -59,6 +149,7 @@ public:
      *  block_size - size of each block in bytes?
      *  is_write_allocate - is the cache write-allocate or no-write-allocate?
      *  is_write_through - is the cache write-through or write-back?
+     *  file_data - accesses for run_simulation() (may be empty when streaming)
      * 
      * Returns: 
      *  a new CacheSimulator object
@@ -68,10 +159,10 @@ public:
                    const int block_size,  
                    const bool is_write_allocate, 
                    const bool is_write_through,
-                   const std::vector< std::pair<int, uint32_t> > file_data);
+                   std::vector<Access> file_data = std::vector<Access>());
 
     /*
-     * Constructs a CacheSimulator object with the is_lru parameter.
+     * Constructs a CacheSimulator object with the eviction parameter.
      *
      * Parameters:
      *  n_sets - number of sets in cache
@@ -79,7 +170,8 @@ public:
      *  block_size - size of each block in bytes
      *  is_write_allocate - is the cache write-allocate or no-write-allocate?
      *  is_write_through - is the cache write-through or write-back?
-     *  is_lru - does the cache use lru (least-recently-used) or fifo (first-in-first-out) evictions?
+     *  eviction - eviction policy (EVICT_LRU, EVICT_FIFO, ...; 1 and 0 still mean lru and fifo)
+     *  file_data - accesses for run_simulation() (may be empty when streaming)
      * 
      * Returns: 
      *  a new CacheSimulator object
@@ -89,9 +181,20 @@ public:
                    const int block_size, 
                    const bool is_write_allocate, 
                    const bool is_write_through, 
-                   const int is_lru,
-                   const std::vector< std::pair<int, uint32_t> > file_data );
+                   const int eviction,
+                   std::vector<Access> file_data = std::vector<Access>());
     
+    /*
+     * Constructs a CacheSimulator object from a parsed configuration.
+     *
+     * Parameters:
+     *  config - cache configuration
+     * 
+     * Returns: 
+     *  a new CacheSimulator object
+     */
+    explicit CacheSimulator(const CacheConfig & config);
+
     /*
      * Prints statistics. 
      */
@@ -106,7 +209,7 @@ public:
      * Returns:
      *  index
      */
-    uint32_t get_index(uint32_t address);
+    uint32_t get_index(uint64_t address);
 
     /*
      * Gets tag from address.
@@ -117,7 +220,107 @@ public:
      * Returns:
      *  tag
      */
-    uint32_t get_tag(uint32_t address);
+    uint64_t get_tag(uint64_t address);
+
+    /*
+     * Allocates the flat block arrays of every set.
+     */
+    void init_sets();
+
+    /*
+     * Returns true if a slot holds a valid block.
+     *
+     * Parameters:
+     *  index - index of cache
+     *  block_index - index of block within set
+     */
+    bool is_valid(uint32_t index, uint32_t block_index);
+
+    /*
+     * Returns true if a slot holds a dirty block.
+     *
+     * Parameters:
+     *  index - index of cache
+     *  block_index - index of block within set
+     */
+    bool is_dirty(uint32_t index, uint32_t block_index);
+
+    /*
+     * Sets or clears the dirty bit of a slot.
+     *
+     * Parameters:
+     *  index - index of cache
+     *  block_index - index of block within set
+     *  dirty - new value of the dirty bit
+     */
+    void set_dirty(uint32_t index, uint32_t block_index, bool dirty);
+
+    /*
+     * Returns the first slot of a set that holds no valid block.
+     *
+     * Parameters:
+     *  index - index of cache (must have a free slot)
+     */
+    uint32_t first_invalid(uint32_t index);
+
+    /*
+     * Returns the tags of every slot, in the array of width Tag.
+     */
+    template <class Tag>
+    Tag * tag_slots();
+
+    /*
+     * Returns true if an address has a tag wider than Tag, so the cache
+     * must widen its tags before holding it.
+     */
+    template <class Tag>
+    bool needs_wide(uint64_t address) const {
+        return sizeof(Tag) < sizeof(uint64_t) && (address & wide_mask) != 0;
+    }
+
+    /*
+     * Moves the tags to 64-bit storage and switches to the kernels for it.
+     */
+    void widen_tags();
+
+    /*
+     * Stores a new tag in a slot, keeping the tag index up to date.
+     *
+     * Parameters:
+     *  index - index of cache
+     *  block_index - index of block within set
+     *  tag - new tag of block
+     */
+    template <class Tag>
+    void set_tag(uint32_t index, uint32_t block_index, Tag tag);
+
+    /*
+     * Returns the home position of a tag in a set's tag index (the same
+     * for a tag that fits in 32 bits whichever width it is stored in).
+     */
+    uint32_t index_home(uint64_t tag);
+
+    /*
+     * Looks up a tag in a set's tag index.
+     *
+     * Returns:
+     *  index of block within set if found
+     *  -1 if not found
+     */
+    template <class Tag>
+    int32_t index_find(uint32_t index, Tag tag);
+
+    /*
+     * Removes the entry of a valid slot from a set's tag index.
+     */
+    template <class Tag>
+    void index_erase(uint32_t index, uint32_t block_index);
+
+    /*
+     * Adds the entry of a slot to a set's tag index.
+     */
+    template <class Tag>
+    void index_insert(uint32_t index, uint32_t block_index);
 
     /*
      * Returns true if instruction is cache hit, false if cache miss.
@@ -130,72 +333,224 @@ public:
      *  index of block within set if cache hit
      *  -1 if cache miss
      */
-    int32_t is_hit(uint32_t index, uint32_t tag);
+    int32_t is_hit(uint32_t index, uint64_t tag);
 
     /*
-     * Update access timestamp(s) if using lru evictions
+     * Looks up a tag in a set, with tags of width Tag. Direct-mapped sets
+     * compare their only tag.
      *
      * Parameters:
      *  index - index of cache
      *  tag - target tag of block
-     *  prev_access_ts - access timestamp of previously evicted, replaced, or added block
+     *
+     * Returns:
+     *  index of block within set if cache hit
+     *  -1 if cache miss
      */
-    void update_access_ts(uint32_t index, uint32_t tag, uint32_t prev_access_ts);
+    template <bool Associative, class Tag>
+    int32_t lookup(uint32_t index, Tag tag);
 
     /*
-     * Evict a block from a set within a cache using lru evictions.
+     * Add a block to the cache during a cache miss, evicting the
+     * policy's victim if the set is full.
      *
      * Parameters:
      *  index - index of cache
      *  tag - target tag of block
      */
-    void evict_by_lru(uint32_t index, uint32_t tag);
+    template <class Policy, bool WriteThrough, bool Associative, class Tag>
+    void add_block_kernel(uint32_t index, Tag tag);
 
     /*
-     * Evict a block from a set within a cache using fifo evictions.
+     * Load an address, specialized for one configuration.
      *
      * Parameters:
-     *  index - index of cache
-     *  tag - target tag of block
+     *  address - the address in main memory to load
      */
-    void evict_by_fifo(uint32_t index, uint32_t tag);
+    template <class Policy, bool WriteThrough, bool WriteAllocate, bool Associative, class Tag>
+    void load_kernel(uint64_t address);
 
     /*
-     * Add a block to the cache during a cache miss.
+     * Store an address, specialized for one configuration.
      *
      * Parameters:
-     *  index - index of cache
-     *  tag - target tag of block
+     *  address - the address in main memory to store
      */
-    void add_block(uint32_t index, uint32_t tag);
+    template <class Policy, bool WriteThrough, bool WriteAllocate, bool Associative, class Tag>
+    void store_kernel(uint64_t address);
 
     /*
-     * Update a block at a certain slot within a certain set 
-     * during a cache hit.
-     * 
+     * Simulates a batch of accesses, specialized for one configuration.
+     *
      * Parameters:
-     *  index - index of cache
-     *  tag - target tag of block
-     *  block_index - index of block within set
+     *  accesses - first access to simulate
+     *  n - number of accesses
+     */
+    template <class Policy, bool WriteThrough, bool WriteAllocate, bool Associative, class Tag>
+    void replay_kernel(const Access * accesses, size_t n);
+
+    /*
+     * Looks up the block holding an address without counting the access
+     * or charging cycles, for caches driven by a hierarchy. A hit updates
+     * the replacement metadata and, for writes to a write-back cache,
+     * marks the block dirty.
+     *
+     * Parameters:
+     *  address - any address within the block
+     *  is_write - is the block being written?
+     *
+     * Returns:
+     *  true if the block is in the cache
+     */
+    template <class Policy, bool Associative, class Tag>
+    bool access_block_kernel(uint64_t address, bool is_write);
+
+    /*
+     * Places the block holding an address in the cache, evicting the
+     * policy's victim if its set is full.
+     *
+     * Parameters:
+     *  address - any address within the block (must not be in the cache)
+     *  dirty - does the block hold data not yet written back?
+     *
+     * Returns:
+     *  the evicted block, if any
+     */
+    template <class Policy, bool Associative, class Tag>
+    Eviction fill_block_kernel(uint64_t address, bool dirty);
+
+    /*
+     * Removes the block holding an address from the cache, if present.
+     *
+     * Parameters:
+     *  address - any address within the block
+     *  was_dirty - receives whether the removed block was dirty
+     *
+     * Returns:
+     *  true if the block was in the cache
+     */
+    template <class Policy, bool Associative, class Tag>
+    bool invalidate_block_kernel(uint64_t address, bool & was_dirty);
+
+    /*
+     * Points the kernel pointers at one specialization.
+     */
+    template <class Policy, bool WriteThrough, bool WriteAllocate, bool Associative, class Tag>
+    void bind_kernels();
+
+    /*
+     * Creates the replacement policy and picks the kernels matching
+     * the configuration. Called once by the constructors.
+     */
+    void select_kernels();
+
+    /*
+     * Picks the kernels matching the configuration and the current tag
+     * width, for the replacement policy already created.
+     */
+    void bind_policy_kernels();
+
+    /*
+     * Returns the number of blocks an access touches: 1, unless it runs
+     * past the end of its block (a size of 0 counts as one byte).
+     *
+     * Parameters:
+     *  address - first byte accessed
+     *  size - bytes accessed
      */
-    void update_cache_replica(uint32_t index, uint32_t tag, uint32_t block_index);
+    uint64_t blocks_spanned(uint64_t address, uint32_t size) const {
+        uint64_t last = size > 1 ? address + (size - 1) : address;
+        if (last < address) { // runs off the top of memory
+            last = UINT64_MAX;
+        }
+        return (last >> offset_bits) - (address >> offset_bits) + 1;
+    }
 
     /* 
-     * Load an address.
+     * Load an address. A load that crosses into the next block is split
+     * into a load of every block it touches.
      * 
      * Parameters:
      *  address - the address in main memory to load
+     *  size - bytes loaded (0 if unknown)
      */
-    void load(uint32_t address);
+    void load(uint64_t address, uint32_t size = 0);
 
     /* 
-     * Store an address.
+     * Store an address. A store that crosses into the next block is split
+     * into a store to every block it touches.
      * 
      * Parameters:
      *  address - the address in main memory to store
+     *  size - bytes stored (0 if unknown)
      */
-    void store(uint32_t address);
+    void store(uint64_t address, uint32_t size = 0);
     
+    /*
+     * Simulates a batch of accesses.
+     *
+     * Parameters:
+     *  accesses - first access to simulate
+     *  n - number of accesses
+     */
+    void replay(const Access * accesses, size_t n);
+
+    /*
+     * Looks up the block holding an address for a hierarchy (see
+     * access_block_kernel()).
+     *
+     * Parameters:
+     *  address - any address within the block
+     *  is_write - is the block being written?
+     *
+     * Returns:
+     *  true if the block is in the cache
+     */
+    bool access_block(uint64_t address, bool is_write);
+
+    /*
+     * Places the block holding an address in the cache for a hierarchy
+     * (see fill_block_kernel()).
+     *
+     * Parameters:
+     *  address - any address within the block (must not be in the cache)
+     *  dirty - does the block hold data not yet written back?
+     *
+     * Returns:
+     *  the evicted block, if any
+     */
+    Eviction fill_block(uint64_t address, bool dirty);
+
+    /*
+     * Removes the block holding an address from the cache, if present.
+     *
+     * Parameters:
+     *  address - any address within the block
+     *  was_dirty - receives whether the removed block was dirty
+     *
+     * Returns:
+     *  true if the block was in the cache
+     */
+    bool invalidate_block(uint64_t address, bool & was_dirty);
+
+    /*
+     * Returns true if the block holding an address is in the cache, without
+     * updating anything.
+     *
+     * Parameters:
+     *  address - any address within the block
+     */
+    bool contains(uint64_t address);
+
+    /*
+     * Prints statistics, one per line, each line starting with a prefix.
+     *
+     * Parameters:
+     *  out - stream to print to
+     *  prefix - text to print before each line
+     */
+    void print_counts(std::ostream & out, const char * prefix) const;
+
     /*
      * Runs the cache simulation. 
      */
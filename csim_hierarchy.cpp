@@ -0,0 +1,653 @@
+/*
+ * Cache simulator multi-level hierarchies
+ * CSF Assignment 3
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "csim_hierarchy.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using namespace std;
+
+/*
+ * Parses a latency given as a decimal number of cycles.
+ *
+ * Parameters:
+ *  value - the text
+ *  latency - receives the latency
+ *
+ * Returns:
+ *  true if successful
+ *  false if the text is not a number
+ */
+static bool parse_latency(const string & value, uint32_t & latency) {
+    if (value.empty() || value[0] < '0' || value[0] > '9') {
+        return false;
+    }
+    char * end;
+    unsigned long cycles = strtoul(value.c_str(), &end, 10);
+    if (*end != '\0' || cycles > UINT32_MAX) {
+        return false;
+    }
+    latency = (uint32_t) cycles;
+    return true;
+}
+
+/*
+ * Parses one line of a hierarchy file:
+ *  level NAME n_sets n_blocks block_size allocate write [eviction] [latency=N]
+ *        [inclusion=nine|inclusive|exclusive] [split=instruction|data]
+ *        [prefetch=next-line|stride|stream] [prefetch-degree=N]
+ *  memory [latency=N]
+ *
+ * Parameters:
+ *  fields - the whitespace-separated fields of the line
+ *  config - hierarchy to add the line to
+ *
+ * Returns:
+ *  true if successful
+ *  false if the line is invalid
+ */
+bool parse_hierarchy_line(const vector<string> & fields, HierarchyConfig & config) {
+    size_t n_fields = fields.size();
+    if (fields[0] == "memory") {
+        for (size_t i = 1; i < n_fields; i++) {
+            if (fields[i].compare(0, 8, "latency=") != 0
+                || !parse_latency(fields[i].substr(8), config.memory_latency)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    if (fields[0] != "level" || n_fields < 2) {
+        return false;
+    }
+
+    LevelConfig level;
+    level.name = fields[1];
+
+    // positional fields, as on the command line, up to the first key=value
+    size_t i = 2;
+    const char * args[6];
+    int n_args = 0;
+    while (i < n_fields && fields[i].find('=') == string::npos) {
+        if (n_args == 6) {
+            return false;
+        }
+        args[n_args++] = fields[i++].c_str();
+    }
+    if (parse_cache_config(args, n_args, level.cache) != CONFIG_VALID) {
+        return false;
+    }
+
+    for (; i < n_fields; i++) {
+        size_t equals = fields[i].find('=');
+        string key = fields[i].substr(0, equals);
+        string value = equals == string::npos ? "" : fields[i].substr(equals + 1);
+        if (key == "latency") {
+            if (!parse_latency(value, level.latency)) {
+                return false;
+            }
+        } else if (key == "inclusion") {
+            if (value == "nine") {
+                level.inclusion = INCLUSION_NINE;
+            } else if (value == "inclusive") {
+                level.inclusion = INCLUSION_INCLUSIVE;
+            } else if (value == "exclusive") {
+                level.inclusion = INCLUSION_EXCLUSIVE;
+            } else {
+                return false;
+            }
+        } else if (key == "split") {
+            if (value == "instruction" || value == "data") {
+                level.is_instruction = value == "instruction";
+            } else {
+                return false;
+            }
+        } else if (key == "prefetch") {
+            if (!parse_prefetch_policy(value.c_str(), level.prefetch)) {
+                return false;
+            }
+        } else if (key == "prefetch-degree") {
+            if (!parse_latency(value, level.prefetch_degree) || level.prefetch_degree == 0) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+
+    config.levels.push_back(level);
+    return true;
+}
+
+/*
+ * Checks that the levels of a hierarchy fit together: at least one data
+ * level, at most one split=instruction level among the first two, and
+ * exclusive levels with the block size of the levels above them and
+ * no prefetcher.
+ * Reports the problem to cerr if not.
+ *
+ * Parameters:
+ *  config - hierarchy to check
+ *
+ * Returns:
+ *  true if the hierarchy can be simulated
+ */
+bool check_hierarchy(const HierarchyConfig & config) {
+    const vector<LevelConfig> & levels = config.levels;
+    size_t n_instruction = 0;
+    for (size_t i = 0; i < levels.size(); i++) {
+        n_instruction += levels[i].is_instruction;
+    }
+    if (levels.empty() || n_instruction == levels.size()) {
+        cerr << "Hierarchy has no data levels" << endl;
+        return false;
+    }
+    size_t n_first = n_instruction > 0 ? 2 : 1;
+    if (n_instruction > 1 || (n_instruction == 1 && !levels[0].is_instruction && !levels[1].is_instruction)) {
+        cerr << "Only one of the first two levels may be split=instruction" << endl;
+        return false;
+    }
+
+    // an exclusive level takes the victims of the levels above it whole
+    for (size_t i = n_first; i < levels.size(); i++) {
+        if (levels[i].inclusion != INCLUSION_EXCLUSIVE) {
+            continue;
+        }
+        if (levels[i].prefetch != PREFETCH_NONE) { // it holds no blocks of its own to prefetch into
+            cerr << "Exclusive level " << levels[i].name << " cannot prefetch" << endl;
+            return false;
+        }
+        for (size_t j = (i == n_first ? 0 : i - 1); j < i; j++) {
+            if (levels[j].cache.block_size != levels[i].cache.block_size) {
+                cerr << "Exclusive level " << levels[i].name
+                     << " must have the block size of the levels above it" << endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/*
+ * Reads a hierarchy file, one level per line from the processor outwards.
+ * Blank lines and lines starting with '#' are ignored. The first level may
+ * be split: one of the first two lines is then marked split=instruction
+ * and the other is the data cache, both in front of the same next level.
+ * An exclusive level must have the block size of the levels above it.
+ *
+ * Parameters:
+ *  path - file to read
+ *  config - receives the hierarchy
+ *
+ * Returns:
+ *  true if successful
+ *  false if the file could not be read or is invalid
+ */
+bool read_hierarchy_file(const char * path, HierarchyConfig & config) {
+    ifstream in(path);
+    if (!in) {
+        cerr << "Could not read hierarchy file " << path << endl;
+        return false;
+    }
+
+    string line;
+    int line_no = 0;
+    while (getline(in, line)) {
+        line_no++;
+        stringstream ss(line);
+        vector<string> fields;
+        string field;
+        while (ss >> field) {
+            fields.push_back(field);
+        }
+        if (fields.empty() || fields[0][0] == '#') {
+            continue;
+        }
+        if (!parse_hierarchy_line(fields, config)) {
+            cerr << "Invalid hierarchy line " << line_no << endl;
+            return false;
+        }
+    }
+
+    return check_hierarchy(config);
+}
+
+/*
+ * Constructs a CacheHierarchy object.
+ *
+ * Parameters:
+ *  config - the levels and memory
+ *
+ * Returns:
+ *  a new CacheHierarchy object
+ */
+CacheHierarchy::CacheHierarchy(const HierarchyConfig & config) {
+    this->configs = config.levels;
+    this->memory_latency = config.memory_latency;
+
+    // a split first level is an instruction and a data cache side by side
+    bool is_split = configs.size() > 1 && (configs[0].is_instruction || configs[1].is_instruction);
+    n_first = is_split ? 2 : 1;
+    instruction_level = is_split && configs[1].is_instruction ? 1 : 0;
+    data_level = is_split ? 1 - instruction_level : 0;
+
+    levels.reserve(configs.size());
+    next_level.resize(configs.size());
+    prefetchers.resize(configs.size());
+    for (size_t i = 0; i < configs.size(); i++) {
+        const CacheConfig & cache = configs[i].cache;
+        levels.push_back(CacheSimulator(cache));
+        next_level[i] = i < n_first ? n_first : i + 1;
+        if (configs[i].prefetch != PREFETCH_NONE) {
+            // an evicted block would be gone anyway after a cache's worth of fills
+            uint64_t window = (uint64_t) cache.n_sets * cache.n_blocks;
+            prefetchers[i].reset(new_prefetcher(configs[i].prefetch, cache.block_size, configs[i].prefetch_degree, window));
+        }
+    }
+    stats.assign(configs.size(), LevelStats());
+}
+
+/*
+ * Load an address.
+ *
+ * Parameters:
+ *  address - the address in main memory to load
+ */
+void CacheHierarchy::load(uint64_t address) {
+    bool dirty;
+    total_cycles += access(data_level, address, false, dirty);
+}
+
+/*
+ * Store an address.
+ *
+ * Parameters:
+ *  address - the address in main memory to store
+ */
+void CacheHierarchy::store(uint64_t address) {
+    bool dirty;
+    total_cycles += access(data_level, address, true, dirty);
+}
+
+/*
+ * Fetch an instruction.
+ *
+ * Parameters:
+ *  address - the address in main memory to fetch
+ */
+void CacheHierarchy::fetch(uint64_t address) {
+    bool dirty;
+    total_cycles += access(instruction_level, address, false, dirty);
+}
+
+/*
+ * Simulates a batch of accesses.
+ *
+ * Parameters:
+ *  accesses - first access to simulate
+ *  n - number of accesses
+ */
+void CacheHierarchy::replay(const Access * accesses, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (accesses[i].op == ACCESS_STORE) { // operation: store
+            store(accesses[i].address);
+        } else if (accesses[i].op == ACCESS_IFETCH) { // operation: instruction fetch
+            fetch(accesses[i].address);
+        } else { // operation: load
+            load(accesses[i].address);
+        }
+    }
+}
+
+/*
+ * Prints statistics of every level, then of memory.
+ */
+void CacheHierarchy::print_counts() {
+    print_level_counts(cout);
+    cout << "Total cycles: " << total_cycles << endl;
+}
+
+/*
+ * Prints statistics of every level and memory, without the total cycles.
+ *
+ * Parameters:
+ *  out - stream to print to
+ */
+void CacheHierarchy::print_level_counts(ostream & out) const {
+    for (size_t i = 0; i < levels.size(); i++) {
+        string prefix = configs[i].name + " ";
+        levels[i].print_counts(out, prefix.c_str());
+        out << prefix << "Evictions: " << stats[i].evictions << endl;
+        out << prefix << "Writebacks: " << stats[i].writebacks << endl;
+        out << prefix << "Back-invalidations: " << stats[i].back_invalidations << endl;
+        if (prefetchers[i]) {
+            out << prefix << "Prefetches: " << stats[i].prefetches << endl;
+            out << prefix << "Useful prefetches: " << stats[i].useful_prefetches << endl;
+            out << prefix << "Late prefetches: " << stats[i].late_prefetches << endl;
+            out << prefix << "Polluting prefetches: " << stats[i].polluting_prefetches << endl;
+        }
+    }
+    out << "Memory reads: " << memory_reads << endl;
+    out << "Memory writes: " << memory_writes << endl;
+}
+
+/*
+ * Reads or writes the block holding an address at a level, on behalf of
+ * the processor (a first level) or of the level above. A miss fetches the
+ * block from the next level; exclusive levels hand their blocks up
+ * instead of keeping them.
+ *
+ * Parameters:
+ *  level - level to access (levels.size() for memory)
+ *  address - the address
+ *  is_store - does the access write the block?
+ *  dirty - receives whether the block handed up holds data not yet written back
+ *
+ * Returns:
+ *  cycles spent
+ */
+uint64_t CacheHierarchy::access(size_t level, uint64_t address, bool is_store, bool & dirty) {
+    dirty = false;
+    if (level == levels.size()) { // memory
+        if (is_store) {
+            memory_writes++;
+        } else {
+            memory_reads++;
+        }
+        return memory_latency;
+    }
+
+    CacheSimulator & cache = levels[level];
+    Prefetcher * prefetcher = prefetchers[level].get();
+    size_t next = next_level[level];
+    bool is_exclusive = level >= n_first && configs[level].inclusion == INCLUSION_EXCLUSIVE;
+    uint64_t block = address & ~(uint64_t) (cache.block_size - 1);
+    uint64_t cycles = configs[level].latency;
+    cache.total_cycles += configs[level].latency;
+    if (is_store) {
+        cache.total_stores++;
+    } else {
+        cache.total_loads++;
+    }
+
+    bool lower_dirty;
+    if (cache.access_block(address, is_store)) { // hit
+        int outcome = OUTCOME_HIT;
+        if (prefetcher != nullptr) {
+            unordered_map<uint64_t, uint64_t>::iterator it = prefetcher->pending.find(block);
+            if (it != prefetcher->pending.end()) { // first use of a prefetched block
+                cycles += use_prefetch(level, it->second);
+                prefetcher->pending.erase(it);
+                outcome = OUTCOME_FIRST_USE;
+            }
+        }
+        if (is_store) {
+            cache.total_store_hits++;
+            if (cache.is_write_through) { // store new value in the next level too
+                cycles += access(next, address, true, lower_dirty);
+            }
+        } else {
+            cache.total_load_hits++;
+            if (is_exclusive) { // the block moves up to the level that asked for it
+                cache.invalidate_block(address, dirty);
+            }
+        }
+        if (prefetcher != nullptr) {
+            prefetch(level, address, outcome);
+        }
+        return cycles;
+    }
+
+    // miss
+    if (is_store) {
+        cache.total_store_misses++;
+        if (!cache.is_write_allocate || is_exclusive) { // write around this level
+            cycles += access(next, address, true, lower_dirty);
+            if (prefetcher != nullptr) {
+                prefetch(level, address, OUTCOME_MISS);
+            }
+            return cycles;
+        }
+    } else {
+        cache.total_load_misses++;
+    }
+
+    uint64_t ready_at;
+    if (prefetcher != nullptr && prefetcher->take(block, ready_at)) { // a stream buffer holds the block
+        cycles += use_prefetch(level, ready_at);
+        lower_dirty = false;
+    } else {
+        if (prefetcher != nullptr && prefetcher->was_displaced(block)) {
+            stats[level].polluting_prefetches++;
+        }
+        cycles += access(next, address, false, lower_dirty); // retrieve block from the next level
+    }
+    if (is_exclusive) { // pass the block up without keeping it
+        dirty = lower_dirty;
+        return cycles;
+    }
+
+    bool fill_dirty = lower_dirty || (is_store && !cache.is_write_through);
+    if (cache.is_write_through) { // a write-through level never holds dirty data
+        bool unused;
+        if (is_store) {
+            cycles += access(next, address, true, unused);
+        } else if (lower_dirty) { // dirty block handed up by an exclusive level
+            cycles += write_back(next, address);
+        }
+        fill_dirty = false;
+    }
+    cycles += fill(level, address, fill_dirty);
+    if (prefetcher != nullptr) {
+        prefetch(level, address, OUTCOME_MISS);
+    }
+    return cycles;
+}
+
+/*
+ * Places a block in a level and disposes of the victim: an inclusive
+ * level removes it from the levels above, then it moves down to an
+ * exclusive next level or, if dirty, is written back.
+ *
+ * Parameters:
+ *  level - level to fill
+ *  address - any address within the block (must not be in the level)
+ *  dirty - does the block hold data not yet written back?
+ *  is_prefetch - is the block being prefetched?
+ *
+ * Returns:
+ *  cycles spent
+ */
+uint64_t CacheHierarchy::fill(size_t level, uint64_t address, bool dirty, bool is_prefetch) {
+    Eviction victim = levels[level].fill_block(address, dirty);
+    Prefetcher * prefetcher = prefetchers[level].get();
+    if (prefetcher != nullptr) {
+        prefetcher->n_fills++;
+    }
+    if (!victim.is_valid) {
+        return 0;
+    }
+    stats[level].evictions++;
+    if (prefetcher != nullptr) {
+        prefetcher->pending.erase(victim.address); // an unused prefetch leaves without counting
+        if (is_prefetch) {
+            prefetcher->record_displaced(victim.address);
+        }
+    }
+
+    if (level >= n_first && configs[level].inclusion == INCLUSION_INCLUSIVE) {
+        for (size_t i = 0; i < level; i++) {
+            back_invalidate(i, victim.address, levels[level].block_size, victim.is_dirty);
+        }
+    }
+
+    size_t next = next_level[level];
+    if (next < levels.size() && configs[next].inclusion == INCLUSION_EXCLUSIVE) {
+        // the victim moves down, clean or dirty
+        uint64_t cycles = configs[next].latency;
+        levels[next].total_cycles += configs[next].latency;
+        if (levels[next].access_block(victim.address, victim.is_dirty)) {
+            return cycles;
+        }
+        return cycles + fill(next, victim.address, victim.is_dirty);
+    }
+    if (victim.is_dirty) {
+        stats[level].writebacks++;
+        return write_back(next, victim.address);
+    }
+    return 0;
+}
+
+/*
+ * Writes a dirty block back into a level. A write-back level that holds
+ * the block absorbs it; otherwise it continues to the next level.
+ *
+ * Parameters:
+ *  level - level to write to (levels.size() for memory)
+ *  address - any address within the block
+ *
+ * Returns:
+ *  cycles spent
+ */
+uint64_t CacheHierarchy::write_back(size_t level, uint64_t address) {
+    if (level == levels.size()) { // memory
+        memory_writes++;
+        return memory_latency;
+    }
+
+    CacheSimulator & cache = levels[level];
+    uint64_t cycles = configs[level].latency;
+    cache.total_cycles += configs[level].latency;
+    if (!cache.is_write_through && cache.access_block(address, true)) { // absorbed
+        return cycles;
+    }
+    stats[level].writebacks++;
+    return cycles + write_back(next_level[level], address);
+}
+
+/*
+ * Removes every block of an address range from a level above an
+ * inclusive level that evicted the range (every earlier level, since
+ * levels are ordered from the processor outwards).
+ *
+ * Parameters:
+ *  level - level to remove the blocks from
+ *  address - first address of the range
+ *  size - size of the range in bytes
+ *  dirty - set if a removed block was dirty
+ */
+void CacheHierarchy::back_invalidate(size_t level, uint64_t address, uint32_t size, bool & dirty) {
+    uint64_t block_size = levels[level].block_size;
+    uint64_t first = address & ~(block_size - 1);
+    uint64_t n_blocks = (address + (size - 1) - first) / block_size + 1; // the range may end at the top of memory
+    for (uint64_t i = 0, block = first; i < n_blocks; i++, block += block_size) {
+        bool was_dirty;
+        if (levels[level].invalidate_block(block, was_dirty)) {
+            stats[level].back_invalidations++;
+            dirty = dirty || was_dirty;
+            if (prefetchers[level]) {
+                prefetchers[level]->pending.erase(block);
+            }
+        }
+    }
+}
+
+/*
+ * Counts a demand access that uses a prefetched block, useful and, if
+ * the block has not arrived yet, late.
+ *
+ * Parameters:
+ *  level - level of the prefetcher
+ *  ready_at - cycle at which the block arrives
+ *
+ * Returns:
+ *  cycles spent waiting for the block
+ */
+uint64_t CacheHierarchy::use_prefetch(size_t level, uint64_t ready_at) {
+    stats[level].useful_prefetches++;
+    if (ready_at <= total_cycles) {
+        return 0;
+    }
+    stats[level].late_prefetches++;
+    return ready_at - total_cycles;
+}
+
+/*
+ * Shows a demand access to a level's prefetcher and fetches the
+ * blocks it asks for that the level does not hold.
+ *
+ * Parameters:
+ *  level - level with a prefetcher
+ *  address - the address accessed
+ *  outcome - OUTCOME_HIT, OUTCOME_MISS or OUTCOME_FIRST_USE
+ */
+void CacheHierarchy::prefetch(size_t level, uint64_t address, int outcome) {
+    Prefetcher & prefetcher = *prefetchers[level];
+    CacheSimulator & cache = levels[level];
+    size_t next = next_level[level];
+    prefetcher.observe(address & ~(uint64_t) (cache.block_size - 1), outcome);
+
+    // fetching only reaches the levels below, so candidates stays intact
+    for (size_t i = 0; i < prefetcher.candidates.size(); i++) {
+        uint64_t block = prefetcher.candidates[i];
+        if (cache.contains(block)) {
+            continue;
+        }
+        stats[level].prefetches++;
+
+        bool dirty;
+        uint64_t ready_at = total_cycles + access(next, block, false, dirty);
+        if (prefetcher.is_buffered()) {
+            if (dirty) { // handed up by an exclusive level: the buffer only keeps clean copies
+                write_back(next, block);
+            }
+            prefetcher.place(block, ready_at);
+            continue;
+        }
+        if (dirty && cache.is_write_through) {
+            write_back(next, block);
+            dirty = false;
+        }
+        fill(level, block, dirty, true);
+        prefetcher.pending[block] = ready_at;
+    }
+}
+
+/*
+ * Simulates the hierarchy described by a file against the trace on stdin.
+ * Usage: csim hierarchy FILE
+ *
+ * Returns:
+ *  0 if the simulation was successful
+ *  1 if the simulation was unsuccessful
+ */
+int hierarchy_main(int argc, char * argv[]) {
+    if (argc != 3) {
+        cerr << "Invalid arguments" << endl;
+        return 1;
+    }
+
+    HierarchyConfig config;
+    if (!read_hierarchy_file(argv[2], config)) {
+        return 1;
+    }
+    CacheHierarchy hierarchy(config);
+
+    bool ok = replay_trace(STDIN_FILENO, [&hierarchy](const Access * accesses, size_t n) {
+        hierarchy.replay(accesses, n);
+    });
+    if (!ok) {
+        return 1;
+    }
+    hierarchy.print_counts();
+    return 0;
+}
@@ -0,0 +1,283 @@
+/*
+ * Cache simulator multi-level hierarchies
+ * CSF Assignment 3
+ */
+
+#ifndef __CSIM_HIERARCHY_H__
+#define __CSIM_HIERARCHY_H__
+#include <vector>
+#include <string>
+#include <memory>
+#include "csim_functions.h"
+#include "csim_prefetch.h"
+
+// how a level relates to the levels above it (closer to the processor)
+#define INCLUSION_NINE 0      // neither inclusive nor exclusive: levels fill and evict independently
+#define INCLUSION_INCLUSIVE 1 // holds every block held above: its evictions back-invalidate the levels above
+#define INCLUSION_EXCLUSIVE 2 // holds only blocks evicted from above: hits move blocks up
+
+// cycles charged when a configuration file gives no latency
+#define DEFAULT_LEVEL_LATENCY 1
+#define DEFAULT_MEMORY_LATENCY 100
+
+// one level of a hierarchy, as given in a hierarchy file
+struct LevelConfig {
+    std::string name;                         // e.g. L1, printed before the level's statistics
+    CacheConfig cache;                        // geometry and policies
+    uint32_t latency = DEFAULT_LEVEL_LATENCY; // cycles per access to the level
+    int inclusion = INCLUSION_NINE;           // relation to the levels above (ignored for the first level)
+    bool is_instruction = false;              // instruction side of a split first level
+    int prefetch = PREFETCH_NONE;             // PrefetchPolicy of the level
+    uint32_t prefetch_degree = 0;             // blocks per prefetch, or stream buffer depth (0 for the default)
+};
+
+// a whole hierarchy, as given in a hierarchy file
+struct HierarchyConfig {
+    std::vector<LevelConfig> levels; // from the processor outwards; the first two may be a split I/D pair
+    uint32_t memory_latency = DEFAULT_MEMORY_LATENCY; // cycles per block read or written in memory
+};
+
+/*
+ * Parses one line of a hierarchy file:
+ *  level NAME n_sets n_blocks block_size allocate write [eviction] [latency=N]
+ *        [inclusion=nine|inclusive|exclusive] [split=instruction|data]
+ *        [prefetch=next-line|stride|stream] [prefetch-degree=N]
+ *  memory [latency=N]
+ *
+ * Parameters:
+ *  fields - the whitespace-separated fields of the line
+ *  config - hierarchy to add the line to
+ *
+ * Returns:
+ *  true if successful
+ *  false if the line is invalid
+ */
+bool parse_hierarchy_line(const std::vector<std::string> & fields, HierarchyConfig & config);
+
+/*
+ * Checks that the levels of a hierarchy fit together: at least one data
+ * level, at most one split=instruction level among the first two, and
+ * exclusive levels with the block size of the levels above them and
+ * no prefetcher.
+ * Reports the problem to cerr if not.
+ *
+ * Parameters:
+ *  config - hierarchy to check
+ *
+ * Returns:
+ *  true if the hierarchy can be simulated
+ */
+bool check_hierarchy(const HierarchyConfig & config);
+
+/*
+ * Reads a hierarchy file, one level per line from the processor outwards.
+ * Blank lines and lines starting with '#' are ignored. The first level may
+ * be split: one of the first two lines is then marked split=instruction
+ * and the other is the data cache, both in front of the same next level.
+ * An exclusive level must have the block size of the levels above it.
+ *
+ * Parameters:
+ *  path - file to read
+ *  config - receives the hierarchy
+ *
+ * Returns:
+ *  true if successful
+ *  false if the file could not be read or is invalid
+ */
+bool read_hierarchy_file(const char * path, HierarchyConfig & config);
+
+// statistics a level keeps on top of its CacheSimulator counters
+struct LevelStats {
+    uint64_t evictions = 0;          // valid blocks replaced
+    uint64_t writebacks = 0;         // dirty blocks written to the next level
+    uint64_t back_invalidations = 0; // blocks removed because an inclusive level below evicted them
+    uint64_t prefetches = 0;         // blocks fetched from the next level by the prefetcher
+    uint64_t useful_prefetches = 0;  // prefetched blocks used by a demand access (late ones included)
+    uint64_t late_prefetches = 0;    // prefetched blocks used before they arrived
+    uint64_t polluting_prefetches = 0; // demand misses on blocks a prefetch had recently evicted
+};
+
+/*
+ * A chain of CacheSimulator levels in front of memory. A miss at one level
+ * fetches the block from the next, and dirty victims are written back to
+ * the next. Each level counts the loads and stores that reach it and the
+ * cycles spent in it in its CacheSimulator statistics. With a split first
+ * level, instruction fetches enter at the instruction cache (counted as
+ * its loads) and data accesses at the data cache; both miss to the same
+ * unified next level.
+ *
+ * A level with a prefetcher fetches the blocks it asks for from the next
+ * level (counted there as loads) without charging the accesses that
+ * triggered them. The hierarchy's total cycles serve as the clock: a
+ * prefetched block arrives once the cycles of its fetch have passed, and
+ * a demand access that finds it still on the way waits for the rest.
+ */
+class CacheHierarchy {
+public:
+    std::vector<LevelConfig> configs; // configuration of every level
+    std::vector<CacheSimulator> levels; // the levels, from the processor outwards
+    std::vector<LevelStats> stats; // extra statistics of every level
+    std::vector<size_t> next_level; // level each level misses to (levels.size() for memory)
+    std::vector<std::unique_ptr<Prefetcher>> prefetchers; // prefetcher of every level (null if none)
+    size_t n_first; // number of first levels (2 if split, else 1)
+    size_t data_level; // first level of loads and stores
+    size_t instruction_level; // first level of instruction fetches
+    uint32_t memory_latency;
+
+    // statistics
+    uint64_t memory_reads = 0;
+    uint64_t memory_writes = 0;
+    uint64_t total_cycles = 0;
+
+    /*
+     * Constructs a CacheHierarchy object.
+     *
+     * Parameters:
+     *  config - the levels and memory
+     *
+     * Returns:
+     *  a new CacheHierarchy object
+     */
+    explicit CacheHierarchy(const HierarchyConfig & config);
+
+    /*
+     * Load an address.
+     *
+     * Parameters:
+     *  address - the address in main memory to load
+     */
+    void load(uint64_t address);
+
+    /*
+     * Store an address.
+     *
+     * Parameters:
+     *  address - the address in main memory to store
+     */
+    void store(uint64_t address);
+
+    /*
+     * Fetch an instruction.
+     *
+     * Parameters:
+     *  address - the address in main memory to fetch
+     */
+    void fetch(uint64_t address);
+
+    /*
+     * Simulates a batch of accesses.
+     *
+     * Parameters:
+     *  accesses - first access to simulate
+     *  n - number of accesses
+     */
+    void replay(const Access * accesses, size_t n);
+
+    /*
+     * Prints statistics of every level, then of memory.
+     */
+    void print_counts();
+
+    /*
+     * Prints statistics of every level and memory, without the total cycles.
+     *
+     * Parameters:
+     *  out - stream to print to
+     */
+    void print_level_counts(std::ostream & out) const;
+
+    /*
+     * Reads or writes the block holding an address at a level, on behalf of
+     * the processor (a first level) or of the level above. A miss fetches the
+     * block from the next level; exclusive levels hand their blocks up
+     * instead of keeping them.
+     *
+     * Parameters:
+     *  level - level to access (levels.size() for memory)
+     *  address - the address
+     *  is_store - does the access write the block?
+     *  dirty - receives whether the block handed up holds data not yet written back
+     *
+     * Returns:
+     *  cycles spent
+     */
+    uint64_t access(size_t level, uint64_t address, bool is_store, bool & dirty);
+
+    /*
+     * Places a block in a level and disposes of the victim: an inclusive
+     * level removes it from the levels above, then it moves down to an
+     * exclusive next level or, if dirty, is written back.
+     *
+     * Parameters:
+     *  level - level to fill
+     *  address - any address within the block (must not be in the level)
+     *  dirty - does the block hold data not yet written back?
+     *  is_prefetch - is the block being prefetched?
+     *
+     * Returns:
+     *  cycles spent
+     */
+    uint64_t fill(size_t level, uint64_t address, bool dirty, bool is_prefetch = false);
+
+    /*
+     * Writes a dirty block back into a level. A write-back level that holds
+     * the block absorbs it; otherwise it continues to the next level.
+     *
+     * Parameters:
+     *  level - level to write to (levels.size() for memory)
+     *  address - any address within the block
+     *
+     * Returns:
+     *  cycles spent
+     */
+    uint64_t write_back(size_t level, uint64_t address);
+
+    /*
+     * Removes every block of an address range from a level above an
+     * inclusive level that evicted the range (every earlier level, since
+     * levels are ordered from the processor outwards).
+     *
+     * Parameters:
+     *  level - level to remove the blocks from
+     *  address - first address of the range
+     *  size - size of the range in bytes
+     *  dirty - set if a removed block was dirty
+     */
+    void back_invalidate(size_t level, uint64_t address, uint32_t size, bool & dirty);
+
+    /*
+     * Counts a demand access that uses a prefetched block, useful and, if
+     * the block has not arrived yet, late.
+     *
+     * Parameters:
+     *  level - level of the prefetcher
+     *  ready_at - cycle at which the block arrives
+     *
+     * Returns:
+     *  cycles spent waiting for the block
+     */
+    uint64_t use_prefetch(size_t level, uint64_t ready_at);
+
+    /*
+     * Shows a demand access to a level's prefetcher and fetches the
+     * blocks it asks for that the level does not hold.
+     *
+     * Parameters:
+     *  level - level with a prefetcher
+     *  address - the address accessed
+     *  outcome - OUTCOME_HIT, OUTCOME_MISS or OUTCOME_FIRST_USE
+     */
+    void prefetch(size_t level, uint64_t address, int outcome);
+};
+
+/*
+ * Simulates the hierarchy described by a file against the trace on stdin.
+ * Usage: csim hierarchy FILE
+ *
+ * Returns:
+ *  0 if the simulation was successful
+ *  1 if the simulation was unsuccessful
+ */
+int hierarchy_main(int argc, char * argv[]);
+
+#endif
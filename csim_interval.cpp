@@ -0,0 +1,292 @@
+/*
+ * Cache simulator interval statistics
+ * CSF Assignment 3
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include "csim_interval.h"
+#include "csim_trace.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using namespace std;
+
+/*
+ * Parses an interval parameter given as a decimal number.
+ *
+ * Parameters:
+ *  value - the text
+ *  parameter - receives the number
+ *
+ * Returns:
+ *  true if successful
+ *  false if the text is not a number
+ */
+static bool parse_parameter(const string & value, uint64_t & parameter) {
+    if (value.empty() || value[0] < '0' || value[0] > '9') {
+        return false;
+    }
+    char * end;
+    errno = 0;
+    unsigned long long n = strtoull(value.c_str(), &end, 10);
+    if (*end != '\0' || errno == ERANGE) {
+        return false;
+    }
+    parameter = n;
+    return true;
+}
+
+/*
+ * Parses interval parameters given as comma-separated key=value pairs:
+ * accesses=N or cycles=N (row length), format=csv|json, warmup=N
+ * (accesses) and file=PATH. Missing keys keep their defaults.
+ *
+ * Parameters:
+ *  spec - the pairs, e.g. "accesses=100000,warmup=1000000"
+ *  config - receives the parameters
+ *
+ * Returns:
+ *  true if successful
+ *  false if a pair is malformed or a value out of range
+ */
+bool parse_interval_config(const string & spec, IntervalConfig & config) {
+    stringstream pairs(spec);
+    string pair;
+    bool has_length = false;
+    while (getline(pairs, pair, ',')) {
+        size_t equals = pair.find('=');
+        if (equals == string::npos) {
+            return false;
+        }
+        string key = pair.substr(0, equals);
+        string value = pair.substr(equals + 1);
+        if (key == "accesses" || key == "cycles") {
+            if (has_length || !parse_parameter(value, config.every) || config.every == 0) {
+                return false;
+            }
+            config.is_cycles = key == "cycles";
+            has_length = true;
+        } else if (key == "warmup") {
+            if (!parse_parameter(value, config.warmup)) {
+                return false;
+            }
+        } else if (key == "format") {
+            if (value == "csv") {
+                config.format = INTERVAL_CSV;
+            } else if (value == "json") {
+                config.format = INTERVAL_JSON;
+            } else {
+                return false;
+            }
+        } else if (key == "file") {
+            if (value.empty()) {
+                return false;
+            }
+            config.file = value;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Constructs an IntervalCache object, writing the CSV header if any.
+ *
+ * Parameters:
+ *  config - cache configuration
+ *  interval - interval parameters
+ *  rows - stream to write rows to
+ *
+ * Returns:
+ *  a new IntervalCache object
+ */
+IntervalCache::IntervalCache(const CacheConfig & config, const IntervalConfig & interval, ostream & rows)
+    : cache(config), interval(interval), rows(rows), next_row(interval.every), is_warm(interval.warmup == 0) {
+    // bounds every path through the kernels: a cache access, a store to
+    // memory, and a fill that wrote back a dirty block
+    max_access_cycles = CACHE_ACCESS_CYCLES + MEMORY_WORD_CYCLES + 2 * MEMORY_BLOCK_CYCLES(config.block_size);
+    if (interval.every > 0 && interval.format == INTERVAL_CSV) {
+        rows << "interval,phase,first_access,accesses,loads,stores,load_hits,load_misses,"
+                "store_hits,store_misses,cycles,end_cycle,miss_rate" << endl;
+    }
+}
+
+/*
+ * Returns how many of the next accesses may be simulated at once
+ * without running past the end of the row in progress or the warm-up.
+ *
+ * Parameters:
+ *  n - accesses left in the batch
+ */
+size_t IntervalCache::next_chunk(size_t n) const {
+    uint64_t chunk = n;
+    if (!is_warm) {
+        chunk = min(chunk, interval.warmup - n_accesses);
+    }
+    if (interval.every > 0 && !interval.is_cycles) {
+        chunk = min(chunk, next_row - n_accesses);
+    } else if (interval.every > 0) {
+        // every access costs at least a cycle and at most max_access_cycles
+        // (more only when split), so this many cannot run far past the row
+        chunk = min(chunk, max((uint64_t) 1, (next_row - cache.total_cycles) / max_access_cycles));
+    }
+    return chunk;
+}
+
+/*
+ * Simulates a batch of accesses, writing the rows that end within it.
+ *
+ * Parameters:
+ *  accesses - first access to simulate
+ *  n - number of accesses
+ */
+void IntervalCache::replay(const Access * accesses, size_t n) {
+    if (is_warm && interval.every == 0) { // nothing to watch for
+        cache.replay(accesses, n);
+        n_accesses += n;
+        return;
+    }
+    while (n > 0) {
+        size_t chunk = next_chunk(n);
+        cache.replay(accesses, chunk);
+        accesses += chunk;
+        n -= chunk;
+        n_accesses += chunk;
+
+        if (!is_warm && n_accesses == interval.warmup) {
+            if (interval.every > 0) {
+                write_row();
+            }
+            warm = cache_stats(cache);
+            is_warm = true;
+        }
+        if (interval.every == 0) {
+            continue;
+        }
+        if (!interval.is_cycles && n_accesses == next_row) {
+            write_row();
+            next_row += interval.every;
+        } else if (interval.is_cycles && cache.total_cycles >= next_row) {
+            write_row();
+            next_row = (cache.total_cycles / interval.every + 1) * interval.every;
+        }
+    }
+}
+
+/*
+ * Writes the row in progress, once the trace has ended.
+ */
+void IntervalCache::finish() {
+    if (interval.every > 0) {
+        write_row();
+    }
+    rows.flush();
+}
+
+/*
+ * Writes the row in progress, if it has any accesses, and starts
+ * the next one.
+ */
+void IntervalCache::write_row() {
+    if (n_accesses == row_first) {
+        return;
+    }
+    CacheStats now = cache_stats(cache);
+    uint64_t loads = now.loads - row_start.loads;
+    uint64_t stores = now.stores - row_start.stores;
+    uint64_t misses = now.load_misses - row_start.load_misses + now.store_misses - row_start.store_misses;
+    double miss_rate = loads + stores > 0 ? (double) misses / (loads + stores) : 0.0;
+    // the row that ends the warm-up is still part of it
+    const char * phase = is_warm ? "measured" : "warmup";
+
+    if (interval.format == INTERVAL_CSV) {
+        rows << n_rows << ',' << phase << ',' << row_first << ',' << n_accesses - row_first << ','
+             << loads << ',' << stores << ','
+             << now.load_hits - row_start.load_hits << ',' << now.load_misses - row_start.load_misses << ','
+             << now.store_hits - row_start.store_hits << ',' << now.store_misses - row_start.store_misses << ','
+             << now.cycles - row_start.cycles << ',' << now.cycles << ',' << miss_rate << '\n';
+    } else {
+        rows << "{\"interval\":" << n_rows << ",\"phase\":\"" << phase << "\",\"first_access\":" << row_first
+             << ",\"accesses\":" << n_accesses - row_first << ",\"loads\":" << loads << ",\"stores\":" << stores
+             << ",\"load_hits\":" << now.load_hits - row_start.load_hits
+             << ",\"load_misses\":" << now.load_misses - row_start.load_misses
+             << ",\"store_hits\":" << now.store_hits - row_start.store_hits
+             << ",\"store_misses\":" << now.store_misses - row_start.store_misses
+             << ",\"cycles\":" << now.cycles - row_start.cycles << ",\"end_cycle\":" << now.cycles
+             << ",\"miss_rate\":" << miss_rate << "}\n";
+    }
+    n_rows++;
+    row_first = n_accesses;
+    row_start = now;
+}
+
+/*
+ * Prints the statistics of the accesses after the warm-up, and how
+ * many accesses the warm-up took if there was one.
+ *
+ * Parameters:
+ *  out - stream to print to
+ */
+void IntervalCache::print_counts(ostream & out) {
+    if (!is_warm) { // the trace ended during the warm-up: nothing was measured
+        warm = cache_stats(cache);
+    }
+    cache.total_loads -= warm.loads;
+    cache.total_stores -= warm.stores;
+    cache.total_load_hits -= warm.load_hits;
+    cache.total_load_misses -= warm.load_misses;
+    cache.total_store_hits -= warm.store_hits;
+    cache.total_store_misses -= warm.store_misses;
+    cache.total_cycles -= warm.cycles;
+    cache.total_split_accesses -= warm.split_accesses;
+    cache.print_counts(out, "");
+    if (interval.warmup > 0) {
+        out << "Warm-up accesses: " << min(interval.warmup, n_accesses) << endl;
+    }
+}
+
+/*
+ * Simulates a cache against the trace on stdin, writing interval rows.
+ * Usage: csim --interval SPEC n_sets n_blocks block_size allocate write [eviction]
+ *
+ * Returns:
+ *  0 if the simulation was successful
+ *  1 if the simulation was unsuccessful
+ */
+int interval_main(int argc, char * argv[]) {
+    IntervalConfig interval;
+    CacheConfig config;
+    if (argc < 8 || argc > 9 || !parse_interval_config(argv[2], interval)
+        || parse_cache_config(argv + 3, argc - 3, config) != CONFIG_VALID) {
+        cerr << "Invalid arguments" << endl;
+        return 1;
+    }
+    ofstream file;
+    if (!interval.file.empty()) {
+        file.open(interval.file.c_str());
+        if (!file) {
+            cerr << "Could not open " << interval.file << endl;
+            return 1;
+        }
+    }
+    IntervalCache cache(config, interval, interval.file.empty() ? cout : file);
+
+    bool ok = replay_trace(STDIN_FILENO, [&cache](const Access * accesses, size_t n) {
+        cache.replay(accesses, n);
+    });
+    if (!ok) {
+        return 1;
+    }
+    cache.finish();
+    cache.print_counts(cout);
+    return 0;
+}
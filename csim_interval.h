@@ -0,0 +1,132 @@
+/*
+ * Cache simulator interval statistics
+ * CSF Assignment 3
+ */
+
+#ifndef __CSIM_INTERVAL_H__
+#define __CSIM_INTERVAL_H__
+#include <string>
+#include <ostream>
+#include "csim_functions.h"
+#include "csim_library.h"
+
+// formats of the interval rows
+#define INTERVAL_CSV 0
+#define INTERVAL_JSON 1 // one object per line (JSON Lines)
+
+// interval parameters, as given to --interval
+struct IntervalConfig {
+    uint64_t every = 0;       // accesses or cycles per row (0: no rows, e.g. only a warm-up)
+    bool is_cycles = false;   // is every counted in cycles rather than accesses?
+    int format = INTERVAL_CSV;
+    uint64_t warmup = 0;      // first accesses left out of the final totals
+    std::string file;         // where rows go (empty: stdout, ahead of the totals)
+};
+
+/*
+ * Parses interval parameters given as comma-separated key=value pairs:
+ * accesses=N or cycles=N (row length), format=csv|json, warmup=N
+ * (accesses) and file=PATH. Missing keys keep their defaults.
+ *
+ * Parameters:
+ *  spec - the pairs, e.g. "accesses=100000,warmup=1000000"
+ *  config - receives the parameters
+ *
+ * Returns:
+ *  true if successful
+ *  false if a pair is malformed or a value out of range
+ */
+bool parse_interval_config(const std::string & spec, IntervalConfig & config);
+
+/*
+ * A single cache that also reports how its statistics change over the
+ * trace: every so many accesses or cycles it writes a row with the
+ * counts gathered since the previous row, so warm-up, steady state and
+ * phase changes show up. Batches are cut at row boundaries and handed
+ * to the cache whole, so the simulation kernels run as they do without
+ * rows. The first warmup accesses may be left out of the final totals;
+ * the row in progress is cut when the warm-up ends, so no row mixes the
+ * two.
+ *
+ * Rows of cycles end at the first access at or after each multiple of
+ * the row length, and report the cycle they actually end at.
+ */
+class IntervalCache {
+public:
+    CacheSimulator cache;
+    IntervalConfig interval;
+
+    /*
+     * Constructs an IntervalCache object, writing the CSV header if any.
+     *
+     * Parameters:
+     *  config - cache configuration
+     *  interval - interval parameters
+     *  rows - stream to write rows to
+     *
+     * Returns:
+     *  a new IntervalCache object
+     */
+    IntervalCache(const CacheConfig & config, const IntervalConfig & interval, std::ostream & rows);
+
+    /*
+     * Simulates a batch of accesses, writing the rows that end within it.
+     *
+     * Parameters:
+     *  accesses - first access to simulate
+     *  n - number of accesses
+     */
+    void replay(const Access * accesses, size_t n);
+
+    /*
+     * Writes the row in progress, once the trace has ended.
+     */
+    void finish();
+
+    /*
+     * Prints the statistics of the accesses after the warm-up, and how
+     * many accesses the warm-up took if there was one.
+     *
+     * Parameters:
+     *  out - stream to print to
+     */
+    void print_counts(std::ostream & out);
+
+private:
+    std::ostream & rows;
+    uint64_t n_accesses = 0;       // trace accesses simulated so far
+    uint64_t n_rows = 0;           // rows written so far
+    uint64_t next_row;             // access count or cycle at which the row in progress ends
+    uint64_t row_first = 0;        // first access of the row in progress
+    CacheStats row_start;          // statistics when the row in progress began
+    CacheStats warm;               // statistics when the warm-up ended
+    bool is_warm;                  // has the warm-up ended?
+    uint64_t max_access_cycles;    // most cycles one access within a block costs
+
+    /*
+     * Returns how many of the next accesses may be simulated at once
+     * without running past the end of the row in progress or the warm-up.
+     *
+     * Parameters:
+     *  n - accesses left in the batch
+     */
+    size_t next_chunk(size_t n) const;
+
+    /*
+     * Writes the row in progress, if it has any accesses, and starts
+     * the next one.
+     */
+    void write_row();
+};
+
+/*
+ * Simulates a cache against the trace on stdin, writing interval rows.
+ * Usage: csim --interval SPEC n_sets n_blocks block_size allocate write [eviction]
+ *
+ * Returns:
+ *  0 if the simulation was successful
+ *  1 if the simulation was unsuccessful
+ */
+int interval_main(int argc, char * argv[]);
+
+#endif
@@ -0,0 +1,93 @@
+/*
+ * Cache simulator library interface
+ * CSF Assignment 3
+ */
+
+#include <iostream>
+#include "csim_library.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using namespace std;
+
+/*
+ * Creates a CacheModel object with an empty cache, if its
+ * configuration is valid.
+ *
+ * Parameters:
+ *  config - cache configuration
+ *  result - if not null, receives the result of validate_cache_config()
+ *
+ * Returns:
+ *  the new CacheModel object
+ *  nullptr if the configuration is invalid
+ */
+unique_ptr<CacheModel> CacheModel::create(const CacheConfig & config, int * result) {
+    int valid = validate_cache_config(config);
+    if (result != nullptr) {
+        *result = valid;
+    }
+    if (valid != CONFIG_VALID) {
+        return unique_ptr<CacheModel>();
+    }
+    return unique_ptr<CacheModel>(new CacheModel(config));
+}
+
+/*
+ * Constructs a CacheModel object with an empty cache. The configuration
+ * must be valid (see validate_cache_config(), or use create()).
+ *
+ * Parameters:
+ *  config - cache configuration
+ *
+ * Returns:
+ *  a new CacheModel object
+ */
+CacheModel::CacheModel(const CacheConfig & config) : config(config), cache(new CacheSimulator(config)) {
+}
+
+/*
+ * Simulates a batch of accesses, in order.
+ *
+ * Parameters:
+ *  accesses - first access to simulate
+ *  n - number of accesses
+ */
+void CacheModel::simulate(const Access * accesses, size_t n) {
+    cache->replay(accesses, n);
+}
+
+/*
+ * Returns the statistics a cache has gathered so far.
+ *
+ * Parameters:
+ *  cache - the cache
+ */
+CacheStats cache_stats(const CacheSimulator & cache) {
+    CacheStats stats;
+    stats.loads = cache.total_loads;
+    stats.stores = cache.total_stores;
+    stats.load_hits = cache.total_load_hits;
+    stats.load_misses = cache.total_load_misses;
+    stats.store_hits = cache.total_store_hits;
+    stats.store_misses = cache.total_store_misses;
+    stats.cycles = cache.total_cycles;
+    stats.split_accesses = cache.total_split_accesses;
+    return stats;
+}
+
+/*
+ * Returns the statistics of every access simulated since construction
+ * or the last reset().
+ */
+CacheStats CacheModel::snapshot() const {
+    return cache_stats(*cache);
+}
+
+/*
+ * Empties the cache and zeroes its statistics, as if newly constructed.
+ */
+void CacheModel::reset() {
+    cache.reset(new CacheSimulator(config));
+}
@@ -0,0 +1,109 @@
+/*
+ * Cache simulator library interface
+ * CSF Assignment 3
+ */
+
+#ifndef __CSIM_LIBRARY_H__
+#define __CSIM_LIBRARY_H__
+#include <vector>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include "csim_functions.h"
+
+// statistics of a simulation, the counts print_counts() prints
+struct CacheStats {
+    uint64_t loads = 0;
+    uint64_t stores = 0;
+    uint64_t load_hits = 0;
+    uint64_t load_misses = 0;
+    uint64_t store_hits = 0;
+    uint64_t store_misses = 0;
+    uint64_t cycles = 0;
+    uint64_t split_accesses = 0; // accesses that crossed into another block, each counted once however many blocks it spans
+};
+
+/*
+ * Returns the statistics a cache has gathered so far.
+ *
+ * Parameters:
+ *  cache - the cache
+ */
+CacheStats cache_stats(const CacheSimulator & cache);
+
+/*
+ * A single cache for programs that link against libcsim.a instead of
+ * running csim, e.g. profilers feeding it from instrumentation callbacks.
+ * Accesses are handed over in batches, so the kernel for the
+ * configuration is dispatched once per batch rather than per access.
+ * Nothing is printed; statistics are read with snapshot().
+ */
+class CacheModel {
+public:
+    /*
+     * Creates a CacheModel object with an empty cache, if its
+     * configuration is valid.
+     *
+     * Parameters:
+     *  config - cache configuration
+     *  result - if not null, receives the result of validate_cache_config()
+     *
+     * Returns:
+     *  the new CacheModel object
+     *  nullptr if the configuration is invalid
+     */
+    static std::unique_ptr<CacheModel> create(const CacheConfig & config, int * result = nullptr);
+
+    /*
+     * Constructs a CacheModel object with an empty cache. The configuration
+     * must be valid (see validate_cache_config(), or use create()).
+     *
+     * Parameters:
+     *  config - cache configuration
+     *
+     * Returns:
+     *  a new CacheModel object
+     */
+    explicit CacheModel(const CacheConfig & config);
+
+    /*
+     * Simulates a batch of accesses, in order.
+     *
+     * Parameters:
+     *  accesses - first access to simulate
+     *  n - number of accesses
+     */
+    void simulate(const Access * accesses, size_t n);
+
+    /*
+     * Simulates a batch of accesses, in order.
+     *
+     * Parameters:
+     *  accesses - the accesses
+     */
+    void simulate(const std::vector<Access> & accesses) {
+        simulate(accesses.data(), accesses.size());
+    }
+
+    /*
+     * Returns the statistics of every access simulated since construction
+     * or the last reset().
+     */
+    CacheStats snapshot() const;
+
+    /*
+     * Empties the cache and zeroes its statistics, as if newly constructed.
+     */
+    void reset();
+
+    /*
+     * Returns the configuration of the cache.
+     */
+    const CacheConfig & get_config() const { return config; }
+
+private:
+    CacheConfig config;
+    std::unique_ptr<CacheSimulator> cache;
+};
+
+#endif
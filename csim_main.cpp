@@ -0,0 +1,128 @@
+/*
+ * Cache simulator command line
+ * CSF Assignment 3
+ */
+
+#include <iostream>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "csim_functions.h"
+#include "csim_sweep.h"
+#include "csim_hierarchy.h"
+#include "csim_coherence.h"
+#include "csim_mrc.h"
+#include "csim_sample.h"
+#include "csim_partition.h"
+#include "csim_timing.h"
+#include "csim_interval.h"
+#include "csim_ring.h"
+#include "csim_compress.h"
+#include "csim_trace.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using namespace std;
+
+/*
+ * Prints invalid arguments to cerr and returns 1.
+ *
+ * Returns: 1
+ */
+int invalid_args() {
+    cerr << "Invalid arguments" << endl;
+    return 1;
+}
+
+/*
+ * Converts the trace on stdin to a binary trace on stdout.
+ * Usage: csim convert [fixed|varint] [32|64]
+ * (the address width defaults to 64 bits; 32 keeps fixed records compact)
+ *
+ * Returns:
+ *  0 if conversion successful
+ *  1 if conversion unsuccessful
+ */
+int convert_main(int argc, char * argv[]) {
+    int encoding = TRACE_ENCODING_FIXED;
+    int address_bits = 64;
+    if (argc > 4) {
+        return(invalid_args());
+    }
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "fixed") == 0) {
+            encoding = TRACE_ENCODING_FIXED;
+        } else if (strcmp(argv[i], "varint") == 0) {
+            encoding = TRACE_ENCODING_VARINT;
+        } else if (strcmp(argv[i], "32") == 0 || strcmp(argv[i], "64") == 0) {
+            address_bits = atoi(argv[i]);
+        } else {
+            return(invalid_args());
+        }
+    }
+    return convert_trace(STDIN_FILENO, STDOUT_FILENO, encoding, address_bits) ? 0 : 1;
+}
+
+/*
+ * Load valid arguments and run cache simulation.
+ * 
+ * Returns:
+ *  0 if cache simulation successful
+ *  1 if cache simulation unsuccessful
+ */
+int main(int argc, char * argv[]) {
+    if (argc > 1 && strcmp(argv[1], "convert") == 0) {
+        return convert_main(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "compress") == 0) {
+        return compress_main(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "sweep") == 0) {
+        return sweep_main(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "hierarchy") == 0) {
+        return hierarchy_main(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "coherence") == 0) {
+        return coherence_main(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "mrc") == 0) {
+        return mrc_main(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "live") == 0) {
+        return live_main(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "feed") == 0) {
+        return feed_main(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--sample-sets") == 0) {
+        return sample_main(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--jobs") == 0) {
+        return partition_main(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--timing") == 0) {
+        return timing_main(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--interval") == 0) {
+        return interval_main(argc, argv);
+    }
+
+    // validate arguments
+    CacheConfig config;
+    if (argc < 6 || argc > 7 || parse_cache_config(argv + 1, argc - 1, config) != CONFIG_VALID) {
+       return(invalid_args());
+    }
+    CacheSimulator cache(config);
+
+    bool ok = replay_trace(STDIN_FILENO, [&cache](const Access * accesses, size_t n) {
+        cache.replay(accesses, n);
+    });
+    if (!ok) {
+        return 1;
+    }
+    cache.print_counts();
+
+	return 0;
+}
\ No newline at end of file
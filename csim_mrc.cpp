@@ -0,0 +1,497 @@
+/*
+ * Cache simulator miss-ratio curves
+ * CSF Assignment 3
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <cmath>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "csim_mrc.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using namespace std;
+
+/*
+ * Constructs a StackDistance object.
+ *
+ * Parameters:
+ *  n_sets - number of sets
+ *  block_size - size of each block in bytes
+ *
+ * Returns:
+ *  a new StackDistance object
+ */
+StackDistance::StackDistance(int n_sets, int block_size)
+    : geometry(n_sets, 1, block_size, true, false) {
+    sets.resize(n_sets);
+    histogram.assign(2, 0);
+}
+
+/*
+ * Switches to sampling, before any access.
+ *
+ * Parameters:
+ *  rate - initial sampling rate, in (0, 1]
+ *  max_blocks - sampled blocks tracked at most
+ */
+void StackDistance::sample(double rate, size_t max_blocks) {
+    is_sampled = true;
+    threshold = (uint32_t) ceil(rate * SHARDS_MODULUS);
+    this->max_blocks = max_blocks;
+    buckets.assign(SHARDS_GROUPS * SHARDS_BUCKETS, 0);
+    upper_buckets.assign(SHARDS_GROUPS * SHARDS_BUCKETS, 0);
+    n_sampled.assign(SHARDS_GROUPS, 0);
+}
+
+/*
+ * Returns a well-mixed hash of a block's key (the splitmix64 finalizer),
+ * whose low bits decide sampling and whose next bits pick the group.
+ */
+static uint64_t block_hash(uint64_t key) {
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ULL;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebULL;
+    key ^= key >> 31;
+    return key;
+}
+
+/*
+ * Removes a block from its set's stack.
+ */
+void StackDistance::forget(uint64_t key) {
+    unordered_map<uint64_t, uint32_t>::iterator it = last_use.find(key);
+    SetStack & stack = sets[key & geometry.index_mask];
+    tree_add(stack, it->second, -1);
+    stack.owner[it->second] = STACK_NO_OWNER;
+    stack.n_live--;
+    last_use.erase(it);
+}
+
+/*
+ * Lowers the threshold until the sampled blocks fit in max_blocks,
+ * scaling the counts down to the new rate.
+ */
+void StackDistance::shrink() {
+    while (last_use.size() > max_blocks) {
+        // stop sampling the highest hash, and every block sharing it
+        uint32_t highest = by_hash.top().first;
+        while (!by_hash.empty() && by_hash.top().first >= highest) {
+            forget(by_hash.top().second);
+            by_hash.pop();
+        }
+
+        // what was sampled at the old rate now stands for fewer accesses
+        double scale = (double) highest / threshold;
+        for (size_t i = 0; i < buckets.size(); i++) {
+            buckets[i] *= scale;
+            upper_buckets[i] *= scale;
+        }
+        for (size_t i = 0; i < n_sampled.size(); i++) {
+            n_sampled[i] *= scale;
+        }
+        threshold = highest;
+    }
+}
+
+/*
+ * Adds to the mark of a time in a set's tree.
+ */
+void StackDistance::tree_add(SetStack & stack, uint32_t time, int32_t delta) {
+    uint32_t size = stack.tree.size();
+    for (uint32_t i = time + 1; i <= size; i += i & -i) {
+        stack.tree[i - 1] += delta;
+    }
+}
+
+/*
+ * Returns the number of marks at or before a time in a set's tree.
+ */
+uint32_t StackDistance::tree_prefix(const SetStack & stack, uint32_t time) {
+    uint32_t sum = 0;
+    for (uint32_t i = time + 1; i > 0; i -= i & -i) {
+        sum += stack.tree[i - 1];
+    }
+    return sum;
+}
+
+/*
+ * Renumbers the live times of a set from 0 into a window with room for
+ * at least as many new accesses.
+ */
+void StackDistance::compact(uint32_t index) {
+    SetStack & stack = sets[index];
+    uint32_t window = 2 * stack.n_live > STACK_MIN_WINDOW ? 2 * stack.n_live : STACK_MIN_WINDOW;
+
+    // keep the live owners in time order, moving their last uses along
+    vector<uint64_t> owner(window, STACK_NO_OWNER);
+    uint32_t time = 0;
+    for (uint32_t t = 0; t < stack.clock; t++) {
+        if (stack.owner[t] != STACK_NO_OWNER) {
+            owner[time] = stack.owner[t];
+            last_use[stack.owner[t]] = time;
+            time++;
+        }
+    }
+
+    // the first n_live times are marked: build the tree in one pass
+    stack.tree.assign(window, 0);
+    for (uint32_t i = 1; i <= window; i++) {
+        stack.tree[i - 1] += i <= time ? 1 : 0;
+        uint32_t parent = i + (i & -i);
+        if (parent <= window) {
+            stack.tree[parent - 1] += stack.tree[i - 1];
+        }
+    }
+    stack.owner.swap(owner);
+    stack.clock = time;
+}
+
+/*
+ * Returns the bucket of a distance scaled from a number of sampled
+ * blocks in between, at the current sampling rate.
+ *
+ * Parameters:
+ *  sampled - sampled blocks in between (or an upper bound on them)
+ */
+uint32_t StackDistance::scaled_bucket(double sampled) const {
+    uint64_t scaled = 1 + (uint64_t) (sampled * SHARDS_MODULUS / threshold);
+    uint32_t bucket = scaled <= 1 ? 0 : 64 - __builtin_clzll(scaled - 1);
+    return bucket < SHARDS_BUCKETS ? bucket : SHARDS_BUCKETS - 1;
+}
+
+/*
+ * Records an access.
+ *
+ * Parameters:
+ *  address - the address accessed
+ */
+void StackDistance::access(uint64_t address) {
+    uint32_t index = geometry.get_index(address);
+    uint64_t key = address >> geometry.offset_bits; // the block's number, whose low bits are its index
+    n_accesses++;
+
+    uint64_t hash = 0;
+    uint32_t group = 0;
+    if (is_sampled) {
+        hash = block_hash(key);
+        if ((hash & (SHARDS_MODULUS - 1)) >= threshold) { // not sampled
+            return;
+        }
+        group = (hash >> 24) & (SHARDS_GROUPS - 1);
+        n_sampled[group]++;
+    }
+
+    SetStack & stack = sets[index];
+    if (stack.clock == stack.owner.size()) { // window full
+        compact(index);
+    }
+
+    pair<unordered_map<uint64_t, uint32_t>::iterator, bool> found =
+        last_use.insert(make_pair(key, stack.clock));
+    if (found.second) { // first access to the block
+        cold_misses++;
+        stack.n_live++;
+        if (is_sampled) {
+            by_hash.push(make_pair((uint32_t) (hash & (SHARDS_MODULUS - 1)), key));
+        }
+    } else {
+        // blocks last accessed after this one, plus itself
+        uint32_t last = found.first->second;
+        uint32_t distance = stack.n_live - tree_prefix(stack, last) + 1;
+        if (is_sampled) { // each sampled block in between stands for 1 / rate blocks
+            double sampled = distance - 1;
+            buckets[group * SHARDS_BUCKETS + scaled_bucket(sampled)]++;
+            // about as many blocks as could hide behind this many sampled ones, 95% of the
+            // time (at rate 1 none can)
+            double upper = threshold < SHARDS_MODULUS ? sampled + 1 + 2 * sqrt(sampled + 1) : sampled;
+            upper_buckets[group * SHARDS_BUCKETS + scaled_bucket(upper)]++;
+        } else {
+            if (distance >= histogram.size()) {
+                histogram.resize(2 * distance, 0);
+            }
+            histogram[distance]++;
+        }
+        tree_add(stack, last, -1);
+        stack.owner[last] = STACK_NO_OWNER;
+        found.first->second = stack.clock;
+    }
+    tree_add(stack, stack.clock, 1);
+    stack.owner[stack.clock] = key;
+    stack.clock++;
+
+    if (is_sampled && last_use.size() > max_blocks) {
+        shrink();
+    }
+}
+
+/*
+ * Records a batch of accesses of any kind.
+ *
+ * Parameters:
+ *  accesses - first access to record
+ *  n - number of accesses
+ */
+void StackDistance::replay(const Access * accesses, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        access(accesses[i].address);
+    }
+}
+
+/*
+ * Returns the misses of an LRU cache of the set count with a number of
+ * blocks per set.
+ *
+ * Parameters:
+ *  n_blocks - blocks per set
+ */
+uint64_t StackDistance::misses(uint32_t n_blocks) const {
+    uint64_t hits = 0;
+    for (size_t d = 1; d <= n_blocks && d < histogram.size(); d++) {
+        hits += histogram[d];
+    }
+    return n_accesses - hits;
+}
+
+/*
+ * Estimates the miss ratio of an LRU cache of the set count from the
+ * sampled accesses.
+ *
+ * Parameters:
+ *  n_blocks - blocks per set (a power of two)
+ *  error - receives the half-width of the 95% confidence interval,
+ *          widened by the hits the sampled distances cannot resolve
+ *
+ * Returns:
+ *  the estimated miss ratio
+ *  NAN if fewer than SHARDS_MIN_SAMPLES accesses, or fewer than two
+ *  groups, were sampled
+ */
+double StackDistance::estimate(uint32_t n_blocks, double & error) const {
+    uint32_t last_bucket = 31 - __builtin_clz(n_blocks);
+
+    // with next to nothing sampled, the groups agree by accident (at rate 1
+    // every block is sampled, and the curve is exact however short the trace)
+    double rate = (double) threshold / SHARDS_MODULUS;
+    double total = 0;
+    uint32_t n_groups = 0;
+    for (uint32_t g = 0; g < SHARDS_GROUPS; g++) {
+        total += n_sampled[g];
+        n_groups += n_sampled[g] > 0 ? 1 : 0;
+    }
+    if (rate < 1 && (total < SHARDS_MIN_SAMPLES || n_groups < 2)) {
+        error = INFINITY;
+        return NAN;
+    }
+
+    // each group should have sampled its share of the accesses at the final
+    // rate; dividing its misses by that share, rather than by what it did
+    // sample, corrects for the luck of the draw (SHARDS_adj)
+    double expected = (double) n_accesses * threshold / SHARDS_MODULUS / SHARDS_GROUPS;
+    double ratios[SHARDS_GROUPS];
+    double sum = 0;
+    double unresolved = 0; // hits that may be misses at the upper bounds of their distances
+    for (uint32_t g = 0; g < SHARDS_GROUPS; g++) {
+        double hits = 0;
+        double sure_hits = 0;
+        for (uint32_t b = 0; b <= last_bucket && b < SHARDS_BUCKETS; b++) {
+            hits += buckets[g * SHARDS_BUCKETS + b];
+            sure_hits += upper_buckets[g * SHARDS_BUCKETS + b];
+        }
+        ratios[g] = (n_sampled[g] - hits) / expected;
+        sum += ratios[g];
+        unresolved += hits - sure_hits;
+    }
+    double mean = sum / SHARDS_GROUPS;
+
+    double squares = 0;
+    for (uint32_t g = 0; g < SHARDS_GROUPS; g++) {
+        squares += (ratios[g] - mean) * (ratios[g] - mean);
+    }
+    // blocks are drawn without replacement: at rate 1 nothing is left to chance
+    error = SHARDS_T_QUANTILE * sqrt(squares / (SHARDS_GROUPS - 1) / SHARDS_GROUPS * (1 - rate));
+    if (rate < 1) {
+        error += unresolved / expected / SHARDS_GROUPS;
+    }
+    return mean < 0 ? 0 : (mean > 1 ? 1 : mean);
+}
+
+/*
+ * Returns the bucket of the largest scaled distance, or upper bound on
+ * one, seen while sampling.
+ */
+uint32_t StackDistance::max_bucket() const {
+    uint32_t max = 0;
+    for (size_t i = 0; i < buckets.size(); i++) {
+        if ((buckets[i] > 0 || upper_buckets[i] > 0) && i % SHARDS_BUCKETS > max) {
+            max = i % SHARDS_BUCKETS;
+        }
+    }
+    return max;
+}
+
+/*
+ * Prints miss-ratio curves, one row per power-of-two associativity, from
+ * direct-mapped up to the first associativity that only misses cold.
+ * Sampled curves are estimates, with the half-width of their 95%
+ * confidence interval (n/a where too few accesses were sampled),
+ * followed by the final sampling rate.
+ *
+ * Parameters:
+ *  out - stream to print to
+ *  stacks - stack distances of every set count
+ */
+void print_mrc(ostream & out, const vector<StackDistance> & stacks) {
+    bool is_sampled = !stacks.empty() && stacks[0].is_sampled;
+    out << setw(8) << "sets" << setw(9) << "blocks" << setw(6) << "bytes"
+        << setw(14) << "capacity" << setw(13) << "accesses" << setw(13) << "misses"
+        << setw(12) << "miss_ratio";
+    if (is_sampled) {
+        out << setw(10) << "error";
+    }
+    out << endl;
+
+    for (size_t i = 0; i < stacks.size(); i++) {
+        const StackDistance & stack = stacks[i];
+        uint64_t n_blocks = 1;
+        while (is_sampled) {
+            double error;
+            double ratio = stack.estimate(n_blocks, error);
+            out << setw(8) << stack.geometry.n_sets << setw(9) << n_blocks
+                << setw(6) << stack.geometry.block_size
+                << setw(14) << n_blocks * stack.geometry.n_sets * stack.geometry.block_size
+                << setw(13) << stack.n_accesses;
+            if (std::isnan(ratio)) { // too few samples to say anything
+                out << setw(13) << "n/a" << setw(12) << "n/a" << setw(10) << "n/a" << endl;
+                break;
+            }
+            out << setw(13) << llround(ratio * stack.n_accesses)
+                << setw(12) << fixed << setprecision(6) << ratio
+                << setw(10) << error << endl;
+            if (n_blocks >= ((uint64_t) 1 << stack.max_bucket())) { // beyond every sampled distance
+                break;
+            }
+            n_blocks *= 2;
+        }
+        while (!is_sampled) {
+            uint64_t misses = stack.misses(n_blocks);
+            double ratio = stack.n_accesses > 0 ? (double) misses / stack.n_accesses : 0;
+            out << setw(8) << stack.geometry.n_sets << setw(9) << n_blocks
+                << setw(6) << stack.geometry.block_size
+                << setw(14) << n_blocks * stack.geometry.n_sets * stack.geometry.block_size
+                << setw(13) << stack.n_accesses << setw(13) << misses
+                << setw(12) << fixed << setprecision(6) << ratio << endl;
+            if (misses == stack.cold_misses) {
+                break;
+            }
+            n_blocks *= 2;
+        }
+    }
+
+    for (size_t i = 0; is_sampled && i < stacks.size(); i++) {
+        out << "Sampling rate (" << stacks[i].geometry.n_sets << " sets): "
+            << setprecision(6) << (double) stacks[i].threshold / SHARDS_MODULUS << endl;
+    }
+}
+
+/*
+ * Parses a power of two no smaller than a minimum.
+ *
+ * Returns:
+ *  the value, or 0 if the text is not such a number
+ */
+static int parse_power_of_two(const string & text, int minimum) {
+    char * end;
+    long value = strtol(text.c_str(), &end, 10);
+    if (text.empty() || *end != '\0' || value < minimum || value > (1 << 30) || (value & (value - 1)) != 0) {
+        return 0;
+    }
+    return (int) value;
+}
+
+/*
+ * Computes LRU miss-ratio curves of the trace on stdin in one pass.
+ * Usage: csim mrc [--sets N[,N...]] [--rate R] [--max-blocks N] block_size
+ * Without --sets, the caches are fully associative (one set). --rate or
+ * --max-blocks sample the trace, starting at rate R (default 1) and
+ * tracking at most N blocks per set count (default SHARDS_DEFAULT_MAX_BLOCKS).
+ *
+ * Returns:
+ *  0 if the analysis was successful
+ *  1 if the analysis was unsuccessful
+ */
+int mrc_main(int argc, char * argv[]) {
+    int arg = 2;
+    vector<int> set_counts;
+    bool is_sampled = false;
+    double rate = 1;
+    long max_blocks = SHARDS_DEFAULT_MAX_BLOCKS;
+    while (argc > arg + 1 && strncmp(argv[arg], "--", 2) == 0) {
+        char * end;
+        if (strcmp(argv[arg], "--sets") == 0) {
+            stringstream ss(argv[arg + 1]);
+            string value;
+            while (getline(ss, value, ',')) {
+                int n_sets = parse_power_of_two(value, 1);
+                if (n_sets == 0) {
+                    cerr << "Invalid arguments" << endl;
+                    return 1;
+                }
+                set_counts.push_back(n_sets);
+            }
+        } else if (strcmp(argv[arg], "--rate") == 0) {
+            rate = strtod(argv[arg + 1], &end);
+            if (*end != '\0' || !(rate > 0 && rate <= 1)) {
+                cerr << "Invalid arguments" << endl;
+                return 1;
+            }
+            is_sampled = true;
+        } else if (strcmp(argv[arg], "--max-blocks") == 0) {
+            max_blocks = strtol(argv[arg + 1], &end, 10);
+            if (*end != '\0' || max_blocks < 1) {
+                cerr << "Invalid arguments" << endl;
+                return 1;
+            }
+            is_sampled = true;
+        } else {
+            cerr << "Invalid arguments" << endl;
+            return 1;
+        }
+        arg += 2;
+    }
+    if (set_counts.empty()) {
+        set_counts.push_back(1);
+    }
+    int block_size = argc == arg + 1 ? parse_power_of_two(argv[arg], 4) : 0;
+    if (block_size == 0) {
+        cerr << "Invalid arguments" << endl;
+        return 1;
+    }
+
+    vector<StackDistance> stacks;
+    stacks.reserve(set_counts.size());
+    for (size_t i = 0; i < set_counts.size(); i++) {
+        stacks.push_back(StackDistance(set_counts[i], block_size));
+        if (is_sampled) {
+            stacks.back().sample(rate, max_blocks);
+        }
+    }
+
+    bool ok = replay_trace(STDIN_FILENO, [&stacks](const Access * accesses, size_t n) {
+        for (size_t i = 0; i < stacks.size(); i++) {
+            stacks[i].replay(accesses, n);
+        }
+    });
+    if (!ok) {
+        return 1;
+    }
+    print_mrc(cout, stacks);
+    return 0;
+}
@@ -0,0 +1,220 @@
+/*
+ * Cache simulator miss-ratio curves
+ * CSF Assignment 3
+ */
+
+#ifndef __CSIM_MRC_H__
+#define __CSIM_MRC_H__
+#include <vector>
+#include <queue>
+#include <unordered_map>
+#include <ostream>
+#include "csim_functions.h"
+
+// smallest time window of a set's stack, in accesses
+#define STACK_MIN_WINDOW 64
+
+// owner of a time no block was last accessed at
+#define STACK_NO_OWNER UINT64_MAX
+
+// spatial sampling (SHARDS): a block is sampled if its hash modulo
+// SHARDS_MODULUS is below the threshold, so the rate is threshold / modulus
+#define SHARDS_MODULUS (1 << 24)
+#define SHARDS_DEFAULT_MAX_BLOCKS 8192 // sampled blocks tracked at most, unless given
+#define SHARDS_BUCKETS 64 // power-of-two buckets of scaled distances
+// sampled blocks are split into random groups whose spread gives the error bounds
+#define SHARDS_GROUPS 16
+#define SHARDS_T_QUANTILE 2.131 // Student's t for 95% with SHARDS_GROUPS - 1 degrees of freedom
+// fewest sampled accesses an estimate is given for
+#define SHARDS_MIN_SAMPLES 100
+
+/*
+ * LRU stack distances of a trace (Mattson et al.), for one set count and
+ * block size. An access's stack distance is the number of distinct blocks
+ * of its set accessed since the last access to its block, plus one: an
+ * LRU cache with that many blocks per set (or more) hits, and any smaller
+ * one misses. A histogram of the distances therefore gives the misses of
+ * every associativity in a single pass.
+ *
+ * Each set keeps a Fenwick tree over its recent access times marking the
+ * last access of every block, so the distinct blocks since a time are a
+ * prefix sum away. When the window of times fills up, the live marks are
+ * renumbered from 0 into a window at least twice their number.
+ *
+ * When sampled (SHARDS, Waldspurger et al.), only blocks whose hash falls
+ * below a threshold are tracked, and the sampled blocks between two
+ * accesses to a block stand for that many divided by the sampling rate.
+ * With at most max_blocks tracked, the threshold drops to evict the
+ * blocks of highest hash whenever one more would not fit, and the counts
+ * gathered so far are scaled down to the new rate. Sampled
+ * distances go to power-of-two buckets, kept separately for SHARDS_GROUPS
+ * groups of blocks (by hash); each group yields its own estimate, and
+ * their spread gives the error bounds (random group method).
+ *
+ * A sampled distance only resolves the blocks in between to about one
+ * per sampled block, so a cache smaller than that cannot tell a reuse
+ * with no sampled block in between from a far one. Each sampled reuse is
+ * therefore also bucketed by a plausible upper bound on its distance,
+ * and the hits that would turn into misses at that bound widen the error.
+ */
+class StackDistance {
+public:
+    CacheSimulator geometry; // its address split turns addresses into sets and tags
+    uint64_t n_accesses = 0;
+    uint64_t cold_misses = 0;      // first accesses to a block (infinite distance)
+    std::vector<uint64_t> histogram; // accesses per stack distance (index 0 unused)
+
+    // sampling
+    bool is_sampled = false;
+    uint32_t threshold = SHARDS_MODULUS; // blocks with a lower hash are sampled
+    size_t max_blocks = 0; // sampled blocks tracked at most
+    std::vector<double> buckets; // per group, sampled accesses per bucket of scaled distances
+    std::vector<double> upper_buckets; // per group, sampled accesses per bucket of upper bounds on scaled distances
+    std::vector<double> n_sampled; // per group, sampled accesses
+
+    /*
+     * Constructs a StackDistance object.
+     *
+     * Parameters:
+     *  n_sets - number of sets
+     *  block_size - size of each block in bytes
+     *
+     * Returns:
+     *  a new StackDistance object
+     */
+    StackDistance(int n_sets, int block_size);
+
+    /*
+     * Switches to sampling, before any access.
+     *
+     * Parameters:
+     *  rate - initial sampling rate, in (0, 1]
+     *  max_blocks - sampled blocks tracked at most
+     */
+    void sample(double rate, size_t max_blocks);
+
+    /*
+     * Records an access.
+     *
+     * Parameters:
+     *  address - the address accessed
+     */
+    void access(uint64_t address);
+
+    /*
+     * Records a batch of accesses of any kind.
+     *
+     * Parameters:
+     *  accesses - first access to record
+     *  n - number of accesses
+     */
+    void replay(const Access * accesses, size_t n);
+
+    /*
+     * Returns the misses of an LRU cache of the set count with a number of
+     * blocks per set.
+     *
+     * Parameters:
+     *  n_blocks - blocks per set
+     */
+    uint64_t misses(uint32_t n_blocks) const;
+
+    /*
+     * Estimates the miss ratio of an LRU cache of the set count from the
+     * sampled accesses.
+     *
+     * Parameters:
+     *  n_blocks - blocks per set (a power of two)
+     *  error - receives the half-width of the 95% confidence interval,
+     *          widened by the hits the sampled distances cannot resolve
+     *
+     * Returns:
+     *  the estimated miss ratio
+     *  NAN if fewer than SHARDS_MIN_SAMPLES accesses, or fewer than two
+     *  groups, were sampled
+     */
+    double estimate(uint32_t n_blocks, double & error) const;
+
+    /*
+     * Returns the bucket of the largest scaled distance, or upper bound on
+     * one, seen while sampling.
+     */
+    uint32_t max_bucket() const;
+
+private:
+    // stack of one set
+    struct SetStack {
+        std::vector<uint32_t> tree;  // Fenwick tree over the window, 1 where a block was last accessed
+        std::vector<uint64_t> owner; // block last accessed at each time of the window (STACK_NO_OWNER if none since)
+        uint32_t clock = 0;          // next time of the window
+        uint32_t n_live = 0;         // distinct blocks accessed so far
+    };
+
+    std::vector<SetStack> sets;
+    std::unordered_map<uint64_t, uint32_t> last_use; // per block number, time of the block's last access
+    std::priority_queue<std::pair<uint32_t, uint64_t> > by_hash; // sampled blocks, highest hash first
+
+    /*
+     * Removes a block from its set's stack.
+     */
+    void forget(uint64_t key);
+
+    /*
+     * Lowers the threshold until the sampled blocks fit in max_blocks,
+     * scaling the counts down to the new rate.
+     */
+    void shrink();
+
+    /*
+     * Returns the bucket of a distance scaled from a number of sampled
+     * blocks in between, at the current sampling rate.
+     *
+     * Parameters:
+     *  sampled - sampled blocks in between (or an upper bound on them)
+     */
+    uint32_t scaled_bucket(double sampled) const;
+
+    /*
+     * Adds to the mark of a time in a set's tree.
+     */
+    static void tree_add(SetStack & stack, uint32_t time, int32_t delta);
+
+    /*
+     * Returns the number of marks at or before a time in a set's tree.
+     */
+    static uint32_t tree_prefix(const SetStack & stack, uint32_t time);
+
+    /*
+     * Renumbers the live times of a set from 0 into a window with room for
+     * at least as many new accesses.
+     */
+    void compact(uint32_t index);
+};
+
+/*
+ * Prints miss-ratio curves, one row per power-of-two associativity, from
+ * direct-mapped up to the first associativity that only misses cold.
+ * Sampled curves are estimates, with the half-width of their 95%
+ * confidence interval (n/a where too few accesses were sampled),
+ * followed by the final sampling rate.
+ *
+ * Parameters:
+ *  out - stream to print to
+ *  stacks - stack distances of every set count
+ */
+void print_mrc(std::ostream & out, const std::vector<StackDistance> & stacks);
+
+/*
+ * Computes LRU miss-ratio curves of the trace on stdin in one pass.
+ * Usage: csim mrc [--sets N[,N...]] [--rate R] [--max-blocks N] block_size
+ * Without --sets, the caches are fully associative (one set). --rate or
+ * --max-blocks sample the trace, starting at rate R (default 1) and
+ * tracking at most N blocks per set count (default SHARDS_DEFAULT_MAX_BLOCKS).
+ *
+ * Returns:
+ *  0 if the analysis was successful
+ *  1 if the analysis was unsuccessful
+ */
+int mrc_main(int argc, char * argv[]);
+
+#endif
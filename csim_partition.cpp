@@ -0,0 +1,218 @@
+/*
+ * Cache simulator set-partitioned simulation
+ * CSF Assignment 3
+ */
+
+#include <iostream>
+#include <thread>
+#include <memory>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "csim_partition.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using namespace std;
+
+// most threads a partitioned run starts
+#define PARTITION_MAX_JOBS 1024
+
+/*
+ * Adds a batch, waiting while the queue is full.
+ *
+ * Parameters:
+ *  batch - accesses to add (moved from)
+ */
+void ShardQueue::push(vector<ShardAccess> & batch) {
+    unique_lock<mutex> guard(lock);
+    changed.wait(guard, [this] { return batches.size() < SHARD_QUEUE_DEPTH; });
+    batches.push_back(std::move(batch));
+    changed.notify_all();
+}
+
+/*
+ * Takes the oldest batch, waiting while the queue is empty.
+ *
+ * Parameters:
+ *  batch - receives the accesses
+ *
+ * Returns:
+ *  true if a batch was taken
+ *  false if the queue is empty and closed
+ */
+bool ShardQueue::pop(vector<ShardAccess> & batch) {
+    unique_lock<mutex> guard(lock);
+    changed.wait(guard, [this] { return !batches.empty() || is_closed; });
+    if (batches.empty()) {
+        return false;
+    }
+    batch = std::move(batches.front());
+    batches.pop_front();
+    changed.notify_all();
+    return true;
+}
+
+/*
+ * Tells the shard that no more batches will come.
+ */
+void ShardQueue::close() {
+    lock_guard<mutex> guard(lock);
+    is_closed = true;
+    changed.notify_all();
+}
+
+/*
+ * Simulates the batches of one shard until its queue is closed.
+ *
+ * Parameters:
+ *  cache - simulator of the shard
+ *  queue - queue of the shard
+ */
+static void run_shard(CacheSimulator & cache, ShardQueue & queue) {
+    vector<ShardAccess> batch;
+    while (queue.pop(batch)) {
+        for (size_t i = 0; i < batch.size(); i++) {
+            // fill times count every access of the trace, as in a serial run
+            cache.access_base = batch[i].seq - (cache.total_loads + cache.total_stores);
+            if (batch[i].op == ACCESS_STORE) {
+                cache.store(batch[i].address);
+            } else {
+                cache.load(batch[i].address);
+            }
+        }
+    }
+}
+
+/*
+ * Replays the trace on stdin against one configuration with its sets
+ * split across threads: set index i goes to shard i % n_shards, each
+ * shard simulating its sets on its own CacheSimulator. Sets only
+ * interact through the fill times of fifo, which each shard takes from
+ * the accesses' positions in the trace (see CacheSimulator::access_base),
+ * and through the shared state of drrip, brrip and random, which
+ * therefore run on a single shard. A single shard replays the trace
+ * directly, as a serial run does, without a thread or a queue.
+ *
+ * Parameters:
+ *  config - cache configuration
+ *  n_jobs - number of threads to simulate with
+ *  shards - receives the simulator of every shard
+ *
+ * Returns:
+ *  true if the whole trace was replayed
+ *  false if the trace could not be read
+ */
+bool replay_partitioned(const CacheConfig & config, int n_jobs, vector<CacheSimulator> & shards) {
+    bool is_coupled = config.n_blocks > 1 && (config.eviction == EVICT_DRRIP
+        || config.eviction == EVICT_BRRIP || config.eviction == EVICT_RANDOM);
+    uint32_t n_shards = n_jobs < config.n_sets ? n_jobs : config.n_sets;
+    if (is_coupled || n_shards < 1) {
+        n_shards = 1;
+    }
+
+    shards.clear();
+    if (n_shards == 1) { // nothing to route: skip the queue and sequence numbers
+        shards.push_back(CacheSimulator(config));
+        CacheSimulator & cache = shards[0];
+        return replay_trace(STDIN_FILENO, [&cache](const Access * accesses, size_t n) {
+            cache.replay(accesses, n);
+        });
+    }
+    shards.reserve(n_shards);
+    vector< unique_ptr<ShardQueue> > queues;
+    for (uint32_t i = 0; i < n_shards; i++) {
+        shards.push_back(CacheSimulator(config));
+        queues.push_back(unique_ptr<ShardQueue>(new ShardQueue()));
+    }
+    vector<thread> threads;
+    for (uint32_t i = 0; i < n_shards; i++) {
+        threads.push_back(thread(run_shard, std::ref(shards[i]), std::ref(*queues[i])));
+    }
+
+    // route every access to the shard of its set, in trace order
+    CacheSimulator & geometry = shards[0];
+    vector< vector<ShardAccess> > pending(n_shards);
+    for (uint32_t i = 0; i < n_shards; i++) {
+        pending[i].reserve(SHARD_BATCH_SIZE);
+    }
+    uint64_t seq = 0;
+    uint64_t n_split = 0;
+    bool ok = replay_trace(STDIN_FILENO, [&](const Access * accesses, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            // an access crossing into other blocks becomes one access per block
+            uint64_t n_blocks = geometry.blocks_spanned(accesses[i].address, accesses[i].size);
+            if (n_blocks > 1) {
+                n_split++;
+            }
+            for (uint64_t j = 0; j < n_blocks; j++) {
+                uint64_t address = j == 0 ? accesses[i].address
+                    : ((accesses[i].address >> geometry.offset_bits) + j) << geometry.offset_bits;
+                uint32_t shard = geometry.get_index(address) % n_shards;
+                ShardAccess access = {seq++, address, accesses[i].op};
+                pending[shard].push_back(access);
+                if (pending[shard].size() == SHARD_BATCH_SIZE) {
+                    queues[shard]->push(pending[shard]);
+                    pending[shard].clear();
+                    pending[shard].reserve(SHARD_BATCH_SIZE);
+                }
+            }
+        }
+    });
+
+    for (uint32_t i = 0; i < n_shards; i++) {
+        if (!pending[i].empty()) {
+            queues[i]->push(pending[i]);
+        }
+        queues[i]->close();
+    }
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+    shards[0].total_split_accesses += n_split;
+    return ok;
+}
+
+/*
+ * Simulates one configuration against the trace on stdin, split by set
+ * across threads, and prints the same statistics as a serial run.
+ * Usage: csim --jobs N n_sets n_blocks block_size allocate write [eviction]
+ * N = 0 uses every core.
+ *
+ * Returns:
+ *  0 if the simulation was successful
+ *  1 if the simulation was unsuccessful
+ */
+int partition_main(int argc, char * argv[]) {
+    char * end;
+    long n_jobs = argc > 2 ? strtol(argv[2], &end, 10) : -1;
+    CacheConfig config;
+    if (argc < 8 || argc > 9 || *end != '\0' || n_jobs < 0 || n_jobs > PARTITION_MAX_JOBS
+        || parse_cache_config(argv + 3, argc - 3, config) != CONFIG_VALID) {
+        cerr << "Invalid arguments" << endl;
+        return 1;
+    }
+    if (n_jobs == 0) {
+        n_jobs = thread::hardware_concurrency();
+    }
+
+    vector<CacheSimulator> shards;
+    if (!replay_partitioned(config, (int) n_jobs, shards)) {
+        return 1;
+    }
+
+    // the first shard's counters become the totals
+    CacheSimulator & cache = shards[0];
+    for (size_t i = 1; i < shards.size(); i++) {
+        cache.total_loads += shards[i].total_loads;
+        cache.total_stores += shards[i].total_stores;
+        cache.total_load_hits += shards[i].total_load_hits;
+        cache.total_load_misses += shards[i].total_load_misses;
+        cache.total_store_hits += shards[i].total_store_hits;
+        cache.total_store_misses += shards[i].total_store_misses;
+        cache.total_cycles += shards[i].total_cycles;
+    }
+    cache.print_counts();
+    return 0;
+}
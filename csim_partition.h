@@ -0,0 +1,96 @@
+/*
+ * Cache simulator set-partitioned simulation
+ * CSF Assignment 3
+ */
+
+#ifndef __CSIM_PARTITION_H__
+#define __CSIM_PARTITION_H__
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include "csim_functions.h"
+
+// accesses handed to a shard at a time, and batches queued per shard at most
+#define SHARD_BATCH_SIZE (1 << 16)
+#define SHARD_QUEUE_DEPTH 8
+
+// an access routed to a shard, with its position in the trace
+struct ShardAccess {
+    uint64_t seq;     // number of accesses before it in the trace
+    uint64_t address;
+    uint8_t op;
+};
+
+/*
+ * Bounded queue of access batches from the thread reading the trace to
+ * the thread of one shard.
+ */
+class ShardQueue {
+public:
+    /*
+     * Adds a batch, waiting while the queue is full.
+     *
+     * Parameters:
+     *  batch - accesses to add (moved from)
+     */
+    void push(std::vector<ShardAccess> & batch);
+
+    /*
+     * Takes the oldest batch, waiting while the queue is empty.
+     *
+     * Parameters:
+     *  batch - receives the accesses
+     *
+     * Returns:
+     *  true if a batch was taken
+     *  false if the queue is empty and closed
+     */
+    bool pop(std::vector<ShardAccess> & batch);
+
+    /*
+     * Tells the shard that no more batches will come.
+     */
+    void close();
+
+private:
+    std::mutex lock;
+    std::condition_variable changed;
+    std::deque< std::vector<ShardAccess> > batches;
+    bool is_closed = false;
+};
+
+/*
+ * Replays the trace on stdin against one configuration with its sets
+ * split across threads: set index i goes to shard i % n_shards, each
+ * shard simulating its sets on its own CacheSimulator. Sets only
+ * interact through the fill times of fifo, which each shard takes from
+ * the accesses' positions in the trace (see CacheSimulator::access_base),
+ * and through the shared state of drrip, brrip and random, which
+ * therefore run on a single shard. A single shard replays the trace
+ * directly, as a serial run does, without a thread or a queue.
+ *
+ * Parameters:
+ *  config - cache configuration
+ *  n_jobs - number of threads to simulate with
+ *  shards - receives the simulator of every shard
+ *
+ * Returns:
+ *  true if the whole trace was replayed
+ *  false if the trace could not be read
+ */
+bool replay_partitioned(const CacheConfig & config, int n_jobs, std::vector<CacheSimulator> & shards);
+
+/*
+ * Simulates one configuration against the trace on stdin, split by set
+ * across threads, and prints the same statistics as a serial run.
+ * Usage: csim --jobs N n_sets n_blocks block_size allocate write [eviction]
+ * N = 0 uses every core.
+ *
+ * Returns:
+ *  0 if the simulation was successful
+ *  1 if the simulation was unsuccessful
+ */
+int partition_main(int argc, char * argv[]);
+
+#endif
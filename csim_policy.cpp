@@ -0,0 +1,329 @@
+/*
+ * Cache simulator replacement policies
+ * CSF Assignment 3
+ */
+
+#include <string.h>
+#include "csim_policy.h"
+
+/*
+ * Constructs a LruPolicy object.
+ *
+ * Parameters:
+ *  n_sets - number of sets in cache
+ *  n_blocks - number of blocks per set in cache
+ *
+ * Returns:
+ *  a new LruPolicy object
+ */
+LruPolicy::LruPolicy(uint32_t n_sets, uint32_t n_blocks) {
+    this->n_blocks = n_blocks;
+    prev.assign((size_t) n_sets * n_blocks, NO_BLOCK);
+    next.assign((size_t) n_sets * n_blocks, NO_BLOCK);
+    mru.assign(n_sets, NO_BLOCK);
+    lru.assign(n_sets, NO_BLOCK);
+}
+
+/*
+ * Constructs a FifoPolicy object.
+ *
+ * Parameters:
+ *  n_sets - number of sets in cache
+ *  n_blocks - number of blocks per set in cache
+ *
+ * Returns:
+ *  a new FifoPolicy object
+ */
+FifoPolicy::FifoPolicy(uint32_t n_sets, uint32_t n_blocks) {
+    this->n_blocks = n_blocks;
+    load_ts.assign((size_t) n_sets * n_blocks, 0);
+}
+
+/*
+ * Constructs a TreePlruPolicy object.
+ *
+ * Parameters:
+ *  n_sets - number of sets in cache
+ *  n_blocks - number of blocks per set in cache
+ *
+ * Returns:
+ *  a new TreePlruPolicy object
+ */
+TreePlruPolicy::TreePlruPolicy(uint32_t n_sets, uint32_t n_blocks) {
+    this->n_blocks = n_blocks;
+    words_per_set = (n_blocks + 63) / 64;
+    nodes.assign((size_t) n_sets * words_per_set, 0);
+}
+
+/*
+ * Constructs a BitPlruPolicy object.
+ *
+ * Parameters:
+ *  n_sets - number of sets in cache
+ *  n_blocks - number of blocks per set in cache
+ *
+ * Returns:
+ *  a new BitPlruPolicy object
+ */
+BitPlruPolicy::BitPlruPolicy(uint32_t n_sets, uint32_t n_blocks) {
+    this->n_blocks = n_blocks;
+    used.assign(((size_t) n_sets * n_blocks + 63) / 64, 0);
+    n_used.assign(n_sets, 0);
+}
+
+/*
+ * Marks a slot as used. Setting the last clear bit of a set clears the others.
+ */
+void BitPlruPolicy::touch(uint32_t index, uint32_t block_index) {
+    size_t base = (size_t) index * n_blocks;
+    size_t slot = base + block_index;
+    uint64_t bit = (uint64_t) 1 << (slot & 63);
+    if (used[slot >> 6] & bit) { // already used
+        return;
+    }
+
+    if (n_used[index] + 1 < n_blocks) {
+        used[slot >> 6] |= bit;
+        n_used[index]++;
+        return;
+    }
+
+    // every slot would be used: start a new round with only this one
+    if (n_blocks < 64) { // n_blocks is a power of 2, so the set lies within one word
+        uint64_t set_mask = (((uint64_t) 1 << n_blocks) - 1) << (base & 63);
+        used[base >> 6] &= ~set_mask;
+    } else {
+        for (size_t w = base >> 6; w < (base + n_blocks) >> 6; w++) {
+            used[w] = 0;
+        }
+    }
+    used[slot >> 6] |= bit;
+    n_used[index] = 1;
+}
+
+/*
+ * Returns the first slot of a set whose used bit is clear.
+ */
+uint32_t BitPlruPolicy::victim(uint32_t index) {
+    size_t base = (size_t) index * n_blocks;
+    if (n_blocks < 64) {
+        return __builtin_ctzll(~(used[base >> 6] >> (base & 63)));
+    }
+    for (size_t w = base >> 6; ; w++) {
+        if (~used[w] != 0) {
+            return (uint32_t) ((w << 6) - base) + __builtin_ctzll(~used[w]);
+        }
+    }
+}
+
+// RRIP predictions
+#define RRPV_NEAR 0
+#define RRPV_LONG 2
+#define RRPV_DISTANT 3
+
+// DRRIP set dueling
+#define DRRIP_LEADERS 32     // leader sets per policy
+#define DRRIP_PSEL_MAX 1023  // 10-bit selector
+
+/*
+ * Constructs a RripPolicy object.
+ *
+ * Parameters:
+ *  n_sets - number of sets in cache
+ *  n_blocks - number of blocks per set in cache
+ *  eviction - EVICT_SRRIP, EVICT_BRRIP or EVICT_DRRIP
+ *
+ * Returns:
+ *  a new RripPolicy object
+ */
+RripPolicy::RripPolicy(uint32_t n_sets, uint32_t n_blocks, int eviction) {
+    this->n_blocks = n_blocks;
+    this->eviction = eviction;
+    rrpv.assign((size_t) n_sets * n_blocks, RRPV_DISTANT);
+
+    // spread the leader sets evenly: the first set of every stride leads
+    // for SRRIP and the middle one for BRRIP (a single set has no leaders)
+    uint32_t n_leaders = n_sets / 2 < DRRIP_LEADERS ? n_sets / 2 : DRRIP_LEADERS;
+    leader_stride = n_leaders > 0 ? n_sets / n_leaders : 0;
+}
+
+/*
+ * Returns the prediction for a block filled into a set after a miss,
+ * updating the DRRIP selector when the set is a leader.
+ */
+uint8_t RripPolicy::insertion_rrpv(uint32_t index) {
+    bool is_bimodal = eviction == EVICT_BRRIP;
+    if (eviction == EVICT_DRRIP) {
+        uint32_t position = leader_stride > 0 ? index % leader_stride : 1;
+        if (leader_stride > 0 && position == 0) { // SRRIP leader missed
+            if (psel < DRRIP_PSEL_MAX) {
+                psel++;
+            }
+        } else if (leader_stride > 0 && position == leader_stride / 2) { // BRRIP leader missed
+            is_bimodal = true;
+            if (psel > 0) {
+                psel--;
+            }
+        } else { // follower
+            is_bimodal = psel > DRRIP_PSEL_MAX / 2;
+        }
+    }
+    if (!is_bimodal) {
+        return RRPV_LONG;
+    }
+
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return (rng & 31) == 0 ? RRPV_LONG : RRPV_DISTANT;
+}
+
+/*
+ * Returns the first slot of a set predicted distant, first ageing
+ * the set just enough for one to be.
+ */
+uint32_t RripPolicy::victim(uint32_t index) {
+    uint8_t * set_rrpv = &rrpv[(size_t) index * n_blocks];
+    uint8_t max_rrpv = 0;
+    for (uint32_t i = 0; i < n_blocks; i++) {
+        if (set_rrpv[i] == RRPV_DISTANT) {
+            return i;
+        }
+        max_rrpv = set_rrpv[i] > max_rrpv ? set_rrpv[i] : max_rrpv;
+    }
+
+    uint8_t delta = RRPV_DISTANT - max_rrpv;
+    uint32_t block_index = NO_BLOCK;
+    for (uint32_t i = 0; i < n_blocks; i++) {
+        set_rrpv[i] += delta;
+        if (set_rrpv[i] == RRPV_DISTANT && block_index == NO_BLOCK) {
+            block_index = i;
+        }
+    }
+    return block_index;
+}
+
+/*
+ * Constructs a RandomPolicy object.
+ *
+ * Parameters:
+ *  n_blocks - number of blocks per set in cache
+ *
+ * Returns:
+ *  a new RandomPolicy object
+ */
+RandomPolicy::RandomPolicy(uint32_t n_blocks) {
+    this->n_blocks = n_blocks;
+}
+
+/*
+ * Constructs a LfuPolicy object.
+ *
+ * Parameters:
+ *  n_sets - number of sets in cache
+ *  n_blocks - number of blocks per set in cache
+ *
+ * Returns:
+ *  a new LfuPolicy object
+ */
+LfuPolicy::LfuPolicy(uint32_t n_sets, uint32_t n_blocks) {
+    this->n_blocks = n_blocks;
+    counts.assign((size_t) n_sets * n_blocks, 0);
+}
+
+/*
+ * Halves every counter of a set.
+ */
+void LfuPolicy::age(uint32_t index) {
+    uint8_t * set_counts = &counts[(size_t) index * n_blocks];
+    for (uint32_t i = 0; i < n_blocks; i++) {
+        set_counts[i] >>= 1;
+    }
+}
+
+/*
+ * Returns the first slot of a set with the lowest use count.
+ */
+uint32_t LfuPolicy::victim(uint32_t index) {
+    const uint8_t * set_counts = &counts[(size_t) index * n_blocks];
+    uint32_t block_index = 0;
+    for (uint32_t i = 1; i < n_blocks; i++) {
+        if (set_counts[i] < set_counts[block_index]) {
+            block_index = i;
+        }
+    }
+    return block_index;
+}
+
+/*
+ * Constructs a ClockPolicy object.
+ *
+ * Parameters:
+ *  n_sets - number of sets in cache
+ *  n_blocks - number of blocks per set in cache
+ *
+ * Returns:
+ *  a new ClockPolicy object
+ */
+ClockPolicy::ClockPolicy(uint32_t n_sets, uint32_t n_blocks) {
+    this->n_blocks = n_blocks;
+    referenced.assign(((size_t) n_sets * n_blocks + 63) / 64, 0);
+    hands.assign(n_sets, 0);
+}
+
+/*
+ * Sweeps the hand of a set over referenced slots, clearing their bits,
+ * and returns the first unreferenced one.
+ */
+uint32_t ClockPolicy::victim(uint32_t index) {
+    size_t base = (size_t) index * n_blocks;
+    uint32_t hand = hands[index];
+    while (true) {
+        size_t slot = base + hand;
+        uint64_t bit = (uint64_t) 1 << (slot & 63);
+        if (!(referenced[slot >> 6] & bit)) {
+            hands[index] = hand;
+            return hand;
+        }
+        referenced[slot >> 6] &= ~bit; // second chance
+        hand = (hand + 1) & (n_blocks - 1);
+    }
+}
+
+// command line names, indexed by EvictionPolicy
+static const char * const eviction_names[] = {
+    "fifo", "lru", "tree-plru", "bit-plru", "srrip", "brrip", "drrip", "random", "lfu", "clock"
+};
+#define N_EVICTION_POLICIES (sizeof(eviction_names) / sizeof(eviction_names[0]))
+
+/*
+ * Looks up an eviction policy by its command line name: lru, fifo,
+ * tree-plru, bit-plru, srrip, brrip, drrip, random, lfu or clock.
+ *
+ * Parameters:
+ *  name - name of the policy
+ *  eviction - receives the policy
+ *
+ * Returns:
+ *  true if the name is known
+ *  false otherwise
+ */
+bool parse_eviction_policy(const char * name, int & eviction) {
+    for (size_t i = 0; i < N_EVICTION_POLICIES; i++) {
+        if (strcmp(name, eviction_names[i]) == 0) {
+            eviction = (int) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Returns the command line name of an eviction policy ("-" for EVICT_NONE).
+ */
+const char * eviction_policy_name(int eviction) {
+    if (eviction < 0 || (size_t) eviction >= N_EVICTION_POLICIES) {
+        return "-";
+    }
+    return eviction_names[eviction];
+}
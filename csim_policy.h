@@ -0,0 +1,507 @@
+/*
+ * Cache simulator replacement policies
+ * CSF Assignment 3
+ */
+
+#ifndef __CSIM_POLICY_H__
+#define __CSIM_POLICY_H__
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include "csim_simd.h"
+
+// marks an empty entry of a tag index and the end of a recency list
+#define NO_BLOCK 0xffffffff
+
+// eviction policies of associative caches (lru and fifo keep their old is_lru values)
+enum EvictionPolicy {
+    EVICT_NONE = -1,    // not given: direct-mapped only
+    EVICT_FIFO = 0,     // first-in-first-out
+    EVICT_LRU = 1,      // true least-recently-used
+    EVICT_TREE_PLRU,    // tree pseudo-LRU, n_blocks - 1 bits per set
+    EVICT_BIT_PLRU,     // bit pseudo-LRU (MRU bits), 1 bit per block
+    EVICT_SRRIP,        // static re-reference interval prediction, 2 bits per block
+    EVICT_BRRIP,        // bimodal RRIP, 2 bits per block
+    EVICT_DRRIP,        // dynamic RRIP: set dueling between SRRIP and BRRIP
+    EVICT_RANDOM,       // pseudo-random victim, no metadata
+    EVICT_LFU,          // least-frequently-used, 8-bit aging counters
+    EVICT_CLOCK         // second chance, 1 bit per block and a hand per set
+};
+
+/*
+ * Looks up an eviction policy by its command line name: lru, fifo,
+ * tree-plru, bit-plru, srrip, brrip, drrip, random, lfu or clock.
+ *
+ * Parameters:
+ *  name - name of the policy
+ *  eviction - receives the policy
+ *
+ * Returns:
+ *  true if the name is known
+ *  false otherwise
+ */
+bool parse_eviction_policy(const char * name, int & eviction);
+
+/*
+ * Returns the command line name of an eviction policy ("-" for EVICT_NONE).
+ */
+const char * eviction_policy_name(int eviction);
+
+/*
+ * Replacement metadata of a whole cache. Each policy keeps its own,
+ * separate from the tags, and implements the same non-virtual hooks,
+ * which CacheSimulator's kernels call on the concrete type so they inline:
+ *
+ *  void on_hit(uint32_t index, uint32_t block_index)
+ *      a valid block was accessed
+ *  void on_fill(uint32_t index, uint32_t block_index, bool was_valid, uint64_t now)
+ *      a block was placed in a slot, either a free one or the victim
+ *      (was_valid); now is the number of accesses simulated so far
+ *  uint32_t victim(uint32_t index)
+ *      the slot to evict from a full set
+ *  void on_invalidate(uint32_t index, uint32_t block_index)
+ *      a valid block was removed without replacement (multi-level caches),
+ *      so its slot is free until the next fill
+ */
+class ReplacementPolicy {
+public:
+    virtual ~ReplacementPolicy() {}
+};
+
+/*
+ * Direct-mapped caches have nothing to choose, so they keep no metadata.
+ */
+class NoReplacement : public ReplacementPolicy {
+public:
+    void on_hit(uint32_t, uint32_t) {}
+    void on_fill(uint32_t, uint32_t, bool, uint64_t) {}
+    uint32_t victim(uint32_t) { return 0; }
+    void on_invalidate(uint32_t, uint32_t) {}
+};
+
+/*
+ * Least-recently-used: a doubly-linked recency list per set, threaded
+ * through the slots by slot index, so hits, fills and victims are O(1).
+ */
+class LruPolicy : public ReplacementPolicy {
+public:
+    /*
+     * Constructs a LruPolicy object.
+     *
+     * Parameters:
+     *  n_sets - number of sets in cache
+     *  n_blocks - number of blocks per set in cache
+     *
+     * Returns:
+     *  a new LruPolicy object
+     */
+    LruPolicy(uint32_t n_sets, uint32_t n_blocks);
+
+    void on_hit(uint32_t index, uint32_t block_index) {
+        touch(index, block_index, true);
+    }
+
+    void on_fill(uint32_t index, uint32_t block_index, bool was_valid, uint64_t) {
+        touch(index, block_index, was_valid);
+    }
+
+    uint32_t victim(uint32_t index) {
+        return lru[index]; // the back of the recency list
+    }
+
+    void on_invalidate(uint32_t index, uint32_t block_index) {
+        unlink(index, block_index);
+    }
+
+private:
+    uint32_t n_blocks;
+    std::vector<uint32_t> prev; // next more recently used slot in the set
+    std::vector<uint32_t> next; // next less recently used slot in the set
+    std::vector<uint32_t> mru;  // per set, slot of the most recently used block
+    std::vector<uint32_t> lru;  // per set, slot of the least recently used block
+
+    /*
+     * Removes a block from its set's recency list.
+     *
+     * Parameters:
+     *  index - index of cache
+     *  block_index - index of block within set
+     */
+    void unlink(uint32_t index, uint32_t block_index) {
+        uint32_t * set_prev = &prev[(size_t) index * n_blocks];
+        uint32_t * set_next = &next[(size_t) index * n_blocks];
+
+        if (set_prev[block_index] != NO_BLOCK) {
+            set_next[set_prev[block_index]] = set_next[block_index];
+        } else {
+            mru[index] = set_next[block_index];
+        }
+        if (set_next[block_index] != NO_BLOCK) {
+            set_prev[set_next[block_index]] = set_prev[block_index];
+        } else {
+            lru[index] = set_prev[block_index];
+        }
+    }
+
+    /*
+     * Make a block the most recently used of its set by moving it
+     * to the front of the set's recency list.
+     *
+     * Parameters:
+     *  index - index of cache
+     *  block_index - index of block within set
+     *  is_linked - is the block already in the recency list (false for a new block)?
+     */
+    void touch(uint32_t index, uint32_t block_index, bool is_linked) {
+        uint32_t * set_prev = &prev[(size_t) index * n_blocks];
+        uint32_t * set_next = &next[(size_t) index * n_blocks];
+
+        if (is_linked) {
+            if (mru[index] == block_index) { // already most recently used
+                return;
+            }
+            // unlink block (it has a more recently used neighbour, since it is not the mru)
+            set_next[set_prev[block_index]] = set_next[block_index];
+            if (set_next[block_index] != NO_BLOCK) {
+                set_prev[set_next[block_index]] = set_prev[block_index];
+            } else {
+                lru[index] = set_prev[block_index];
+            }
+        }
+
+        // link block in front of the old mru
+        set_prev[block_index] = NO_BLOCK;
+        set_next[block_index] = mru[index];
+        if (mru[index] != NO_BLOCK) {
+            set_prev[mru[index]] = block_index;
+        } else {
+            lru[index] = block_index;
+        }
+        mru[index] = block_index;
+    }
+};
+
+/*
+ * First-in-first-out: the fill time of every slot; the victim is the
+ * oldest fill (lowest slot on ties), found with a vectorized argmin.
+ */
+class FifoPolicy : public ReplacementPolicy {
+public:
+    /*
+     * Constructs a FifoPolicy object.
+     *
+     * Parameters:
+     *  n_sets - number of sets in cache
+     *  n_blocks - number of blocks per set in cache
+     *
+     * Returns:
+     *  a new FifoPolicy object
+     */
+    FifoPolicy(uint32_t n_sets, uint32_t n_blocks);
+
+    void on_hit(uint32_t, uint32_t) {}
+
+    void on_fill(uint32_t index, uint32_t block_index, bool, uint64_t now) {
+        load_ts[(size_t) index * n_blocks + block_index] = now;
+    }
+
+    uint32_t victim(uint32_t index) {
+        return simd.argmin(&load_ts[(size_t) index * n_blocks], n_blocks);
+    }
+
+    void on_invalidate(uint32_t, uint32_t) {}
+
+private:
+    uint32_t n_blocks;
+    std::vector<uint64_t> load_ts; // fill time of every slot (64-bit: traces run past 2^32 accesses)
+};
+
+/*
+ * Tree pseudo-LRU: a binary tree over the slots of each set, stored heap
+ * style in n_blocks - 1 bits (node 1 is the root, node i has children 2i
+ * and 2i + 1, slot w is leaf n_blocks + w). Each bit points to the half
+ * that was used less recently; an access flips the bits on its path away.
+ */
+class TreePlruPolicy : public ReplacementPolicy {
+public:
+    /*
+     * Constructs a TreePlruPolicy object.
+     *
+     * Parameters:
+     *  n_sets - number of sets in cache
+     *  n_blocks - number of blocks per set in cache
+     *
+     * Returns:
+     *  a new TreePlruPolicy object
+     */
+    TreePlruPolicy(uint32_t n_sets, uint32_t n_blocks);
+
+    void on_hit(uint32_t index, uint32_t block_index) {
+        touch(index, block_index);
+    }
+
+    void on_fill(uint32_t index, uint32_t block_index, bool, uint64_t) {
+        touch(index, block_index);
+    }
+
+    uint32_t victim(uint32_t index) {
+        const uint64_t * bits = &nodes[(size_t) index * words_per_set];
+        uint32_t node = 1;
+        while (node < n_blocks) { // follow the bits down to a leaf
+            node = 2 * node + ((bits[node >> 6] >> (node & 63)) & 1);
+        }
+        return node - n_blocks;
+    }
+
+    void on_invalidate(uint32_t, uint32_t) {}
+
+private:
+    uint32_t n_blocks;
+    uint32_t words_per_set;
+    std::vector<uint64_t> nodes; // per set, bit i is node i (bit 0 unused)
+
+    /*
+     * Points every node on a slot's path to the other half.
+     */
+    void touch(uint32_t index, uint32_t block_index) {
+        uint64_t * bits = &nodes[(size_t) index * words_per_set];
+        for (uint32_t node = n_blocks + block_index; node > 1; node >>= 1) {
+            uint32_t parent = node >> 1;
+            uint64_t bit = (uint64_t) 1 << (parent & 63);
+            if (node & 1) { // came from the right: victim is on the left
+                bits[parent >> 6] &= ~bit;
+            } else {
+                bits[parent >> 6] |= bit;
+            }
+        }
+    }
+};
+
+/*
+ * Bit pseudo-LRU (also known as MRU bits): one bit per slot, set when the
+ * slot is used. When the last clear bit would be set, every other bit is
+ * cleared. The victim is the first slot with a clear bit.
+ */
+class BitPlruPolicy : public ReplacementPolicy {
+public:
+    /*
+     * Constructs a BitPlruPolicy object.
+     *
+     * Parameters:
+     *  n_sets - number of sets in cache
+     *  n_blocks - number of blocks per set in cache
+     *
+     * Returns:
+     *  a new BitPlruPolicy object
+     */
+    BitPlruPolicy(uint32_t n_sets, uint32_t n_blocks);
+
+    void on_hit(uint32_t index, uint32_t block_index) {
+        touch(index, block_index);
+    }
+
+    void on_fill(uint32_t index, uint32_t block_index, bool, uint64_t) {
+        touch(index, block_index);
+    }
+
+    uint32_t victim(uint32_t index);
+
+    void on_invalidate(uint32_t index, uint32_t block_index) {
+        size_t slot = (size_t) index * n_blocks + block_index;
+        uint64_t bit = (uint64_t) 1 << (slot & 63);
+        if (used[slot >> 6] & bit) {
+            used[slot >> 6] &= ~bit;
+            n_used[index]--;
+        }
+    }
+
+private:
+    uint32_t n_blocks;
+    std::vector<uint64_t> used; // used bit of every slot, n_blocks consecutive bits per set
+    std::vector<uint32_t> n_used; // per set, number of used bits set
+
+    /*
+     * Marks a slot as used.
+     */
+    void touch(uint32_t index, uint32_t block_index);
+};
+
+/*
+ * Re-reference interval prediction (Jaleel et al., ISCA 2010) with 2-bit
+ * re-reference prediction values (RRPV) per slot: hits predict a near
+ * re-reference (0), the victim is the first slot predicted distant (3),
+ * ageing the whole set until one is. The variants differ in the prediction
+ * given to new blocks:
+ *  SRRIP - always long (2)
+ *  BRRIP - distant (3), long only for 1 fill in 32
+ *  DRRIP - set dueling: up to 32 leader sets each of SRRIP and BRRIP steer
+ *          a 10-bit saturating counter with their misses, and all other sets
+ *          follow whichever leader misses less
+ * Random choices use a fixed-seed generator, so results are reproducible.
+ */
+class RripPolicy : public ReplacementPolicy {
+public:
+    /*
+     * Constructs a RripPolicy object.
+     *
+     * Parameters:
+     *  n_sets - number of sets in cache
+     *  n_blocks - number of blocks per set in cache
+     *  eviction - EVICT_SRRIP, EVICT_BRRIP or EVICT_DRRIP
+     *
+     * Returns:
+     *  a new RripPolicy object
+     */
+    RripPolicy(uint32_t n_sets, uint32_t n_blocks, int eviction);
+
+    void on_hit(uint32_t index, uint32_t block_index) {
+        rrpv[(size_t) index * n_blocks + block_index] = 0;
+    }
+
+    void on_fill(uint32_t index, uint32_t block_index, bool, uint64_t) {
+        rrpv[(size_t) index * n_blocks + block_index] = insertion_rrpv(index);
+    }
+
+    uint32_t victim(uint32_t index);
+
+    void on_invalidate(uint32_t, uint32_t) {}
+
+private:
+    uint32_t n_blocks;
+    int eviction;
+    uint32_t leader_stride; // DRRIP: sets per leader pair (0 if no leaders)
+    uint32_t psel = 511; // DRRIP selector: above half, followers use BRRIP
+    uint32_t rng = 0x9e3779b9;
+    std::vector<uint8_t> rrpv; // prediction of every slot, 0 (near) to 3 (distant)
+
+    /*
+     * Returns the prediction for a block filled into a set after a miss,
+     * updating the DRRIP selector when the set is a leader.
+     */
+    uint8_t insertion_rrpv(uint32_t index);
+};
+
+/*
+ * Random replacement: the victim is drawn from a fixed-seed xorshift
+ * generator, so results are reproducible. Keeps no per-block metadata.
+ */
+class RandomPolicy : public ReplacementPolicy {
+public:
+    /*
+     * Constructs a RandomPolicy object.
+     *
+     * Parameters:
+     *  n_blocks - number of blocks per set in cache
+     *
+     * Returns:
+     *  a new RandomPolicy object
+     */
+    explicit RandomPolicy(uint32_t n_blocks);
+
+    void on_hit(uint32_t, uint32_t) {}
+    void on_fill(uint32_t, uint32_t, bool, uint64_t) {}
+
+    uint32_t victim(uint32_t) {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        return rng & (n_blocks - 1); // n_blocks is a power of 2
+    }
+
+    void on_invalidate(uint32_t, uint32_t) {}
+
+private:
+    uint32_t n_blocks;
+    uint32_t rng = 0x9e3779b9;
+};
+
+/*
+ * Least-frequently-used: an 8-bit use counter per slot, starting at 1 on
+ * fill. When a counter would overflow, every counter of its set is halved,
+ * so old popularity fades. The victim is the first slot with the lowest count.
+ */
+class LfuPolicy : public ReplacementPolicy {
+public:
+    /*
+     * Constructs a LfuPolicy object.
+     *
+     * Parameters:
+     *  n_sets - number of sets in cache
+     *  n_blocks - number of blocks per set in cache
+     *
+     * Returns:
+     *  a new LfuPolicy object
+     */
+    LfuPolicy(uint32_t n_sets, uint32_t n_blocks);
+
+    void on_hit(uint32_t index, uint32_t block_index) {
+        uint8_t & count = counts[(size_t) index * n_blocks + block_index];
+        if (count == UINT8_MAX) {
+            age(index);
+        }
+        count++;
+    }
+
+    void on_fill(uint32_t index, uint32_t block_index, bool, uint64_t) {
+        counts[(size_t) index * n_blocks + block_index] = 1;
+    }
+
+    uint32_t victim(uint32_t index);
+
+    void on_invalidate(uint32_t, uint32_t) {}
+
+private:
+    uint32_t n_blocks;
+    std::vector<uint8_t> counts; // use count of every slot
+
+    /*
+     * Halves every counter of a set.
+     */
+    void age(uint32_t index);
+};
+
+/*
+ * Clock (second chance): a referenced bit per slot, set on use, and a hand
+ * per set. The hand sweeps the set clearing referenced bits and stops at
+ * the first unreferenced slot, which is the victim; it then moves past it.
+ */
+class ClockPolicy : public ReplacementPolicy {
+public:
+    /*
+     * Constructs a ClockPolicy object.
+     *
+     * Parameters:
+     *  n_sets - number of sets in cache
+     *  n_blocks - number of blocks per set in cache
+     *
+     * Returns:
+     *  a new ClockPolicy object
+     */
+    ClockPolicy(uint32_t n_sets, uint32_t n_blocks);
+
+    void on_hit(uint32_t index, uint32_t block_index) {
+        size_t slot = (size_t) index * n_blocks + block_index;
+        referenced[slot >> 6] |= (uint64_t) 1 << (slot & 63);
+    }
+
+    void on_fill(uint32_t index, uint32_t block_index, bool was_valid, uint64_t) {
+        on_hit(index, block_index);
+        if (was_valid) { // replaced the victim under the hand
+            hands[index] = (block_index + 1) & (n_blocks - 1);
+        }
+    }
+
+    uint32_t victim(uint32_t index);
+
+    void on_invalidate(uint32_t index, uint32_t block_index) {
+        size_t slot = (size_t) index * n_blocks + block_index;
+        referenced[slot >> 6] &= ~((uint64_t) 1 << (slot & 63));
+    }
+
+private:
+    uint32_t n_blocks;
+    std::vector<uint64_t> referenced; // referenced bit of every slot
+    std::vector<uint32_t> hands; // per set, slot under the hand
+};
+
+#endif
@@ -0,0 +1,151 @@
+/*
+ * Cache simulator thread pool
+ * CSF Assignment 3
+ */
+
+#include "csim_pool.h"
+
+using namespace std;
+
+/*
+ * Constructs a WorkStealingPool object. The thread calling run() takes
+ * part in the work, so n_threads - 1 threads are started.
+ *
+ * Parameters:
+ *  n_threads - total number of threads working on each batch
+ *
+ * Returns:
+ *  a new WorkStealingPool object
+ */
+WorkStealingPool::WorkStealingPool(int n_threads) {
+    if (n_threads < 1) {
+        n_threads = 1;
+    }
+    for (int i = 0; i < n_threads; i++) {
+        workers.push_back(unique_ptr<Worker>(new Worker()));
+    }
+    for (int i = 1; i < n_threads; i++) {
+        threads.push_back(thread(&WorkStealingPool::work, this, i));
+    }
+}
+
+/*
+ * Stops and joins the threads.
+ */
+WorkStealingPool::~WorkStealingPool() {
+    {
+        lock_guard<mutex> guard(lock);
+        is_stopping = true;
+    }
+    batch_started.notify_all();
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+}
+
+/*
+ * Runs a batch of tasks and returns once all of them have finished.
+ *
+ * Parameters:
+ *  tasks - task numbers, in the order they should preferably start
+ *          (e.g. most expensive first)
+ *  run_task - called once for each task number, from any thread
+ */
+void WorkStealingPool::run(const vector<size_t> & tasks, const function<void (size_t)> & run_task) {
+    if (tasks.empty()) {
+        return;
+    }
+
+    // a thread still draining the previous batch may pick up these tasks
+    // as soon as they are dealt, so publish the batch first
+    {
+        lock_guard<mutex> guard(lock);
+        this->run_task = &run_task;
+        n_remaining = tasks.size();
+    }
+
+    // deal tasks round-robin so every deque starts with a share of the expensive ones
+    size_t n_workers = workers.size();
+    for (size_t i = 0; i < tasks.size(); i++) {
+        Worker & worker = *workers[i % n_workers];
+        lock_guard<mutex> guard(worker.lock);
+        worker.tasks.push_back(tasks[i]);
+    }
+
+    {
+        lock_guard<mutex> guard(lock);
+        batch++;
+    }
+    batch_started.notify_all();
+
+    drain(0);
+
+    unique_lock<mutex> guard(lock);
+    batch_finished.wait(guard, [this] { return n_remaining == 0; });
+    this->run_task = nullptr;
+}
+
+/*
+ * Thread body: waits for batches and works on them.
+ */
+void WorkStealingPool::work(int id) {
+    uint64_t seen = 0;
+    while (true) {
+        {
+            unique_lock<mutex> guard(lock);
+            batch_started.wait(guard, [this, seen] { return is_stopping || batch != seen; });
+            if (is_stopping) {
+                return;
+            }
+            seen = batch;
+        }
+        drain(id);
+    }
+}
+
+/*
+ * Works on the current batch until no task is left to take.
+ */
+void WorkStealingPool::drain(int id) {
+    size_t task;
+    while (next_task(id, task)) {
+        (*run_task)(task);
+
+        lock_guard<mutex> guard(lock);
+        if (--n_remaining == 0) {
+            batch_finished.notify_all();
+        }
+    }
+}
+
+/*
+ * Takes the next task, from the worker's own deque or stolen from another.
+ *
+ * Returns:
+ *  true if a task was taken
+ *  false if every deque is empty
+ */
+bool WorkStealingPool::next_task(int id, size_t & task) {
+    {
+        Worker & self = *workers[id];
+        lock_guard<mutex> guard(self.lock);
+        if (!self.tasks.empty()) {
+            task = self.tasks.front();
+            self.tasks.pop_front();
+            return true;
+        }
+    }
+
+    // steal the cheapest remaining task of another worker, leaving it its expensive ones
+    size_t n_workers = workers.size();
+    for (size_t i = 1; i < n_workers; i++) {
+        Worker & victim = *workers[(id + i) % n_workers];
+        lock_guard<mutex> guard(victim.lock);
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.back();
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
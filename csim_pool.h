@@ -0,0 +1,94 @@
+/*
+ * Cache simulator thread pool
+ * CSF Assignment 3
+ */
+
+#ifndef __CSIM_POOL_H__
+#define __CSIM_POOL_H__
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <stdint.h>
+
+/*
+ * Fixed set of threads that run batches of independent tasks. Each batch
+ * is dealt out to per-thread deques; a thread works through its own deque
+ * front to back and, once it runs dry, steals from the back of the others,
+ * so a few slow tasks do not leave the remaining threads idle.
+ */
+class WorkStealingPool {
+public:
+    /*
+     * Constructs a WorkStealingPool object. The thread calling run() takes
+     * part in the work, so n_threads - 1 threads are started.
+     *
+     * Parameters:
+     *  n_threads - total number of threads working on each batch
+     *
+     * Returns:
+     *  a new WorkStealingPool object
+     */
+    explicit WorkStealingPool(int n_threads);
+
+    /*
+     * Stops and joins the threads.
+     */
+    ~WorkStealingPool();
+
+    /*
+     * Runs a batch of tasks and returns once all of them have finished.
+     *
+     * Parameters:
+     *  tasks - task numbers, in the order they should preferably start
+     *          (e.g. most expensive first)
+     *  run_task - called once for each task number, from any thread
+     */
+    void run(const std::vector<size_t> & tasks, const std::function<void (size_t)> & run_task);
+
+    /*
+     * Returns the total number of threads working on each batch.
+     */
+    int get_n_threads() const { return (int) workers.size(); }
+
+private:
+    struct Worker {
+        std::mutex lock;
+        std::deque<size_t> tasks;
+    };
+
+    std::vector< std::unique_ptr<Worker> > workers;
+    std::vector<std::thread> threads;
+
+    std::mutex lock;
+    std::condition_variable batch_started;
+    std::condition_variable batch_finished;
+    const std::function<void (size_t)> * run_task = nullptr;
+    uint64_t batch = 0;       // number of the current batch
+    size_t n_remaining = 0;   // tasks of the current batch not yet finished
+    bool is_stopping = false;
+
+    /*
+     * Thread body: waits for batches and works on them.
+     */
+    void work(int id);
+
+    /*
+     * Works on the current batch until no task is left to take.
+     */
+    void drain(int id);
+
+    /*
+     * Takes the next task, from the worker's own deque or stolen from another.
+     *
+     * Returns:
+     *  true if a task was taken
+     *  false if every deque is empty
+     */
+    bool next_task(int id, size_t & task);
+};
+
+#endif
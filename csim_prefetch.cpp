@@ -0,0 +1,293 @@
+/*
+ * Cache simulator prefetchers
+ * CSF Assignment 3
+ */
+
+#include <string.h>
+#include "csim_prefetch.h"
+
+/*
+ * Records that a prefetch evicted a block, forgetting blocks evicted
+ * more than window fills ago once the record grows large.
+ *
+ * Parameters:
+ *  block - address of the evicted block
+ */
+void Prefetcher::record_displaced(uint64_t block) {
+    displaced[block] = n_fills;
+    if (displaced.size() <= 2 * window) {
+        return;
+    }
+    for (std::unordered_map<uint64_t, uint64_t>::iterator it = displaced.begin(); it != displaced.end(); ) {
+        if (n_fills - it->second > window) {
+            it = displaced.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+/*
+ * Returns true if a block was evicted by a prefetch within the last
+ * window fills, forgetting it.
+ *
+ * Parameters:
+ *  block - address of the block
+ */
+bool Prefetcher::was_displaced(uint64_t block) {
+    std::unordered_map<uint64_t, uint64_t>::iterator it = displaced.find(block);
+    if (it == displaced.end()) {
+        return false;
+    }
+    bool is_recent = n_fills - it->second <= window;
+    displaced.erase(it);
+    return is_recent;
+}
+
+/*
+ * Constructs a NextLinePrefetcher object.
+ *
+ * Parameters:
+ *  block_size - size of each block in bytes
+ *  degree - blocks prefetched per trigger
+ *
+ * Returns:
+ *  a new NextLinePrefetcher object
+ */
+NextLinePrefetcher::NextLinePrefetcher(uint32_t block_size, uint32_t degree) {
+    this->block_size = block_size;
+    this->degree = degree;
+}
+
+/*
+ * Prefetches the blocks after a miss or a first use.
+ */
+void NextLinePrefetcher::observe(uint64_t block, int outcome) {
+    candidates.clear();
+    if (outcome == OUTCOME_HIT) {
+        return;
+    }
+    uint64_t next = block;
+    for (uint32_t i = 0; i < degree; i++) {
+        next += block_size;
+        if (next < block) { // wrapped past the end of memory
+            break;
+        }
+        candidates.push_back(next);
+    }
+}
+
+/*
+ * Constructs a StridePrefetcher object.
+ *
+ * Parameters:
+ *  block_size - size of each block in bytes
+ *  degree - blocks prefetched per access
+ *
+ * Returns:
+ *  a new StridePrefetcher object
+ */
+StridePrefetcher::StridePrefetcher(uint32_t block_size, uint32_t degree) {
+    this->block_size = block_size;
+    this->degree = degree;
+    table.assign(STRIDE_TABLE_SIZE, Entry());
+}
+
+/*
+ * Trains the entry of the accessed region and prefetches along its
+ * stride once it is confident.
+ */
+void StridePrefetcher::observe(uint64_t block, int) {
+    candidates.clear();
+    uint64_t region = block >> STRIDE_REGION_BITS;
+    Entry & entry = table[region & (STRIDE_TABLE_SIZE - 1)];
+    if (!entry.is_valid || entry.region != region) { // start following the region
+        entry.is_valid = true;
+        entry.region = region;
+        entry.last_block = block;
+        entry.stride = 0;
+        entry.confidence = 0;
+        return;
+    }
+
+    int64_t stride = (int64_t) (block - entry.last_block); // blocks of a region are close together
+    if (stride == 0) { // same block again: nothing learned
+        return;
+    }
+    entry.last_block = block;
+    if (stride == entry.stride) {
+        if (entry.confidence < STRIDE_MAX_CONFIDENCE) {
+            entry.confidence++;
+        }
+    } else if (entry.confidence > 0) {
+        entry.confidence--;
+    } else { // replace a stride that stopped repeating
+        entry.stride = stride;
+    }
+    if (entry.confidence < STRIDE_MIN_CONFIDENCE) {
+        return;
+    }
+
+    uint64_t next = block;
+    for (uint32_t i = 0; i < degree; i++) {
+        uint64_t prev = next;
+        next += (uint64_t) entry.stride;
+        if (entry.stride > 0 ? next < prev : next > prev) { // wrapped outside of memory
+            break;
+        }
+        candidates.push_back(next);
+    }
+}
+
+/*
+ * Constructs a StreamPrefetcher object.
+ *
+ * Parameters:
+ *  block_size - size of each block in bytes
+ *  depth - blocks each buffer holds
+ *
+ * Returns:
+ *  a new StreamPrefetcher object
+ */
+StreamPrefetcher::StreamPrefetcher(uint32_t block_size, uint32_t depth) {
+    this->block_size = block_size;
+    this->depth = depth;
+    buffers.assign(STREAM_BUFFERS, Buffer());
+}
+
+/*
+ * Appends the next block of a buffer's stream to candidates.
+ */
+void StreamPrefetcher::advance(Buffer & buffer) {
+    if (!buffer.is_active) {
+        return;
+    }
+    candidates.push_back(buffer.next_block);
+    if (buffer.next_block + block_size < buffer.next_block) { // the stream reached the end of memory
+        buffer.is_active = false;
+    } else {
+        buffer.next_block += block_size;
+    }
+}
+
+/*
+ * On a miss, tops up the buffer that served it, or restarts the least
+ * recently used buffer after the missed block.
+ */
+void StreamPrefetcher::observe(uint64_t block, int outcome) {
+    candidates.clear();
+    if (outcome != OUTCOME_MISS) {
+        return;
+    }
+
+    if (served >= 0) { // keep the stream depth blocks ahead
+        filling = served;
+        served = -1;
+        advance(buffers[filling]);
+        return;
+    }
+
+    filling = 0;
+    for (int i = 1; i < (int) buffers.size(); i++) {
+        if (buffers[i].last_use < buffers[filling].last_use) {
+            filling = i;
+        }
+    }
+    Buffer & buffer = buffers[filling];
+    buffer.entries.clear(); // prefetches of the old stream are dropped
+    buffer.last_use = ++n_uses;
+    buffer.is_active = block + block_size > block;
+    buffer.next_block = block + block_size;
+    for (uint32_t i = 0; i < depth; i++) {
+        advance(buffer);
+    }
+}
+
+/*
+ * Keeps a block fetched for the buffer chosen by the last observe().
+ */
+void StreamPrefetcher::place(uint64_t block, uint64_t ready_at) {
+    Entry entry = {block, ready_at};
+    buffers[filling].entries.push_back(entry);
+}
+
+/*
+ * Hands over the block at the head of a buffer, if one holds the missed block.
+ */
+bool StreamPrefetcher::take(uint64_t block, uint64_t & ready_at) {
+    for (size_t i = 0; i < buffers.size(); i++) {
+        Buffer & buffer = buffers[i];
+        if (!buffer.entries.empty() && buffer.entries.front().block == block) {
+            ready_at = buffer.entries.front().ready_at;
+            buffer.entries.pop_front();
+            buffer.last_use = ++n_uses;
+            served = (int) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// configuration names, indexed by PrefetchPolicy
+static const char * const prefetch_names[] = {"next-line", "stride", "stream"};
+#define N_PREFETCH_POLICIES (sizeof(prefetch_names) / sizeof(prefetch_names[0]))
+
+/*
+ * Looks up a prefetcher by its configuration name: next-line, stride or stream.
+ *
+ * Parameters:
+ *  name - name of the prefetcher
+ *  prefetch - receives the PrefetchPolicy
+ *
+ * Returns:
+ *  true if the name is known
+ *  false otherwise
+ */
+bool parse_prefetch_policy(const char * name, int & prefetch) {
+    for (size_t i = 0; i < N_PREFETCH_POLICIES; i++) {
+        if (strcmp(name, prefetch_names[i]) == 0) {
+            prefetch = (int) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Returns the configuration name of a prefetcher ("-" for PREFETCH_NONE).
+ */
+const char * prefetch_policy_name(int prefetch) {
+    if (prefetch < 0 || (size_t) prefetch >= N_PREFETCH_POLICIES) {
+        return "-";
+    }
+    return prefetch_names[prefetch];
+}
+
+/*
+ * Creates a prefetcher.
+ *
+ * Parameters:
+ *  prefetch - PrefetchPolicy (not PREFETCH_NONE)
+ *  block_size - size of each block in bytes
+ *  degree - blocks prefetched per trigger, or stream buffer depth (0 for the default)
+ *  window - fills after which an evicted block would have left the level anyway
+ *
+ * Returns:
+ *  the new prefetcher, owned by the caller
+ */
+Prefetcher * new_prefetcher(int prefetch, uint32_t block_size, uint32_t degree, uint64_t window) {
+    Prefetcher * prefetcher;
+    switch (prefetch) {
+    case PREFETCH_STRIDE:
+        prefetcher = new StridePrefetcher(block_size, degree > 0 ? degree : PREFETCH_DEFAULT_DEGREE);
+        break;
+    case PREFETCH_STREAM:
+        prefetcher = new StreamPrefetcher(block_size, degree > 0 ? degree : STREAM_DEFAULT_DEPTH);
+        break;
+    default:
+        prefetcher = new NextLinePrefetcher(block_size, degree > 0 ? degree : PREFETCH_DEFAULT_DEGREE);
+        break;
+    }
+    prefetcher->window = window;
+    return prefetcher;
+}
@@ -0,0 +1,260 @@
+/*
+ * Cache simulator prefetchers
+ * CSF Assignment 3
+ */
+
+#ifndef __CSIM_PREFETCH_H__
+#define __CSIM_PREFETCH_H__
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <stdint.h>
+
+// prefetchers a cache level can have
+enum PrefetchPolicy {
+    PREFETCH_NONE = -1,     // demand fetches only
+    PREFETCH_NEXT_LINE = 0, // the blocks after a miss or a first use of a prefetched block
+    PREFETCH_STRIDE,        // constant strides, detected per address region
+    PREFETCH_STREAM         // sequential streams, held in stream buffers beside the cache
+};
+
+// blocks prefetched per trigger when a level gives no prefetch-degree
+#define PREFETCH_DEFAULT_DEGREE 1
+
+// stride prefetcher: regions of 4 KiB, tracked by a direct-mapped table
+#define STRIDE_REGION_BITS 12
+#define STRIDE_TABLE_SIZE 64
+#define STRIDE_MIN_CONFIDENCE 2 // matching strides seen before prefetching
+#define STRIDE_MAX_CONFIDENCE 3
+
+// stream buffers per level, and their depth when a level gives no prefetch-degree
+#define STREAM_BUFFERS 4
+#define STREAM_DEFAULT_DEPTH 4
+
+// outcome of a demand access, as seen by a prefetcher
+#define OUTCOME_HIT 0        // hit on a demand-fetched or already used block
+#define OUTCOME_MISS 1       // miss (possibly served by a stream buffer)
+#define OUTCOME_FIRST_USE 2  // first hit on a block brought in by a prefetch
+
+/*
+ * Looks up a prefetcher by its configuration name: next-line, stride or stream.
+ *
+ * Parameters:
+ *  name - name of the prefetcher
+ *  prefetch - receives the PrefetchPolicy
+ *
+ * Returns:
+ *  true if the name is known
+ *  false otherwise
+ */
+bool parse_prefetch_policy(const char * name, int & prefetch);
+
+/*
+ * Returns the configuration name of a prefetcher ("-" for PREFETCH_NONE).
+ */
+const char * prefetch_policy_name(int prefetch);
+
+/*
+ * Prefetcher of one cache level. The level reports every demand access to
+ * observe(), which returns the blocks to prefetch; the level fetches them
+ * from the next level. Prefetchers that fill the cache leave the blocks to
+ * the level; buffered ones (stream buffers) keep them and hand them over
+ * on a miss through take().
+ *
+ * The base class also keeps the level's bookkeeping of prefetched blocks,
+ * used to tell useful, late and polluting prefetches apart.
+ */
+class Prefetcher {
+public:
+    std::unordered_map<uint64_t, uint64_t> pending; // blocks prefetched into the cache, not yet used, and the cycle they arrive
+    std::unordered_map<uint64_t, uint64_t> displaced; // blocks evicted by prefetches, and the fill that evicted them
+    uint64_t n_fills = 0; // blocks placed in the level so far
+    uint64_t window = 0; // fills after which an evicted block would have left the level anyway
+    std::vector<uint64_t> candidates; // blocks returned by the last observe()
+
+    virtual ~Prefetcher() {}
+
+    /*
+     * Observes a demand access and appends the blocks to prefetch to
+     * candidates (cleared first).
+     *
+     * Parameters:
+     *  block - address of the accessed block
+     *  outcome - OUTCOME_HIT, OUTCOME_MISS or OUTCOME_FIRST_USE
+     */
+    virtual void observe(uint64_t block, int outcome) = 0;
+
+    /*
+     * Returns true if prefetched blocks are held by the prefetcher rather
+     * than placed in the cache.
+     */
+    virtual bool is_buffered() const { return false; }
+
+    /*
+     * Keeps a block fetched for the last observe() (buffered prefetchers).
+     *
+     * Parameters:
+     *  block - address of the block
+     *  ready_at - cycle at which the block arrives
+     */
+    virtual void place(uint64_t, uint64_t) {}
+
+    /*
+     * Hands a held block over to the cache on a miss (buffered prefetchers).
+     *
+     * Parameters:
+     *  block - address of the missed block
+     *  ready_at - receives the cycle at which the block arrives
+     *
+     * Returns:
+     *  true if the block was held
+     */
+    virtual bool take(uint64_t, uint64_t &) { return false; }
+
+    /*
+     * Records that a prefetch evicted a block, forgetting blocks evicted
+     * more than window fills ago once the record grows large.
+     *
+     * Parameters:
+     *  block - address of the evicted block
+     */
+    void record_displaced(uint64_t block);
+
+    /*
+     * Returns true if a block was evicted by a prefetch within the last
+     * window fills, forgetting it.
+     *
+     * Parameters:
+     *  block - address of the block
+     */
+    bool was_displaced(uint64_t block);
+};
+
+/*
+ * Next-line prefetching: a miss, or the first use of a prefetched block
+ * (tagged prefetching), prefetches the following degree blocks.
+ */
+class NextLinePrefetcher : public Prefetcher {
+public:
+    /*
+     * Constructs a NextLinePrefetcher object.
+     *
+     * Parameters:
+     *  block_size - size of each block in bytes
+     *  degree - blocks prefetched per trigger
+     *
+     * Returns:
+     *  a new NextLinePrefetcher object
+     */
+    NextLinePrefetcher(uint32_t block_size, uint32_t degree);
+
+    void observe(uint64_t block, int outcome);
+
+private:
+    uint32_t block_size;
+    uint32_t degree;
+};
+
+/*
+ * Stride prefetching. Traces carry no program counters, so strides are
+ * detected per region of memory instead of per instruction: each table
+ * entry follows the accesses to one region, and once the same stride
+ * has repeated STRIDE_MIN_CONFIDENCE times, every access prefetches the
+ * next degree blocks along it.
+ */
+class StridePrefetcher : public Prefetcher {
+public:
+    /*
+     * Constructs a StridePrefetcher object.
+     *
+     * Parameters:
+     *  block_size - size of each block in bytes
+     *  degree - blocks prefetched per access
+     *
+     * Returns:
+     *  a new StridePrefetcher object
+     */
+    StridePrefetcher(uint32_t block_size, uint32_t degree);
+
+    void observe(uint64_t block, int outcome);
+
+private:
+    struct Entry {
+        bool is_valid = false;
+        uint64_t region = 0;     // address >> STRIDE_REGION_BITS
+        uint64_t last_block = 0; // last block accessed in the region
+        int64_t stride = 0;      // last stride seen, in bytes
+        uint8_t confidence = 0;  // saturating count of repeated strides
+    };
+
+    uint32_t block_size;
+    uint32_t degree;
+    std::vector<Entry> table;
+};
+
+/*
+ * Stream buffers (Jouppi): a miss that no buffer can serve restarts the
+ * least recently used buffer on the blocks that follow it. A miss on the
+ * block at the head of a buffer moves it into the cache and prefetches one
+ * more block at the tail. Prefetched blocks never enter the cache before
+ * they are used, so they cannot pollute it.
+ */
+class StreamPrefetcher : public Prefetcher {
+public:
+    /*
+     * Constructs a StreamPrefetcher object.
+     *
+     * Parameters:
+     *  block_size - size of each block in bytes
+     *  depth - blocks each buffer holds
+     *
+     * Returns:
+     *  a new StreamPrefetcher object
+     */
+    StreamPrefetcher(uint32_t block_size, uint32_t depth);
+
+    void observe(uint64_t block, int outcome);
+    bool is_buffered() const { return true; }
+    void place(uint64_t block, uint64_t ready_at);
+    bool take(uint64_t block, uint64_t & ready_at);
+
+private:
+    struct Entry {
+        uint64_t block;
+        uint64_t ready_at;
+    };
+    struct Buffer {
+        std::deque<Entry> entries; // oldest (head) first
+        uint64_t next_block = 0;   // block to prefetch next
+        bool is_active = false;    // does the stream still run (not past the end of memory)?
+        uint64_t last_use = 0;     // for choosing the buffer to restart
+    };
+
+    uint32_t block_size;
+    uint32_t depth;
+    std::vector<Buffer> buffers;
+    int served = -1; // buffer that served the current miss, if any
+    int filling = 0; // buffer receiving place()
+    uint64_t n_uses = 0;
+
+    /*
+     * Appends the next block of a buffer's stream to candidates.
+     */
+    void advance(Buffer & buffer);
+};
+
+/*
+ * Creates a prefetcher.
+ *
+ * Parameters:
+ *  prefetch - PrefetchPolicy (not PREFETCH_NONE)
+ *  block_size - size of each block in bytes
+ *  degree - blocks prefetched per trigger, or stream buffer depth (0 for the default)
+ *  window - fills after which an evicted block would have left the level anyway
+ *
+ * Returns:
+ *  the new prefetcher, owned by the caller
+ */
+Prefetcher * new_prefetcher(int prefetch, uint32_t block_size, uint32_t degree, uint64_t window);
+
+#endif
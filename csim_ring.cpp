@@ -0,0 +1,401 @@
+/*
+ * Cache simulator live trace ring
+ * CSF Assignment 3
+ */
+
+#include <iostream>
+#include <algorithm>
+#include <new>
+#include <chrono>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "csim_ring.h"
+#include "csim_functions.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using namespace std;
+
+// set by request_stop(), possibly from a signal handler
+static volatile sig_atomic_t stop_requested = 0;
+
+/*
+ * Returns a shared memory object name with the leading '/' POSIX asks for.
+ */
+static string ring_name(const string & name) {
+    return name.size() > 0 && name[0] == '/' ? name : "/" + name;
+}
+
+/*
+ * Checks whether the process on the other side of a ring is still running.
+ *
+ * Parameters:
+ *  pid - its process id (0 if it has not attached yet)
+ *
+ * Returns:
+ *  false if it has exited
+ */
+static bool is_alive(pid_t pid) {
+    return pid == 0 || kill(pid, 0) == 0 || errno != ESRCH;
+}
+
+/*
+ * Waits for the other side of a ring: yields the CPU for the first
+ * RING_SPIN_LIMIT calls, then sleeps RING_IDLE_SLEEP_US per call.
+ *
+ * Parameters:
+ *  idle - calls so far while waiting (incremented)
+ *
+ * Returns:
+ *  true once sleeping, when it is worth checking that the other side is alive
+ */
+static bool wait_idle(uint32_t & idle) {
+    if (idle < RING_SPIN_LIMIT) {
+        idle++;
+        sched_yield();
+        return false;
+    }
+    usleep(RING_IDLE_SLEEP_US);
+    return true;
+}
+
+/*
+ * Creates a ring, replacing any left over under the same name.
+ *
+ * Parameters:
+ *  name - shared memory object name (a leading '/' is added if missing)
+ *  capacity - records in the ring (a power of 2)
+ *
+ * Returns:
+ *  a new TraceRing object (check is_open())
+ */
+TraceRing::TraceRing(const string & name, uint32_t capacity) : name(ring_name(name)) {
+    shm_unlink(this->name.c_str()); // a ring left behind by a simulator that was killed
+    int fd = shm_open(this->name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        return;
+    }
+    is_owner = true;
+    size_t bytes = sizeof(RingHeader) + (size_t) capacity * sizeof(Access);
+    bool ok = ftruncate(fd, bytes) == 0 && map(fd, bytes);
+    ::close(fd);
+    if (!ok) {
+        return;
+    }
+
+    RingHeader * ring = new (header) RingHeader();
+    memcpy(ring->magic, RING_MAGIC, sizeof(ring->magic));
+    ring->version = RING_VERSION;
+    ring->capacity = capacity;
+    ring->consumer_pid.store(getpid(), memory_order_relaxed);
+    ring->ready.store(1, memory_order_release);
+}
+
+/*
+ * Attaches to a ring created by another process, waiting up to
+ * RING_ATTACH_TIMEOUT_MS for it to appear.
+ *
+ * Parameters:
+ *  name - shared memory object name (a leading '/' is added if missing)
+ *
+ * Returns:
+ *  a new TraceRing object (check is_open())
+ */
+TraceRing::TraceRing(const string & name) : name(ring_name(name)) {
+    for (int waited = 0; waited <= RING_ATTACH_TIMEOUT_MS; waited += 10) {
+        int fd = shm_open(this->name.c_str(), O_RDWR, 0);
+        if (fd >= 0) {
+            // the creator sizes the object before initializing the header
+            struct stat st;
+            bool ok = fstat(fd, &st) == 0 && (size_t) st.st_size > sizeof(RingHeader) && map(fd, st.st_size);
+            ::close(fd);
+            if (ok) {
+                break;
+            }
+        }
+        usleep(10000);
+    }
+    if (header == nullptr) {
+        return;
+    }
+    for (int waited = 0; !header->ready.load(memory_order_acquire); waited += 10) {
+        if (waited > RING_ATTACH_TIMEOUT_MS) {
+            munmap(header, length);
+            header = nullptr;
+            return;
+        }
+        usleep(10000);
+    }
+    uint32_t capacity = header->capacity;
+    if (memcmp(header->magic, RING_MAGIC, sizeof(header->magic)) != 0 || header->version != RING_VERSION
+        || capacity == 0 || (capacity & (capacity - 1)) != 0
+        || length < sizeof(RingHeader) + (size_t) capacity * sizeof(Access)) {
+        munmap(header, length);
+        header = nullptr;
+        return;
+    }
+    header->producer_pid.store(getpid(), memory_order_release);
+}
+
+/*
+ * Unmaps the ring, and removes its name if this object created it.
+ */
+TraceRing::~TraceRing() {
+    if (header != nullptr) {
+        munmap(header, length);
+    }
+    if (is_owner) {
+        shm_unlink(name.c_str());
+    }
+}
+
+/*
+ * Maps the ring's shared memory.
+ *
+ * Parameters:
+ *  fd - open shared memory object
+ *  bytes - size of the mapping
+ *
+ * Returns:
+ *  true if successful
+ */
+bool TraceRing::map(int fd, size_t bytes) {
+    void * addr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        return false;
+    }
+    header = (RingHeader *) addr;
+    records = (Access *) (header + 1);
+    length = bytes;
+    return true;
+}
+
+/*
+ * Writes accesses into the ring (producer side).
+ *
+ * Parameters:
+ *  accesses - first access to write
+ *  n - number of accesses
+ *  is_lossy - if the ring is full, drop the rest of the accesses
+ *             (counted in drops) instead of waiting for room
+ *
+ * Returns:
+ *  number of accesses written (fewer than n without is_lossy only
+ *  if the simulator exited)
+ */
+size_t TraceRing::produce(const Access * accesses, size_t n, bool is_lossy) {
+    uint64_t capacity = header->capacity;
+    uint64_t head = header->head.load(memory_order_relaxed);
+    size_t written = 0;
+    while (written < n) {
+        uint64_t room = capacity - (head - header->tail.load(memory_order_acquire));
+        if (room == 0) { // full
+            if (is_lossy) {
+                header->drops.fetch_add(n - written, memory_order_relaxed);
+                break;
+            }
+            header->stalls.fetch_add(1, memory_order_relaxed);
+            uint32_t idle = 0;
+            while (head - header->tail.load(memory_order_acquire) == capacity) {
+                if (wait_idle(idle) && !is_alive(header->consumer_pid.load(memory_order_relaxed))) {
+                    return written;
+                }
+            }
+            continue;
+        }
+
+        // copy up to the end of the ring, then publish the records
+        size_t start = head & (capacity - 1);
+        size_t count = min((uint64_t) (n - written), min(room, capacity - start));
+        memcpy(records + start, accesses + written, count * sizeof(Access));
+        head += count;
+        written += count;
+        header->head.store(head, memory_order_release);
+    }
+    return written;
+}
+
+/*
+ * Tells the consumer that no more accesses will come (producer side).
+ */
+void TraceRing::close() {
+    header->closed.store(1, memory_order_release);
+}
+
+/*
+ * Hands the ring's accesses to a callback in batches, in place,
+ * until the producer closes the ring and it is empty (consumer side).
+ * Gives up early if the producer exits or never attaches, if
+ * request_stop() is called, or on an invalid access.
+ *
+ * Parameters:
+ *  consume - called with each batch of accesses, in order
+ *
+ * Returns:
+ *  RING_CLOSED, RING_PRODUCER_GONE, RING_NO_PRODUCER,
+ *  RING_INTERRUPTED or RING_BAD_RECORD
+ */
+int TraceRing::drain(const function<void (const Access *, size_t)> & consume) {
+    uint64_t capacity = header->capacity;
+    uint64_t tail = header->tail.load(memory_order_relaxed);
+    chrono::steady_clock::time_point started = chrono::steady_clock::now();
+    uint32_t idle = 0;
+    while (true) {
+        if (stop_requested) {
+            return RING_INTERRUPTED;
+        }
+        uint64_t head = header->head.load(memory_order_acquire);
+        if (head == tail) {
+            // records published before the producer closed the ring are visible once it is seen closed
+            if (header->closed.load(memory_order_acquire) && header->head.load(memory_order_acquire) == tail) {
+                return RING_CLOSED;
+            }
+            if (!wait_idle(idle)) {
+                continue;
+            }
+            pid_t producer = header->producer_pid.load(memory_order_acquire);
+            if (producer == 0 && chrono::steady_clock::now() - started > chrono::milliseconds(RING_PRODUCER_TIMEOUT_MS)) {
+                return RING_NO_PRODUCER;
+            }
+            // a producer that exited may still have published records before it went
+            if (!is_alive(producer) && header->head.load(memory_order_acquire) == tail) {
+                return RING_PRODUCER_GONE;
+            }
+            continue;
+        }
+        idle = 0;
+
+        size_t start = tail & (capacity - 1);
+        size_t count = min(min(head - tail, (uint64_t) RING_BATCH_SIZE), capacity - start);
+        // the records come from another process: check them before they index into the cache
+        uint8_t bad = 0;
+        for (size_t i = 0; i < count; i++) { // no early exit, so the loop vectorizes
+            bad |= records[start + i].op > ACCESS_IFETCH;
+        }
+        if (bad) {
+            return RING_BAD_RECORD;
+        }
+        consume(records + start, count);
+        tail += count;
+        header->tail.store(tail, memory_order_release);
+    }
+}
+
+/*
+ * Makes drain() return RING_INTERRUPTED. Safe to call from a signal handler.
+ */
+void TraceRing::request_stop() {
+    stop_requested = 1;
+}
+
+/*
+ * Stops draining on SIGINT or SIGTERM, so live still prints its counts
+ * and removes the ring.
+ *
+ * Parameters:
+ *  signal - the signal received
+ */
+static void stop_on_signal(int signal) {
+    (void) signal;
+    TraceRing::request_stop();
+}
+
+/*
+ * Simulates a cache against the accesses a producer writes into a
+ * shared-memory ring, until it closes the ring. If it stops early (the
+ * producer exited or never came, an invalid access, SIGINT or SIGTERM)
+ * the counts so far are still printed.
+ * Usage: csim live NAME n_sets n_blocks block_size allocate write [eviction]
+ *
+ * Returns:
+ *  0 if the simulation was successful
+ *  1 if the simulation was unsuccessful or stopped early
+ */
+int live_main(int argc, char * argv[]) {
+    CacheConfig config;
+    if (argc < 8 || argc > 9 || parse_cache_config(argv + 3, argc - 3, config) != CONFIG_VALID) {
+        cerr << "Invalid arguments" << endl;
+        return 1;
+    }
+    CacheSimulator cache(config);
+    TraceRing ring(argv[2], RING_DEFAULT_CAPACITY);
+    if (!ring.is_open()) {
+        cerr << "Could not create ring " << argv[2] << endl;
+        return 1;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stop_on_signal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    int result = ring.drain([&cache](const Access * accesses, size_t n) {
+        cache.replay(accesses, n);
+    });
+    if (result == RING_PRODUCER_GONE) {
+        cerr << "Producer exited without closing the ring" << endl;
+    } else if (result == RING_NO_PRODUCER) {
+        cerr << "No producer attached to ring " << argv[2] << endl;
+    } else if (result == RING_INTERRUPTED) {
+        cerr << "Interrupted" << endl;
+    } else if (result == RING_BAD_RECORD) {
+        cerr << "Invalid access in ring " << argv[2] << endl;
+    }
+    cache.print_counts();
+    cout << "Producer stalls: " << ring.get_header().stalls.load() << endl;
+    cout << "Dropped accesses: " << ring.get_header().drops.load() << endl;
+    return result == RING_CLOSED ? 0 : 1;
+}
+
+/*
+ * Feeds the trace on stdin into the ring of a running csim live, as a
+ * stand-in for an instrumented process.
+ * Usage: csim feed NAME [block|drop]
+ *
+ * Returns:
+ *  0 if the whole trace was read and handed over
+ *  1 otherwise
+ */
+int feed_main(int argc, char * argv[]) {
+    bool is_lossy = false;
+    if (argc < 3 || argc > 4) {
+        cerr << "Invalid arguments" << endl;
+        return 1;
+    }
+    if (argc == 4) {
+        if (strcmp(argv[3], "drop") == 0) {
+            is_lossy = true;
+        } else if (strcmp(argv[3], "block") != 0) {
+            cerr << "Invalid arguments" << endl;
+            return 1;
+        }
+    }
+    TraceRing ring(argv[2]);
+    if (!ring.is_open()) {
+        cerr << "Could not attach to ring " << argv[2] << endl;
+        return 1;
+    }
+
+    bool is_gone = false;
+    bool ok = replay_trace(STDIN_FILENO, [&ring, is_lossy, &is_gone](const Access * accesses, size_t n) {
+        if (!is_gone && ring.produce(accesses, n, is_lossy) < n && !is_lossy) {
+            is_gone = true;
+        }
+    });
+    if (is_gone) {
+        cerr << "Simulator exited" << endl;
+        return 1;
+    }
+    ring.close(); // even after a bad trace, so the simulator finishes
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,196 @@
+/*
+ * Cache simulator live trace ring
+ * CSF Assignment 3
+ */
+
+#ifndef __CSIM_RING_H__
+#define __CSIM_RING_H__
+#include <atomic>
+#include <string>
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+#include "csim_trace.h"
+
+#define RING_MAGIC "CSIMRNG\x1a"
+#define RING_VERSION 2
+
+// accesses the ring holds (a power of 2)
+#define RING_DEFAULT_CAPACITY (1 << 20)
+// most accesses the simulator takes from the ring at once, so the
+// producer sees freed space while a batch is still being simulated
+#define RING_BATCH_SIZE 4096
+// how long a producer waits for the simulator to create the ring
+#define RING_ATTACH_TIMEOUT_MS 10000
+// how long the simulator waits for a producer to attach
+#define RING_PRODUCER_TIMEOUT_MS 60000
+// times a side with nothing to do yields before it sleeps between checks
+// (and checks that the other side is still alive)
+#define RING_SPIN_LIMIT 1000
+#define RING_IDLE_SLEEP_US 1000
+
+// how TraceRing::drain() ended
+#define RING_CLOSED 0        // the producer closed the ring
+#define RING_PRODUCER_GONE 1 // the producer exited without closing it
+#define RING_NO_PRODUCER 2   // no producer attached in time
+#define RING_INTERRUPTED 3   // request_stop() was called (e.g. on SIGINT)
+#define RING_BAD_RECORD 4    // the producer wrote an invalid access
+
+/*
+ * Header at the start of a ring's shared memory, followed by capacity
+ * Access records. The producer owns head and the counters, the
+ * simulator owns tail; each sits on its own cache line so the two
+ * processes do not fight over a line on every update.
+ */
+struct RingHeader {
+    char magic[8];                // RING_MAGIC
+    uint32_t version;             // RING_VERSION
+    uint32_t capacity;            // records in the ring (a power of 2)
+    std::atomic<uint32_t> ready;  // set once the header is initialized
+    std::atomic<uint32_t> closed; // set by the producer after its last access
+    std::atomic<int32_t> consumer_pid; // process that created the ring
+    std::atomic<int32_t> producer_pid; // process that attached to it (0 until one does)
+
+    alignas(64) std::atomic<uint64_t> head; // accesses written by the producer
+    std::atomic<uint64_t> stalls; // times the producer found the ring full and waited
+    std::atomic<uint64_t> drops;  // accesses the producer discarded because the ring was full
+
+    alignas(64) std::atomic<uint64_t> tail; // accesses taken by the simulator
+};
+
+/*
+ * Single-producer, single-consumer ring of accesses in POSIX shared
+ * memory, through which an instrumented process hands accesses to a
+ * simulator running alongside it. Neither side takes a lock: the
+ * producer publishes records by advancing head, the consumer frees
+ * them by advancing tail, and a side with nothing to do yields the CPU,
+ * then sleeps, checking by pid that the other side is still alive.
+ * A full ring either stalls the producer or makes it drop accesses.
+ */
+class TraceRing {
+public:
+    /*
+     * Creates a ring, replacing any left over under the same name.
+     *
+     * Parameters:
+     *  name - shared memory object name (a leading '/' is added if missing)
+     *  capacity - records in the ring (a power of 2)
+     *
+     * Returns:
+     *  a new TraceRing object (check is_open())
+     */
+    TraceRing(const std::string & name, uint32_t capacity);
+
+    /*
+     * Attaches to a ring created by another process, waiting up to
+     * RING_ATTACH_TIMEOUT_MS for it to appear.
+     *
+     * Parameters:
+     *  name - shared memory object name (a leading '/' is added if missing)
+     *
+     * Returns:
+     *  a new TraceRing object (check is_open())
+     */
+    explicit TraceRing(const std::string & name);
+
+    /*
+     * Unmaps the ring, and removes its name if this object created it.
+     */
+    ~TraceRing();
+
+    /*
+     * Returns true if the ring is mapped and ready to use.
+     */
+    bool is_open() const { return header != nullptr; }
+
+    /*
+     * Returns the ring's header, shared with the other process.
+     */
+    const RingHeader & get_header() const { return *header; }
+
+    /*
+     * Writes accesses into the ring (producer side).
+     *
+     * Parameters:
+     *  accesses - first access to write
+     *  n - number of accesses
+     *  is_lossy - if the ring is full, drop the rest of the accesses
+     *             (counted in drops) instead of waiting for room
+     *
+     * Returns:
+     *  number of accesses written (fewer than n without is_lossy only
+     *  if the simulator exited)
+     */
+    size_t produce(const Access * accesses, size_t n, bool is_lossy);
+
+    /*
+     * Tells the consumer that no more accesses will come (producer side).
+     */
+    void close();
+
+    /*
+     * Hands the ring's accesses to a callback in batches, in place,
+     * until the producer closes the ring and it is empty (consumer side).
+     * Gives up early if the producer exits or never attaches, if
+     * request_stop() is called, or on an invalid access.
+     *
+     * Parameters:
+     *  consume - called with each batch of accesses, in order
+     *
+     * Returns:
+     *  RING_CLOSED, RING_PRODUCER_GONE, RING_NO_PRODUCER,
+     *  RING_INTERRUPTED or RING_BAD_RECORD
+     */
+    int drain(const std::function<void (const Access *, size_t)> & consume);
+
+    /*
+     * Makes drain() return RING_INTERRUPTED. Safe to call from a signal handler.
+     */
+    static void request_stop();
+
+private:
+    std::string name;
+    RingHeader * header = nullptr;
+    Access * records = nullptr;
+    size_t length = 0;     // bytes mapped
+    bool is_owner = false; // did this object create the ring?
+
+    /*
+     * Maps the ring's shared memory.
+     *
+     * Parameters:
+     *  fd - open shared memory object
+     *  bytes - size of the mapping
+     *
+     * Returns:
+     *  true if successful
+     */
+    bool map(int fd, size_t bytes);
+
+    TraceRing(const TraceRing &);
+    TraceRing & operator=(const TraceRing &);
+};
+
+/*
+ * Simulates a cache against the accesses a producer writes into a
+ * shared-memory ring, until it closes the ring.
+ * Usage: csim live NAME n_sets n_blocks block_size allocate write [eviction]
+ *
+ * Returns:
+ *  0 if the simulation was successful
+ *  1 if the simulation was unsuccessful
+ */
+int live_main(int argc, char * argv[]);
+
+/*
+ * Feeds the trace on stdin into the ring of a running csim live, as a
+ * stand-in for an instrumented process.
+ * Usage: csim feed NAME [block|drop]
+ *
+ * Returns:
+ *  0 if the whole trace was read
+ *  1 otherwise
+ */
+int feed_main(int argc, char * argv[]);
+
+#endif
@@ -0,0 +1,218 @@
+/*
+ * Cache simulator set sampling
+ * CSF Assignment 3
+ */
+
+#include <iostream>
+#include <cmath>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "csim_sample.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using namespace std;
+
+/*
+ * Mixes the bits of a set index, so sampled sets are spread over the
+ * cache rather than one every period indices.
+ */
+static uint32_t index_hash(uint32_t index) {
+    index ^= index >> 16;
+    index *= 0x45d9f3b;
+    index ^= index >> 16;
+    index *= 0x45d9f3b;
+    index ^= index >> 16;
+    return index;
+}
+
+/*
+ * Constructs a SetSampler object.
+ *
+ * Parameters:
+ *  config - cache configuration
+ *  period - one set in about this many is simulated
+ *
+ * Returns:
+ *  a new SetSampler object
+ */
+SetSampler::SetSampler(const CacheConfig & config, uint32_t period) : cache(config) {
+    slot_of.assign(config.n_sets, NO_BLOCK);
+    uint32_t n_sampled = 0;
+    for (uint32_t index = 0; index < (uint32_t) config.n_sets; index++) {
+        if (index_hash(index) % period == 0) {
+            slot_of[index] = n_sampled++;
+        }
+    }
+
+    // the confidence intervals need the spread of at least two sets
+    for (uint32_t index = 0; n_sampled < 2 && index < (uint32_t) config.n_sets; index++) {
+        if (slot_of[index] == NO_BLOCK) {
+            slot_of[index] = n_sampled++;
+        }
+    }
+    counts.resize(n_sampled);
+}
+
+/*
+ * Simulates the accesses of a batch that fall in sampled sets.
+ *
+ * Parameters:
+ *  accesses - first access to simulate
+ *  n - number of accesses
+ */
+void SetSampler::replay(const Access * accesses, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        // an access crossing into other blocks touches each of them, and counts
+        // once as split however many it spans, as in CacheSimulator
+        uint64_t n_blocks = cache.blocks_spanned(accesses[i].address, accesses[i].size);
+        if (n_blocks > 1) {
+            total_split_accesses++;
+        }
+        for (uint64_t j = 0; j < n_blocks; j++) {
+            uint64_t address = j == 0 ? accesses[i].address
+                : ((accesses[i].address >> cache.offset_bits) + j) << cache.offset_bits;
+            access(address, accesses[i].op == ACCESS_STORE);
+        }
+    }
+}
+
+/*
+ * Simulates one access if it falls in a sampled set.
+ *
+ * Parameters:
+ *  address - the address accessed (within one block)
+ *  is_store - is the access a store?
+ */
+void SetSampler::access(uint64_t address, bool is_store) {
+    if (is_store) {
+        total_stores++;
+    } else {
+        total_loads++;
+    }
+    uint32_t slot = slot_of[cache.get_index(address)];
+    if (slot == NO_BLOCK) { // set not sampled
+        return;
+    }
+
+    // charge the simulator's counters to the set
+    SetCounts & set = counts[slot];
+    uint64_t cycles = cache.total_cycles;
+    if (is_store) {
+        uint64_t hits = cache.total_store_hits;
+        cache.store(address);
+        set.stores++;
+        if (cache.total_store_hits != hits) {
+            set.store_hits++;
+        } else {
+            set.store_misses++;
+        }
+    } else {
+        uint64_t hits = cache.total_load_hits;
+        cache.load(address);
+        set.loads++;
+        if (cache.total_load_hits != hits) {
+            set.load_hits++;
+        } else {
+            set.load_misses++;
+        }
+    }
+    set.accesses++;
+    set.cycles += cache.total_cycles - cycles;
+}
+
+/*
+ * Estimates a total over every set from a statistic of the sampled
+ * sets and a matching count known over every set.
+ *
+ * Parameters:
+ *  value - statistic of a set
+ *  base - count of a set the statistic is proportional to
+ *  base_total - that count over every set
+ *  error - receives the half-width of the 95% confidence interval
+ *
+ * Returns:
+ *  the estimated total
+ */
+double SetSampler::estimate(uint64_t SetCounts::*value, uint64_t SetCounts::*base, uint64_t base_total, double & error) const {
+    double n = counts.size();
+    double n_sets = cache.n_sets;
+    double sum_value = 0;
+    double sum_base = 0;
+    for (size_t i = 0; i < counts.size(); i++) {
+        sum_value += counts[i].*value;
+        sum_base += counts[i].*base;
+    }
+    double ratio = sum_base > 0 ? sum_value / sum_base : 0;
+
+    // variance of a ratio estimate of a total, from the residuals of the sets
+    double squares = 0;
+    for (size_t i = 0; i < counts.size(); i++) {
+        double residual = counts[i].*value - ratio * counts[i].*base;
+        squares += residual * residual;
+    }
+    double variance = n > 1 ? n_sets * n_sets * (1 - n / n_sets) / n * squares / (n - 1) : 0;
+    error = SAMPLE_Z_95 * sqrt(variance);
+    return ratio * base_total;
+}
+
+/*
+ * Prints the estimated statistics, as print_counts() does, each with
+ * the half-width of its 95% confidence interval.
+ *
+ * Parameters:
+ *  out - stream to print to
+ */
+void SetSampler::print_counts(ostream & out) const {
+    static const char * const names[] = {"Load hits", "Load misses", "Store hits", "Store misses", "Total cycles"};
+    uint64_t SetCounts::* const values[] = {
+        &SetCounts::load_hits, &SetCounts::load_misses, &SetCounts::store_hits, &SetCounts::store_misses, &SetCounts::cycles
+    };
+    uint64_t SetCounts::* const bases[] = {
+        &SetCounts::loads, &SetCounts::loads, &SetCounts::stores, &SetCounts::stores, &SetCounts::accesses
+    };
+    uint64_t base_totals[] = {total_loads, total_loads, total_stores, total_stores, total_loads + total_stores};
+
+    out << "Total loads: " << total_loads << endl;
+    out << "Total stores: " << total_stores << endl;
+    for (int i = 0; i < 5; i++) {
+        double error;
+        double total = estimate(values[i], bases[i], base_totals[i], error);
+        out << names[i] << ": " << llround(total) << " +/- " << llround(error) << endl;
+    }
+    if (total_split_accesses > 0) {
+        out << "Split accesses: " << total_split_accesses << endl;
+    }
+    out << "Sampled sets: " << counts.size() << " of " << cache.n_sets << endl;
+}
+
+/*
+ * Simulates a cache on a sample of its sets against the trace on stdin.
+ * Usage: csim --sample-sets N n_sets n_blocks block_size allocate write [eviction]
+ *
+ * Returns:
+ *  0 if the simulation was successful
+ *  1 if the simulation was unsuccessful
+ */
+int sample_main(int argc, char * argv[]) {
+    char * end;
+    long period = argc > 2 ? strtol(argv[2], &end, 10) : 0;
+    CacheConfig config;
+    if (argc < 8 || argc > 9 || *end != '\0' || period < 1 || period > UINT32_MAX
+        || parse_cache_config(argv + 3, argc - 3, config) != CONFIG_VALID) {
+        cerr << "Invalid arguments" << endl;
+        return 1;
+    }
+    SetSampler sampler(config, (uint32_t) period);
+
+    bool ok = replay_trace(STDIN_FILENO, [&sampler](const Access * accesses, size_t n) {
+        sampler.replay(accesses, n);
+    });
+    if (!ok) {
+        return 1;
+    }
+    sampler.print_counts(cout);
+    return 0;
+}
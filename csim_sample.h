@@ -0,0 +1,116 @@
+/*
+ * Cache simulator set sampling
+ * CSF Assignment 3
+ */
+
+#ifndef __CSIM_SAMPLE_H__
+#define __CSIM_SAMPLE_H__
+#include <vector>
+#include <ostream>
+#include "csim_functions.h"
+
+// normal quantile of the 95% confidence intervals of sampled estimates
+#define SAMPLE_Z_95 1.96
+
+// statistics of one sampled set
+struct SetCounts {
+    uint64_t loads = 0;
+    uint64_t stores = 0;
+    uint64_t load_hits = 0;
+    uint64_t load_misses = 0;
+    uint64_t store_hits = 0;
+    uint64_t store_misses = 0;
+    uint64_t accesses = 0;
+    uint64_t cycles = 0;
+};
+
+/*
+ * Simulates one set in every period (picked by hashing the index from
+ * get_index()) and extrapolates the statistics of the whole cache. Sets
+ * do not interact, so the sampled sets behave exactly as in a full run
+ * (except under drrip, whose set dueling only hears from sampled leader
+ * sets, and random, which draws a different sequence); only accesses to
+ * them are simulated.
+ *
+ * Loads and stores are counted exactly over every access. The other
+ * statistics are ratio estimates: a count per load (or store, or
+ * access) measured on the sampled sets, times the exact number of loads
+ * (or stores, or accesses). Their confidence intervals come from the
+ * spread of the per-set residuals, treating sets as clusters drawn
+ * without replacement.
+ */
+class SetSampler {
+public:
+    CacheSimulator cache; // the whole cache; only the sampled sets are touched
+    std::vector<uint32_t> slot_of; // per set index, position in counts (NO_BLOCK if not sampled)
+    std::vector<SetCounts> counts; // statistics of every sampled set
+    uint64_t total_loads = 0;  // over every access, sampled or not
+    uint64_t total_stores = 0;
+    uint64_t total_split_accesses = 0; // accesses that crossed into another block, each counted once however many blocks it spans
+
+    /*
+     * Constructs a SetSampler object.
+     *
+     * Parameters:
+     *  config - cache configuration
+     *  period - one set in about this many is simulated
+     *
+     * Returns:
+     *  a new SetSampler object
+     */
+    SetSampler(const CacheConfig & config, uint32_t period);
+
+    /*
+     * Simulates the accesses of a batch that fall in sampled sets.
+     *
+     * Parameters:
+     *  accesses - first access to simulate
+     *  n - number of accesses
+     */
+    void replay(const Access * accesses, size_t n);
+
+    /*
+     * Simulates one access if it falls in a sampled set.
+     *
+     * Parameters:
+     *  address - the address accessed (within one block)
+     *  is_store - is the access a store?
+     */
+    void access(uint64_t address, bool is_store);
+
+    /*
+     * Estimates a total over every set from a statistic of the sampled
+     * sets and a matching count known over every set.
+     *
+     * Parameters:
+     *  value - statistic of a set
+     *  base - count of a set the statistic is proportional to
+     *  base_total - that count over every set
+     *  error - receives the half-width of the 95% confidence interval
+     *
+     * Returns:
+     *  the estimated total
+     */
+    double estimate(uint64_t SetCounts::*value, uint64_t SetCounts::*base, uint64_t base_total, double & error) const;
+
+    /*
+     * Prints the estimated statistics, as print_counts() does, each with
+     * the half-width of its 95% confidence interval.
+     *
+     * Parameters:
+     *  out - stream to print to
+     */
+    void print_counts(std::ostream & out) const;
+};
+
+/*
+ * Simulates a cache on a sample of its sets against the trace on stdin.
+ * Usage: csim --sample-sets N n_sets n_blocks block_size allocate write [eviction]
+ *
+ * Returns:
+ *  0 if the simulation was successful
+ *  1 if the simulation was unsuccessful
+ */
+int sample_main(int argc, char * argv[]);
+
+#endif
@@ -0,0 +1,179 @@
+/*
+ * Cache simulator vectorized set kernels
+ * CSF Assignment 3
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "csim_simd.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CSIM_X86 1
+#endif
+
+/*
+ * Compares every tag of a set against a target tag, one tag at a time.
+ */
+static uint32_t match_tags_scalar(const uint32_t * tags, uint32_t n, uint32_t tag) {
+    uint32_t matches = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        matches |= (uint32_t) (tags[i] == tag) << i;
+    }
+    return matches;
+}
+
+/*
+ * Compares every 64-bit tag of a set against a target tag, one tag at a time.
+ */
+static uint32_t match_wide_tags_scalar(const uint64_t * tags, uint32_t n, uint64_t tag) {
+    uint32_t matches = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        matches |= (uint32_t) (tags[i] == tag) << i;
+    }
+    return matches;
+}
+
+/*
+ * Finds the first smallest value of an array, one value at a time.
+ */
+static uint32_t argmin_scalar(const uint64_t * values, uint32_t n) {
+    uint64_t min_value = values[0];
+    uint32_t min_index = 0;
+    for (uint32_t i = 1; i < n; i++) {
+        if (values[i] < min_value) {
+            min_value = values[i];
+            min_index = i;
+        }
+    }
+    return min_index;
+}
+
+#ifdef CSIM_X86
+
+/*
+ * Compares every tag of a set against a target tag, 4 tags per instruction.
+ */
+static uint32_t match_tags_sse2(const uint32_t * tags, uint32_t n, uint32_t tag) {
+    if (n < 4) {
+        return match_tags_scalar(tags, n, tag);
+    }
+    __m128i target = _mm_set1_epi32((int) tag);
+    uint32_t matches = 0;
+    for (uint32_t i = 0; i < n; i += 4) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *) (tags + i));
+        __m128i equal = _mm_cmpeq_epi32(chunk, target);
+        matches |= (uint32_t) _mm_movemask_ps(_mm_castsi128_ps(equal)) << i;
+    }
+    return matches;
+}
+
+/*
+ * Compares every tag of a set against a target tag, 8 tags per instruction.
+ */
+__attribute__((target("avx2")))
+static uint32_t match_tags_avx2(const uint32_t * tags, uint32_t n, uint32_t tag) {
+    if (n < 8) {
+        return match_tags_sse2(tags, n, tag);
+    }
+    __m256i target = _mm256_set1_epi32((int) tag);
+    uint32_t matches = 0;
+    for (uint32_t i = 0; i < n; i += 8) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *) (tags + i));
+        __m256i equal = _mm256_cmpeq_epi32(chunk, target);
+        matches |= (uint32_t) _mm256_movemask_ps(_mm256_castsi256_ps(equal)) << i;
+    }
+    return matches;
+}
+
+/*
+ * Compares every 64-bit tag of a set against a target tag, 4 tags per instruction.
+ */
+__attribute__((target("avx2")))
+static uint32_t match_wide_tags_avx2(const uint64_t * tags, uint32_t n, uint64_t tag) {
+    if (n < 4) {
+        return match_wide_tags_scalar(tags, n, tag);
+    }
+    __m256i target = _mm256_set1_epi64x((long long) tag);
+    uint32_t matches = 0;
+    for (uint32_t i = 0; i < n; i += 4) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *) (tags + i));
+        __m256i equal = _mm256_cmpeq_epi64(chunk, target);
+        matches |= (uint32_t) _mm256_movemask_pd(_mm256_castsi256_pd(equal)) << i;
+    }
+    return matches;
+}
+
+/*
+ * Finds the first smallest value of an array: a vertical unsigned minimum
+ * over 4 lanes (AVX2 only compares signed 64-bit lanes, so the sign bits
+ * are flipped first), a horizontal reduction, then a compare to locate it.
+ */
+__attribute__((target("avx2")))
+static uint32_t argmin_avx2(const uint64_t * values, uint32_t n) {
+    if (n < 4) {
+        return argmin_scalar(values, n);
+    }
+    uint32_t n_vector = n & ~3u;
+    const __m256i sign = _mm256_set1_epi64x((long long) 0x8000000000000000ULL);
+    __m256i lanes = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) values), sign);
+    for (uint32_t i = 4; i < n_vector; i += 4) {
+        __m256i chunk = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) (values + i)), sign);
+        lanes = _mm256_blendv_epi8(lanes, chunk, _mm256_cmpgt_epi64(lanes, chunk));
+    }
+    uint64_t lane_values[4];
+    _mm256_storeu_si256((__m256i *) lane_values, _mm256_xor_si256(lanes, sign));
+    uint64_t min_value = lane_values[0];
+    for (uint32_t i = 1; i < 4; i++) {
+        min_value = lane_values[i] < min_value ? lane_values[i] : min_value;
+    }
+    for (uint32_t i = n_vector; i < n; i++) {
+        if (values[i] < min_value) {
+            min_value = values[i];
+        }
+    }
+
+    __m256i target = _mm256_set1_epi64x((long long) min_value);
+    for (uint32_t i = 0; i < n_vector; i += 4) {
+        __m256i equal = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i *) (values + i)), target);
+        int mask = _mm256_movemask_pd(_mm256_castsi256_pd(equal));
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    for (uint32_t i = n_vector; ; i++) {
+        if (values[i] == min_value) {
+            return i;
+        }
+    }
+}
+
+#endif
+
+/*
+ * Picks the best kernels for this CPU, capped by the CSIM_SIMD environment variable.
+ */
+static SimdKernels select_kernels() {
+    const char * cap = getenv("CSIM_SIMD");
+    SimdKernels kernels = { "scalar", match_tags_scalar, match_wide_tags_scalar, argmin_scalar };
+    if (cap != nullptr && strcmp(cap, "scalar") == 0) {
+        return kernels;
+    }
+#ifdef CSIM_X86
+    kernels.name = "sse2";
+    kernels.match_tags = match_tags_sse2;
+    if (cap != nullptr && strcmp(cap, "sse2") == 0) {
+        return kernels;
+    }
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        kernels.name = "avx2";
+        kernels.match_tags = match_tags_avx2;
+        kernels.match_wide_tags = match_wide_tags_avx2;
+        kernels.argmin = argmin_avx2;
+    }
+#endif
+    return kernels;
+}
+
+const SimdKernels simd = select_kernels();
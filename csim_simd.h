@@ -0,0 +1,53 @@
+/*
+ * Cache simulator vectorized set kernels
+ * CSF Assignment 3
+ */
+
+#ifndef __CSIM_SIMD_H__
+#define __CSIM_SIMD_H__
+#include <stdint.h>
+
+/*
+ * Set-scan kernels, in the best version the CPU supports (AVX2, SSE2 or
+ * portable scalar code), chosen once at startup. The CSIM_SIMD environment
+ * variable ("avx2", "sse2" or "scalar") caps the choice, e.g. to compare
+ * against the scalar fallback.
+ */
+struct SimdKernels {
+    const char * name;
+
+    /*
+     * Compares every tag of a set against a target tag.
+     *
+     * Parameters:
+     *  tags - the set's contiguous tags
+     *  n - number of tags (at most 32)
+     *  tag - target tag
+     *
+     * Returns:
+     *  bitmask with bit i set if tags[i] == tag
+     */
+    uint32_t (*match_tags)(const uint32_t * tags, uint32_t n, uint32_t tag);
+
+    /*
+     * Compares every 64-bit tag of a set against a target tag, as match_tags.
+     */
+    uint32_t (*match_wide_tags)(const uint64_t * tags, uint32_t n, uint64_t tag);
+
+    /*
+     * Finds the smallest value of an array, e.g. the oldest fill time of a set.
+     *
+     * Parameters:
+     *  values - the array
+     *  n - number of values (at least 1)
+     *
+     * Returns:
+     *  index of the first smallest value
+     */
+    uint32_t (*argmin)(const uint64_t * values, uint32_t n);
+};
+
+// kernels selected for this CPU
+extern const SimdKernels simd;
+
+#endif
@@ -0,0 +1,321 @@
+/*
+ * Cache simulator configuration sweeps
+ * CSF Assignment 3
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <thread>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "csim_sweep.h"
+#include "csim_pool.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using namespace std;
+
+// accesses per window shared by the threads of a parallel sweep
+#define SWEEP_WINDOW_SIZE (1 << 20)
+#define SWEEP_MAX_JOBS 1024
+
+/*
+ * Splits a field into its comma-separated values.
+ *
+ * Parameters:
+ *  field - the field
+ *
+ * Returns:
+ *  the values (empty values are dropped)
+ */
+static vector<string> split_values(const string & field) {
+    vector<string> values;
+    stringstream ss(field);
+    string value;
+    while (getline(ss, value, ',')) {
+        if (!value.empty()) {
+            values.push_back(value);
+        }
+    }
+    return values;
+}
+
+/*
+ * Checks whether a configuration is already in a list.
+ *
+ * Parameters:
+ *  configs - the list
+ *  first - first index to look at
+ *  config - the configuration
+ *
+ * Returns:
+ *  true if configs[first..] holds an identical configuration
+ */
+static bool is_listed(const vector<CacheConfig> & configs, size_t first, const CacheConfig & config) {
+    for (size_t i = first; i < configs.size(); i++) {
+        const CacheConfig & other = configs[i];
+        if (other.n_sets == config.n_sets && other.n_blocks == config.n_blocks
+            && other.block_size == config.block_size && other.is_write_allocate == config.is_write_allocate
+            && other.is_write_through == config.is_write_through && other.eviction == config.eviction) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Expands one sweep line into cache configurations. Each field takes the
+ * same values as the matching command line argument, or a comma-separated
+ * list of them; the line stands for every combination of the listed values.
+ * Combinations that cannot be simulated (no-write-allocate with write-back,
+ * or an associative cache without an eviction policy) are skipped, and a
+ * direct-mapped cache gets a single configuration, without an eviction
+ * policy, however many policies are listed.
+ *
+ * Parameters:
+ *  fields - the 5 or 6 fields of the line
+ *  configs - vector to append the configurations to
+ *
+ * Returns:
+ *  true if successful
+ *  false if a value is malformed or no combination is valid
+ */
+bool expand_sweep_line(const vector<string> & fields, vector<CacheConfig> & configs) {
+    int n_fields = fields.size();
+    if (n_fields < 5 || n_fields > 6) {
+        return false;
+    }
+
+    vector< vector<string> > values(n_fields);
+    for (int i = 0; i < n_fields; i++) {
+        values[i] = split_values(fields[i]);
+        if (values[i].empty()) {
+            return false;
+        }
+    }
+
+    // walk every combination like an odometer over the value lists
+    vector<size_t> pick(n_fields, 0);
+    size_t first = configs.size();
+    size_t n_valid = 0;
+    while (true) {
+        const char * args[6];
+        for (int i = 0; i < n_fields; i++) {
+            args[i] = values[i][pick[i]].c_str();
+        }
+
+        CacheConfig config;
+        int result = parse_cache_config(args, n_fields, config);
+        if (result == CONFIG_BAD_VALUE) {
+            return false;
+        } else if (result == CONFIG_VALID) {
+            // a direct-mapped cache never picks a victim, so every policy gives the same row
+            if (config.n_blocks == 1) {
+                config.eviction = EVICT_NONE;
+            }
+            if (!is_listed(configs, first, config)) {
+                configs.push_back(config);
+            }
+            n_valid++;
+        }
+
+        int i = n_fields - 1;
+        while (i >= 0 && ++pick[i] == values[i].size()) {
+            pick[i] = 0;
+            i--;
+        }
+        if (i < 0) {
+            break;
+        }
+    }
+    return n_valid > 0;
+}
+
+/*
+ * Reads sweep lines from a file, one per line. Blank lines and lines
+ * starting with '#' are ignored.
+ *
+ * Parameters:
+ *  path - file to read
+ *  configs - vector to append the configurations to
+ *
+ * Returns:
+ *  true if successful
+ *  false if the file could not be read or a line is invalid
+ */
+bool read_sweep_file(const char * path, vector<CacheConfig> & configs) {
+    ifstream in(path);
+    if (!in) {
+        cerr << "Could not read sweep file " << path << endl;
+        return false;
+    }
+
+    string line;
+    int line_no = 0;
+    while (getline(in, line)) {
+        line_no++;
+        stringstream ss(line);
+        vector<string> fields;
+        string field;
+        while (ss >> field) {
+            fields.push_back(field);
+        }
+        if (fields.empty() || fields[0][0] == '#') {
+            continue;
+        }
+        if (!expand_sweep_line(fields, configs)) {
+            cerr << "Invalid sweep line " << line_no << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Prints the header of the sweep results table.
+ *
+ * Parameters:
+ *  out - stream to print to
+ */
+void print_sweep_header(ostream & out) {
+    out << setw(8) << "sets" << setw(7) << "blocks" << setw(6) << "bytes"
+        << setw(18) << "allocate" << setw(14) << "write" << setw(10) << "eviction"
+        << setw(13) << "loads" << setw(13) << "stores"
+        << setw(13) << "load_hits" << setw(13) << "load_misses"
+        << setw(13) << "store_hits" << setw(13) << "store_misses"
+        << setw(16) << "cycles" << setw(13) << "split" << endl;
+}
+
+/*
+ * Prints one row of the sweep results table.
+ *
+ * Parameters:
+ *  out - stream to print to
+ *  config - configuration that was simulated
+ *  cache - simulator holding the statistics
+ */
+void print_sweep_row(ostream & out, const CacheConfig & config, const CacheSimulator & cache) {
+    out << setw(8) << config.n_sets << setw(7) << config.n_blocks << setw(6) << config.block_size
+        << setw(18) << (config.is_write_allocate ? "write-allocate" : "no-write-allocate")
+        << setw(14) << (config.is_write_through ? "write-through" : "write-back")
+        << setw(10) << eviction_policy_name(config.eviction)
+        << setw(13) << cache.total_loads << setw(13) << cache.total_stores
+        << setw(13) << cache.total_load_hits << setw(13) << cache.total_load_misses
+        << setw(13) << cache.total_store_hits << setw(13) << cache.total_store_misses
+        << setw(16) << cache.total_cycles << setw(13) << cache.total_split_accesses << endl;
+}
+
+/*
+ * Replays the trace on stdin against every simulator of a sweep.
+ * With more than one job, the trace is decoded into windows shared
+ * read-only by all threads, and each window is simulated by spreading the
+ * simulators over a work-stealing pool, most associative (slowest) first.
+ *
+ * Parameters:
+ *  configs - configurations of the simulators
+ *  caches - simulators to drive
+ *  n_jobs - number of threads to simulate with
+ *
+ * Returns:
+ *  true if the whole trace was replayed
+ *  false if the trace could not be read
+ */
+bool replay_sweep(const vector<CacheConfig> & configs, vector<CacheSimulator> & caches, int n_jobs) {
+    if (n_jobs <= 1) {
+        // every simulator replays each batch while it is still in the processor cache
+        return replay_trace(STDIN_FILENO, [&caches](const Access * accesses, size_t n) {
+            for (size_t i = 0; i < caches.size(); i++) {
+                caches[i].replay(accesses, n);
+            }
+        });
+    }
+
+    vector<size_t> order(caches.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    stable_sort(order.begin(), order.end(), [&configs](size_t a, size_t b) {
+        return configs[a].n_blocks > configs[b].n_blocks;
+    });
+
+    WorkStealingPool pool(n_jobs);
+    vector<Access> window;
+    window.reserve(SWEEP_WINDOW_SIZE);
+    function<void (size_t)> simulate = [&caches, &window](size_t i) {
+        caches[i].replay(window.data(), window.size());
+    };
+
+    bool ok = replay_trace(STDIN_FILENO, [&](const Access * accesses, size_t n) {
+        window.insert(window.end(), accesses, accesses + n);
+        if (window.size() >= SWEEP_WINDOW_SIZE) {
+            pool.run(order, simulate);
+            window.clear();
+        }
+    });
+    if (ok && !window.empty()) {
+        pool.run(order, simulate);
+    }
+    return ok;
+}
+
+/*
+ * Simulates every configuration of a sweep against the trace on stdin,
+ * reading the trace once, and prints one table row per configuration.
+ * Usage: csim sweep [--jobs N] FILE
+ *        csim sweep [--jobs N] n_sets n_blocks block_size allocate write [eviction]
+ * N = 0 uses every core.
+ *
+ * Returns:
+ *  0 if the sweep was successful
+ *  1 if the sweep was unsuccessful
+ */
+int sweep_main(int argc, char * argv[]) {
+    int arg = 2;
+    int n_jobs = 1;
+    if (argc > arg + 1 && strcmp(argv[arg], "--jobs") == 0) {
+        char * end;
+        long value = strtol(argv[arg + 1], &end, 10);
+        if (*end != '\0' || value < 0 || value > SWEEP_MAX_JOBS) {
+            cerr << "Invalid arguments" << endl;
+            return 1;
+        }
+        n_jobs = value != 0 ? (int) value : (int) thread::hardware_concurrency();
+        arg += 2;
+    }
+
+    vector<CacheConfig> configs;
+    if (argc - arg == 1) {
+        if (!read_sweep_file(argv[arg], configs)) {
+            return 1;
+        }
+    } else if (!expand_sweep_line(vector<string>(argv + arg, argv + argc), configs)) {
+        cerr << "Invalid arguments" << endl;
+        return 1;
+    }
+    if (configs.empty()) {
+        cerr << "Invalid arguments" << endl;
+        return 1;
+    }
+
+    vector<CacheSimulator> caches;
+    caches.reserve(configs.size());
+    for (size_t i = 0; i < configs.size(); i++) {
+        caches.push_back(CacheSimulator(configs[i]));
+    }
+
+    if (!replay_sweep(configs, caches, n_jobs)) {
+        return 1;
+    }
+
+    // rows follow the order of the configurations, whichever thread ran them
+    print_sweep_header(cout);
+    for (size_t i = 0; i < configs.size(); i++) {
+        print_sweep_row(cout, configs[i], caches[i]);
+    }
+    return 0;
+}
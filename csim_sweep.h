@@ -0,0 +1,94 @@
+/*
+ * Cache simulator configuration sweeps
+ * CSF Assignment 3
+ */
+
+#ifndef __CSIM_SWEEP_H__
+#define __CSIM_SWEEP_H__
+#include <vector>
+#include <string>
+#include <ostream>
+#include "csim_functions.h"
+
+/*
+ * Expands one sweep line into cache configurations. Each field takes the
+ * same values as the matching command line argument, or a comma-separated
+ * list of them; the line stands for every combination of the listed values.
+ * Combinations that cannot be simulated (no-write-allocate with write-back,
+ * or an associative cache without an eviction policy) are skipped, and a
+ * direct-mapped cache gets a single configuration, without an eviction
+ * policy, however many policies are listed.
+ *
+ * Parameters:
+ *  fields - the 5 or 6 fields of the line
+ *  configs - vector to append the configurations to
+ *
+ * Returns:
+ *  true if successful
+ *  false if a value is malformed or no combination is valid
+ */
+bool expand_sweep_line(const std::vector<std::string> & fields, std::vector<CacheConfig> & configs);
+
+/*
+ * Reads sweep lines from a file, one per line. Blank lines and lines
+ * starting with '#' are ignored.
+ *
+ * Parameters:
+ *  path - file to read
+ *  configs - vector to append the configurations to
+ *
+ * Returns:
+ *  true if successful
+ *  false if the file could not be read or a line is invalid
+ */
+bool read_sweep_file(const char * path, std::vector<CacheConfig> & configs);
+
+/*
+ * Prints the header of the sweep results table.
+ *
+ * Parameters:
+ *  out - stream to print to
+ */
+void print_sweep_header(std::ostream & out);
+
+/*
+ * Prints one row of the sweep results table.
+ *
+ * Parameters:
+ *  out - stream to print to
+ *  config - configuration that was simulated
+ *  cache - simulator holding the statistics
+ */
+void print_sweep_row(std::ostream & out, const CacheConfig & config, const CacheSimulator & cache);
+
+/*
+ * Replays the trace on stdin against every simulator of a sweep.
+ * With more than one job, the trace is decoded into windows shared
+ * read-only by all threads, and each window is simulated by spreading the
+ * simulators over a work-stealing pool, most associative (slowest) first.
+ *
+ * Parameters:
+ *  configs - configurations of the simulators
+ *  caches - simulators to drive
+ *  n_jobs - number of threads to simulate with
+ *
+ * Returns:
+ *  true if the whole trace was replayed
+ *  false if the trace could not be read
+ */
+bool replay_sweep(const std::vector<CacheConfig> & configs, std::vector<CacheSimulator> & caches, int n_jobs);
+
+/*
+ * Simulates every configuration of a sweep against the trace on stdin,
+ * reading the trace once, and prints one table row per configuration.
+ * Usage: csim sweep [--jobs N] FILE
+ *        csim sweep [--jobs N] n_sets n_blocks block_size allocate write [eviction]
+ * N = 0 uses every core.
+ *
+ * Returns:
+ *  0 if the sweep was successful
+ *  1 if the sweep was unsuccessful
+ */
+int sweep_main(int argc, char * argv[]);
+
+#endif
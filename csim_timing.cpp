@@ -0,0 +1,326 @@
+/*
+ * Cache simulator timing model
+ * CSF Assignment 3
+ */
+
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "csim_timing.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using namespace std;
+
+/*
+ * Parses a timing parameter given as a decimal number.
+ *
+ * Parameters:
+ *  value - the text
+ *  parameter - receives the number
+ *
+ * Returns:
+ *  true if successful
+ *  false if the text is not a number
+ */
+static bool parse_parameter(const string & value, uint32_t & parameter) {
+    if (value.empty() || value[0] < '0' || value[0] > '9') {
+        return false;
+    }
+    char * end;
+    unsigned long n = strtoul(value.c_str(), &end, 10);
+    if (*end != '\0' || n > UINT32_MAX) {
+        return false;
+    }
+    parameter = (uint32_t) n;
+    return true;
+}
+
+/*
+ * Parses timing parameters given as comma-separated key=value pairs:
+ * hit, memory, bus-width, bus-ratio, mshrs, write-buffer and window,
+ * each a number of cycles, bytes or entries. Missing keys keep their
+ * defaults.
+ *
+ * Parameters:
+ *  spec - the pairs, e.g. "memory=200,mshrs=16"
+ *  config - receives the parameters
+ *
+ * Returns:
+ *  true if successful
+ *  false if a pair is malformed or a value out of range
+ */
+bool parse_timing_config(const string & spec, TimingConfig & config) {
+    stringstream pairs(spec);
+    string pair;
+    while (getline(pairs, pair, ',')) {
+        size_t equals = pair.find('=');
+        if (equals == string::npos) {
+            return false;
+        }
+        string key = pair.substr(0, equals);
+        uint32_t * parameter;
+        if (key == "hit") {
+            parameter = &config.hit_latency;
+        } else if (key == "memory") {
+            parameter = &config.memory_latency;
+        } else if (key == "bus-width") {
+            parameter = &config.bus_width;
+        } else if (key == "bus-ratio") {
+            parameter = &config.bus_ratio;
+        } else if (key == "mshrs") {
+            parameter = &config.mshrs;
+        } else if (key == "write-buffer") {
+            parameter = &config.write_buffer;
+        } else if (key == "window") {
+            parameter = &config.window;
+        } else {
+            return false;
+        }
+        if (!parse_parameter(pair.substr(equals + 1), *parameter)) {
+            return false;
+        }
+    }
+    // a bus that moves nothing, or a core that cannot issue, never finishes
+    return config.bus_width > 0 && config.bus_ratio > 0 && config.mshrs > 0 && config.window > 0;
+}
+
+/*
+ * Constructs a TimedCache object.
+ *
+ * Parameters:
+ *  config - cache configuration
+ *  timing - timing parameters
+ *
+ * Returns:
+ *  a new TimedCache object
+ */
+TimedCache::TimedCache(const CacheConfig & config, const TimingConfig & timing)
+    : cache(config), timing(timing), mshrs(timing.mshrs), in_flight(timing.window) {
+    block_transfer = (uint64_t) (cache.block_size + timing.bus_width - 1) / timing.bus_width * timing.bus_ratio;
+}
+
+/*
+ * Simulates a batch of accesses.
+ *
+ * Parameters:
+ *  accesses - first access to simulate
+ *  n - number of accesses
+ */
+void TimedCache::replay(const Access * accesses, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        access(accesses[i]);
+    }
+}
+
+/*
+ * Simulates one access.
+ *
+ * Parameters:
+ *  access - the access
+ */
+void TimedCache::access(const Access & access) {
+    // the access needs the window slot of the access issued window accesses earlier
+    uint64_t & slot = in_flight[n_issued % timing.window];
+    if (slot > now) {
+        stats.window_stalls += slot - now;
+        now = slot;
+    }
+
+    bool is_store = access.op == ACCESS_STORE;
+    uint64_t block = access.address & ~(uint64_t) (cache.block_size - 1);
+    uint64_t issued_at = now;
+    uint64_t done = now + timing.hit_latency;
+    if (is_store) {
+        cache.total_stores++;
+    } else {
+        cache.total_loads++;
+    }
+
+    if (cache.access_block(access.address, is_store)) { // hit
+        if (is_store) {
+            cache.total_store_hits++;
+        } else {
+            cache.total_load_hits++;
+        }
+        for (size_t i = 0; i < mshrs.size(); i++) {
+            if (mshrs[i].block == block && mshrs[i].ready_at > now) { // the block is still on its way
+                stats.merged_misses++;
+                done = max(done, mshrs[i].ready_at);
+                break;
+            }
+        }
+        if (is_store && cache.is_write_through) { // store new value in memory too
+            done = max(done, write(access.size));
+        }
+    } else if (is_store && !cache.is_write_allocate) { // write around the cache
+        cache.total_store_misses++;
+        done = max(done, write(access.size));
+    } else { // retrieve block from memory
+        if (is_store) {
+            cache.total_store_misses++;
+        } else {
+            cache.total_load_misses++;
+        }
+        uint64_t ready_at = fetch(block);
+        stats.fetches++;
+        stats.miss_latency += ready_at - issued_at;
+        done = max(done, ready_at);
+
+        Eviction victim = cache.fill_block(access.address, is_store && !cache.is_write_through);
+        if (victim.is_valid && victim.is_dirty) {
+            write_back();
+        }
+        if (is_store && cache.is_write_through) {
+            done = max(done, write(access.size));
+        }
+    }
+
+    slot = done;
+    last_done = max(last_done, done);
+    n_issued++;
+    now++;
+}
+
+/*
+ * Moves data over the bus once it is free and no earlier than a cycle.
+ *
+ * Parameters:
+ *  earliest - first cycle the transfer may start
+ *  cycles - length of the transfer
+ *
+ * Returns:
+ *  cycle the transfer ends
+ */
+uint64_t TimedCache::transfer(uint64_t earliest, uint64_t cycles) {
+    bus_free = max(bus_free, earliest) + cycles;
+    stats.bus_busy += cycles;
+    return bus_free;
+}
+
+/*
+ * Fetches a block that missed, waiting for a free MSHR if necessary.
+ *
+ * Parameters:
+ *  block - address of the block's first byte
+ *
+ * Returns:
+ *  cycle the block's data arrives
+ */
+uint64_t TimedCache::fetch(uint64_t block) {
+    // the MSHR that frees up first
+    Mshr * mshr = &mshrs[0];
+    for (size_t i = 1; i < mshrs.size(); i++) {
+        if (mshrs[i].ready_at < mshr->ready_at) {
+            mshr = &mshrs[i];
+        }
+    }
+    if (mshr->ready_at > now) {
+        stats.mshr_stalls += mshr->ready_at - now;
+        now = mshr->ready_at;
+    }
+    mshr->block = block;
+    mshr->ready_at = transfer(now + timing.hit_latency + timing.memory_latency, block_transfer);
+    return mshr->ready_at;
+}
+
+/*
+ * Sends a store to memory through the write buffer.
+ *
+ * Parameters:
+ *  size - bytes written
+ *
+ * Returns:
+ *  cycle the store is done as far as the core is concerned
+ */
+uint64_t TimedCache::write(uint32_t size) {
+    if (size == 0) {
+        size = TIMING_DEFAULT_STORE_SIZE;
+    }
+    uint64_t cycles = (uint64_t) (size + timing.bus_width - 1) / timing.bus_width * timing.bus_ratio;
+    if (timing.write_buffer == 0) { // the core waits for memory
+        uint64_t written_at = transfer(now, cycles) + timing.memory_latency;
+        stats.write_buffer_stalls += written_at - now;
+        now = written_at;
+        return now;
+    }
+
+    while (!writes.empty() && writes.front() <= now) {
+        writes.pop_front();
+    }
+    if (writes.size() == timing.write_buffer) { // wait for the oldest write to drain
+        stats.write_buffer_stalls += writes.front() - now;
+        now = writes.front();
+        writes.pop_front();
+    }
+    uint64_t written_at = transfer(now, cycles) + timing.memory_latency;
+    writes.push_back(written_at);
+    last_done = max(last_done, written_at);
+    return now + timing.hit_latency;
+}
+
+/*
+ * Writes back a dirty block evicted by a fill, off the core's path.
+ */
+void TimedCache::write_back() {
+    last_done = max(last_done, transfer(now, block_transfer) + timing.memory_latency);
+}
+
+/*
+ * Returns the cycle at which every access issued so far has
+ * completed and every write has reached memory.
+ */
+uint64_t TimedCache::finish_cycle() const {
+    return max(max(now, last_done), bus_free);
+}
+
+/*
+ * Prints the cache statistics (with Total cycles from the timing
+ * model) followed by the timing statistics.
+ *
+ * Parameters:
+ *  out - stream to print to
+ */
+void TimedCache::print_counts(ostream & out) {
+    cache.total_cycles = finish_cycle();
+    cache.print_counts(out, "");
+    out << "Merged misses: " << stats.merged_misses << endl;
+    out << "Average miss latency: "
+        << (stats.fetches > 0 ? (double) stats.miss_latency / stats.fetches : 0.0) << endl;
+    out << "Window stall cycles: " << stats.window_stalls << endl;
+    out << "MSHR stall cycles: " << stats.mshr_stalls << endl;
+    out << "Write buffer stall cycles: " << stats.write_buffer_stalls << endl;
+    out << "Bus busy cycles: " << stats.bus_busy << endl;
+}
+
+/*
+ * Simulates a cache with the timing model against the trace on stdin.
+ * Usage: csim --timing SPEC n_sets n_blocks block_size allocate write [eviction]
+ *
+ * Returns:
+ *  0 if the simulation was successful
+ *  1 if the simulation was unsuccessful
+ */
+int timing_main(int argc, char * argv[]) {
+    TimingConfig timing;
+    CacheConfig config;
+    if (argc < 8 || argc > 9 || !parse_timing_config(argv[2], timing)
+        || parse_cache_config(argv + 3, argc - 3, config) != CONFIG_VALID) {
+        cerr << "Invalid arguments" << endl;
+        return 1;
+    }
+    TimedCache timed(config, timing);
+
+    bool ok = replay_trace(STDIN_FILENO, [&timed](const Access * accesses, size_t n) {
+        timed.replay(accesses, n);
+    });
+    if (!ok) {
+        return 1;
+    }
+    timed.print_counts(cout);
+    return 0;
+}
@@ -0,0 +1,184 @@
+/*
+ * Cache simulator timing model
+ * CSF Assignment 3
+ */
+
+#ifndef __CSIM_TIMING_H__
+#define __CSIM_TIMING_H__
+#include <vector>
+#include <deque>
+#include <string>
+#include <ostream>
+#include "csim_functions.h"
+
+// bytes written to memory by a store of unknown size
+#define TIMING_DEFAULT_STORE_SIZE 4
+
+// timing parameters, as given to --timing
+struct TimingConfig {
+    uint32_t hit_latency = 1;      // cycles from issue until a hit's data is ready
+    uint32_t memory_latency = 100; // cycles from a request reaching memory until its first transfer
+    uint32_t bus_width = 8;        // bytes moved per bus transfer
+    uint32_t bus_ratio = 1;        // cycles per bus transfer (bandwidth = bus_width / bus_ratio bytes per cycle)
+    uint32_t mshrs = 8;            // misses that may be outstanding at once
+    uint32_t write_buffer = 8;     // writes to memory that may be pending without stalling (0: the core stops until each reaches memory)
+    uint32_t window = 64;          // accesses that may be in flight; access i waits for access i - window
+};
+
+/*
+ * Parses timing parameters given as comma-separated key=value pairs:
+ * hit, memory, bus-width, bus-ratio, mshrs, write-buffer and window,
+ * each a number of cycles, bytes or entries. Missing keys keep their
+ * defaults.
+ *
+ * Parameters:
+ *  spec - the pairs, e.g. "memory=200,mshrs=16"
+ *  config - receives the parameters
+ *
+ * Returns:
+ *  true if successful
+ *  false if a pair is malformed or a value out of range
+ */
+bool parse_timing_config(const std::string & spec, TimingConfig & config);
+
+// statistics of the timing model
+struct TimingStats {
+    uint64_t merged_misses = 0;       // accesses to a block whose miss was still outstanding
+    uint64_t window_stalls = 0;       // cycles waiting for an access window slot
+    uint64_t mshr_stalls = 0;         // cycles waiting for a free MSHR
+    uint64_t write_buffer_stalls = 0; // cycles waiting for the write buffer (or memory, without one)
+    uint64_t bus_busy = 0;            // cycles the memory bus was transferring
+    uint64_t fetches = 0;             // blocks fetched from memory (primary misses)
+    uint64_t miss_latency = 0;        // cycles from issue to data over all fetches
+};
+
+/*
+ * A single cache with a cycle model in which misses overlap. The core
+ * issues one access per cycle and keeps going after a miss, as long as
+ * the access window has room and an MSHR (miss-status holding register)
+ * is free to track it. Misses pay the memory latency, then move the
+ * block over a bus of limited bandwidth that dirty writebacks and
+ * write-through stores also use; the bus serves transfers in the order
+ * they are requested. Stores to memory go through a write buffer, so
+ * the core only waits for them when it is full.
+ *
+ * Hits, misses and evictions are those of CacheSimulator; only the
+ * cycles differ, so Total cycles replaces the serial estimate.
+ */
+class TimedCache {
+public:
+    CacheSimulator cache;
+    TimingConfig timing;
+    TimingStats stats;
+
+    /*
+     * Constructs a TimedCache object.
+     *
+     * Parameters:
+     *  config - cache configuration
+     *  timing - timing parameters
+     *
+     * Returns:
+     *  a new TimedCache object
+     */
+    TimedCache(const CacheConfig & config, const TimingConfig & timing);
+
+    /*
+     * Simulates a batch of accesses.
+     *
+     * Parameters:
+     *  accesses - first access to simulate
+     *  n - number of accesses
+     */
+    void replay(const Access * accesses, size_t n);
+
+    /*
+     * Returns the cycle at which every access issued so far has
+     * completed and every write has reached memory.
+     */
+    uint64_t finish_cycle() const;
+
+    /*
+     * Prints the cache statistics (with Total cycles from the timing
+     * model) followed by the timing statistics.
+     *
+     * Parameters:
+     *  out - stream to print to
+     */
+    void print_counts(std::ostream & out);
+
+private:
+    // an outstanding miss
+    struct Mshr {
+        uint64_t block = 0;
+        uint64_t ready_at = 0; // cycle the block's data arrives (free once passed)
+    };
+
+    uint64_t now = 0;          // cycle the next access issues
+    uint64_t bus_free = 0;     // cycle the bus finishes its last transfer
+    uint64_t last_done = 0;    // latest completion of anything so far
+    uint64_t n_issued = 0;     // accesses issued so far
+    uint64_t block_transfer;   // cycles to move a block over the bus
+    std::vector<Mshr> mshrs;
+    std::vector<uint64_t> in_flight; // completion cycle of the last window accesses, by issue number
+    std::deque<uint64_t> writes;     // cycle each buffered write reaches memory, oldest first
+
+    /*
+     * Simulates one access.
+     *
+     * Parameters:
+     *  access - the access
+     */
+    void access(const Access & access);
+
+    /*
+     * Moves data over the bus once it is free and no earlier than a cycle.
+     *
+     * Parameters:
+     *  earliest - first cycle the transfer may start
+     *  cycles - length of the transfer
+     *
+     * Returns:
+     *  cycle the transfer ends
+     */
+    uint64_t transfer(uint64_t earliest, uint64_t cycles);
+
+    /*
+     * Fetches a block that missed, waiting for a free MSHR if necessary.
+     *
+     * Parameters:
+     *  block - address of the block's first byte
+     *
+     * Returns:
+     *  cycle the block's data arrives
+     */
+    uint64_t fetch(uint64_t block);
+
+    /*
+     * Sends a store to memory through the write buffer.
+     *
+     * Parameters:
+     *  size - bytes written
+     *
+     * Returns:
+     *  cycle the store is done as far as the core is concerned
+     */
+    uint64_t write(uint32_t size);
+
+    /*
+     * Writes back a dirty block evicted by a fill, off the core's path.
+     */
+    void write_back();
+};
+
+/*
+ * Simulates a cache with the timing model against the trace on stdin.
+ * Usage: csim --timing SPEC n_sets n_blocks block_size allocate write [eviction]
+ *
+ * Returns:
+ *  0 if the simulation was successful
+ *  1 if the simulation was unsuccessful
+ */
+int timing_main(int argc, char * argv[]);
+
+#endif
@@ -0,0 +1,893 @@
+/*
+ * Cache simulator trace input
+ * CSF Assignment 3
+ */
+
+#include <iostream>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <memory>
+#include <algorithm>
+#include <thread>
+#include "csim_trace.h"
+#include "csim_compress.h"
+
+using std::cerr;
+using std::endl;
+using namespace std;
+
+/*
+ * Constructs a TraceQueue object.
+ *
+ * Parameters:
+ *  chunk_size - number of accesses per chunk
+ *  max_chunks - maximum number of filled chunks waiting to be simulated
+ *
+ * Returns:
+ *  a new TraceQueue object
+ */
+TraceQueue::TraceQueue(size_t chunk_size, size_t max_chunks) {
+    this->chunk_size = chunk_size;
+    this->max_chunks = max_chunks;
+}
+
+/*
+ * Hands a filled chunk to the consumer, blocking while the queue is full.
+ * chunk is replaced with an empty (recycled) chunk to be filled next.
+ *
+ * Parameters:
+ *  chunk - chunk to enqueue
+ */
+void TraceQueue::push(TraceChunk & chunk) {
+    unique_lock<mutex> guard(lock);
+    not_full.wait(guard, [this] { return filled.size() < max_chunks; });
+    filled.push_back(std::move(chunk));
+
+    // hand back a recycled chunk so the producer does not reallocate
+    if (!spare.empty()) {
+        chunk = std::move(spare.back());
+        spare.pop_back();
+    } else {
+        chunk = TraceChunk();
+    }
+    guard.unlock();
+    not_empty.notify_one();
+
+    chunk.clear();
+    chunk.reserve(chunk_size);
+}
+
+/*
+ * Marks the end of the trace. No more chunks may be pushed.
+ *
+ * Parameters:
+ *  failed - true if the trace could not be read completely
+ */
+void TraceQueue::close(bool failed) {
+    {
+        lock_guard<mutex> guard(lock);
+        is_closed = true;
+        is_failed = failed;
+    }
+    not_empty.notify_all();
+}
+
+/*
+ * Takes the next filled chunk, blocking while the queue is empty.
+ * The chunk previously held in chunk is recycled.
+ *
+ * Parameters:
+ *  chunk - receives the next chunk
+ *
+ * Returns:
+ *  true if a chunk was taken
+ *  false if the trace has ended
+ */
+bool TraceQueue::pop(TraceChunk & chunk) {
+    unique_lock<mutex> guard(lock);
+    if (chunk.capacity() > 0) { // recycle the chunk the consumer is done with
+        spare.push_back(std::move(chunk));
+        chunk = TraceChunk();
+    }
+
+    not_empty.wait(guard, [this] { return !filled.empty() || is_closed; });
+    if (filled.empty()) { // closed and drained
+        return false;
+    }
+    chunk = std::move(filled.front());
+    filled.pop_front();
+    guard.unlock();
+    not_full.notify_one();
+    return true;
+}
+
+/*
+ * Returns true if the producer closed the queue because of an error.
+ */
+bool TraceQueue::failed() {
+    lock_guard<mutex> guard(lock);
+    return is_failed;
+}
+
+/*
+ * Maps the file open on fd, if it is a regular file.
+ *
+ * Parameters:
+ *  fd - open file descriptor
+ *
+ * Returns:
+ *  a new MappedFile object
+ */
+MappedFile::MappedFile(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return;
+    }
+    mapped = true;
+    if (st.st_size == 0) { // mmap rejects empty mappings
+        return;
+    }
+
+    void * addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+        mapped = false;
+        return;
+    }
+    madvise(addr, st.st_size, MADV_SEQUENTIAL);
+    data = (const char *) addr;
+    length = st.st_size;
+}
+
+/*
+ * Unmaps the file.
+ */
+MappedFile::~MappedFile() {
+    if (length > 0) {
+        munmap((void *) data, length);
+    }
+}
+
+// value of each hex digit character, -1 for anything else
+struct HexTable {
+    int8_t value[256];
+
+    HexTable() {
+        memset(value, -1, sizeof(value));
+        for (int i = 0; i < 10; i++) {
+            value['0' + i] = i;
+        }
+        for (int i = 0; i < 6; i++) {
+            value['a' + i] = 10 + i;
+            value['A' + i] = 10 + i;
+        }
+    }
+};
+static const HexTable hex_digits;
+
+// bytes buffered by BinaryTraceWriter between writes
+#define TRACE_WRITE_SIZE (1 << 20)
+
+/*
+ * Constructs a TraceDecoder object.
+ *
+ * Parameters:
+ *  queue - queue to feed decoded accesses into
+ *
+ * Returns:
+ *  a new TraceDecoder object
+ */
+TraceDecoder::TraceDecoder(TraceQueue & queue) : queue(queue) {
+    chunk_size = queue.get_chunk_size();
+    chunk.reserve(chunk_size);
+}
+
+/*
+ * Pushes any partially filled chunk to the queue.
+ */
+void TraceDecoder::flush() {
+    if (!chunk.empty()) {
+        queue.push(chunk);
+    }
+}
+
+/*
+ * Decodes every complete line in a buffer. Reports the first malformed
+ * line (with its line number) to cerr.
+ *
+ * Parameters:
+ *  p - first byte to decode
+ *  end - one past the last byte to decode
+ *  is_final - true if no more input follows, so a last line without
+ *             a trailing newline is complete
+ *
+ * Returns:
+ *  the start of the first line not yet decoded (end once everything was decoded)
+ *  nullptr if a line was malformed
+ */
+const char * TextTraceParser::parse(const char * p, const char * end, bool is_final) {
+    const int8_t * hex = hex_digits.value;
+
+    while (p < end) {
+        const char * eol = (const char *) memchr(p, '\n', end - p);
+        if (eol == nullptr) {
+            if (!is_final) { // wait for the rest of the line
+                return p;
+            }
+            eol = end;
+        }
+        line_no++;
+
+        // fields: s, l or i, memory address (0xhexadecimal), access size, core
+        const char * c = p;
+        while (c < eol && (*c == ' ' || *c == '\t')) c++;
+        if (c == eol || (c + 1 == eol && *c == '\r')) { // blank line
+            p = eol + 1;
+            continue;
+        }
+
+        bool ok = (*c == 's' || *c == 'l' || *c == 'i') && c + 1 < eol && (c[1] == ' ' || c[1] == '\t');
+        uint8_t op = *c == 's' ? ACCESS_STORE : (*c == 'i' ? ACCESS_IFETCH : ACCESS_LOAD);
+        uint64_t address = 0;
+        if (ok) {
+            c++;
+            while (c < eol && (*c == ' ' || *c == '\t')) c++;
+            ok = eol - c > 2 && c[0] == '0' && (c[1] == 'x' || c[1] == 'X') && hex[(uint8_t) c[2]] >= 0;
+            c += 2;
+        }
+        if (ok) {
+            const char * digits = c;
+            int8_t d;
+            while (c < eol && (d = hex[(uint8_t) *c]) >= 0) {
+                address = (address << 4) | d;
+                c++;
+            }
+            ok = c - digits <= 16;
+        }
+        uint32_t size = 0;
+        uint32_t core = 0;
+        if (ok) { // optional access size and core, then end of line
+            while (c < eol && (*c == ' ' || *c == '\t')) c++;
+            while (c < eol && *c >= '0' && *c <= '9' && size <= 0xffff) {
+                size = size * 10 + (*c - '0');
+                c++;
+            }
+            while (c < eol && (*c == ' ' || *c == '\t')) c++;
+            while (c < eol && *c >= '0' && *c <= '9' && core <= 0xff) {
+                core = core * 10 + (*c - '0');
+                c++;
+            }
+            while (c < eol && (*c == ' ' || *c == '\t' || *c == '\r')) c++;
+            ok = c == eol && size <= 0xffff && core <= 0xff;
+        }
+        if (!ok) {
+            cerr << "Invalid trace line " << line_no << endl;
+            return nullptr;
+        }
+
+        Access access;
+        access.address = address;
+        access.size = (uint16_t) size;
+        access.op = op;
+        access.core = (uint8_t) core;
+        emit(access);
+        p = eol + 1;
+    }
+    return end;
+}
+
+/*
+ * Returns the binary trace header at the start of a buffer.
+ *
+ * Parameters:
+ *  begin - first byte of the trace
+ *  end - one past the last byte of the trace
+ *
+ * Returns:
+ *  the header if the buffer starts with a binary trace header
+ *  nullptr if it does not (e.g. a text trace)
+ */
+const BinaryTraceHeader * binary_trace_header(const char * begin, const char * end) {
+    if (end - begin < (ptrdiff_t) sizeof(BinaryTraceHeader) || memcmp(begin, TRACE_MAGIC, 8) != 0) {
+        return nullptr;
+    }
+    return (const BinaryTraceHeader *) begin;
+}
+
+/*
+ * Checks that a binary trace header describes a trace this build can replay.
+ * Reports the problem to cerr if not.
+ *
+ * Parameters:
+ *  header - header to check
+ *
+ * Returns:
+ *  true if the trace is supported
+ */
+static bool is_supported(const BinaryTraceHeader * header) {
+    if (header->version != TRACE_VERSION
+        || (header->address_bits != 32 && header->address_bits != 64)
+        || (header->encoding != TRACE_ENCODING_FIXED && header->encoding != TRACE_ENCODING_VARINT)) {
+        cerr << "Unsupported binary trace" << endl;
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Returns the records of a memory-mapped fixed-width binary trace. Records
+ * with 64-bit addresses are Access objects and can be replayed in place;
+ * 32-bit ones are NarrowAccess objects. Big-endian hosts get none, as
+ * the records must be byte-swapped by the decoder.
+ *
+ * Parameters:
+ *  file - mapped trace file
+ *  n - receives the number of records
+ *  address_bits - receives the width of the trace's addresses
+ *
+ * Returns:
+ *  the first record if file is a supported fixed-width binary trace
+ *  nullptr otherwise (text, varint-encoded, unmapped or malformed input,
+ *  or a big-endian host)
+ */
+const char * fixed_trace_records(const MappedFile & file, size_t & n, int & address_bits) {
+    const BinaryTraceHeader * header = binary_trace_header(file.begin(), file.end());
+    if (!TRACE_HOST_IS_LITTLE_ENDIAN || !file.is_mapped() || header == nullptr || header->version != TRACE_VERSION
+        || (header->address_bits != 32 && header->address_bits != 64) || header->encoding != TRACE_ENCODING_FIXED) {
+        return nullptr;
+    }
+    address_bits = header->address_bits;
+    size_t record_size = address_bits == 64 ? sizeof(Access) : sizeof(NarrowAccess);
+    size_t bytes = file.end() - file.begin() - sizeof(BinaryTraceHeader);
+    if (bytes % record_size != 0) { // let read_trace() report the truncation
+        return nullptr;
+    }
+    n = bytes / record_size;
+    return file.begin() + sizeof(BinaryTraceHeader);
+}
+
+/*
+ * Converts the fields of a fixed-width record between the host's byte
+ * order and the little-endian order of trace files (no-op on
+ * little-endian hosts).
+ *
+ * Parameters:
+ *  record - the record
+ */
+static void swap_record(Access & record) {
+    if (!TRACE_HOST_IS_LITTLE_ENDIAN) {
+        record.address = __builtin_bswap64(record.address);
+        record.size = __builtin_bswap16(record.size);
+    }
+}
+
+/*
+ * Converts the fields of a 32-bit fixed-width record, as above.
+ */
+static void swap_record(NarrowAccess & record) {
+    if (!TRACE_HOST_IS_LITTLE_ENDIAN) {
+        record.address = __builtin_bswap32(record.address);
+        record.size = __builtin_bswap16(record.size);
+    }
+}
+
+/*
+ * Constructs a BinaryTraceDecoder object.
+ *
+ * Parameters:
+ *  queue - queue to feed decoded accesses into
+ *  encoding - TRACE_ENCODING_FIXED or TRACE_ENCODING_VARINT
+ *  address_bits - width of the trace's addresses (32 or 64)
+ *
+ * Returns:
+ *  a new BinaryTraceDecoder object
+ */
+BinaryTraceDecoder::BinaryTraceDecoder(TraceQueue & queue, int encoding, int address_bits) : TraceDecoder(queue) {
+    this->encoding = encoding;
+    address_mask = address_bits == 64 ? UINT64_MAX : UINT32_MAX;
+    record_size = address_bits == 64 ? sizeof(Access) : sizeof(NarrowAccess);
+}
+
+/*
+ * Decodes a LEB128 value whose first byte also carries n_flags low flag bits.
+ *
+ * Parameters:
+ *  p - first byte of the value; advanced past it
+ *  end - one past the last readable byte
+ *  n_flags - number of flag bits in the first byte
+ *  flags - receives the flag bits
+ *  value - receives the value
+ *
+ * Returns:
+ *  true if a whole value was decoded
+ *  false if the buffer ended first or the value is too long
+ */
+static bool decode_varint(const char * & p, const char * end, int n_flags, uint32_t & flags, uint64_t & value) {
+    if (p == end) {
+        return false;
+    }
+    uint8_t b = *p++;
+    flags = b & ((1 << n_flags) - 1);
+    value = (b & 0x7f) >> n_flags;
+    int shift = 7 - n_flags;
+    while (b & 0x80) {
+        if (p == end || shift > 63) {
+            return false;
+        }
+        b = *p++;
+        value |= (uint64_t) (b & 0x7f) << shift;
+        shift += 7;
+    }
+    return true;
+}
+
+/*
+ * Encodes a LEB128 value whose first byte also carries n_flags low flag bits.
+ *
+ * Parameters:
+ *  out - buffer to append to
+ *  n_flags - number of flag bits in the first byte
+ *  flags - flag bits
+ *  value - value to encode
+ */
+static void encode_varint(std::vector<char> & out, int n_flags, uint32_t flags, uint64_t value) {
+    int first_bits = 7 - n_flags;
+    uint8_t b = flags | (uint8_t) ((value & ((1 << first_bits) - 1)) << n_flags);
+    value >>= first_bits;
+    while (value != 0) {
+        out.push_back((char) (b | 0x80));
+        b = value & 0x7f;
+        value >>= 7;
+    }
+    out.push_back((char) b);
+}
+
+/*
+ * Decodes every complete record in a buffer.
+ */
+const char * BinaryTraceDecoder::parse(const char * p, const char * end, bool is_final) {
+    if (encoding == TRACE_ENCODING_FIXED) {
+        size_t n = (end - p) / record_size;
+        for (size_t i = 0; i < n; i++) {
+            Access access;
+            if (record_size == sizeof(Access)) {
+                memcpy(&access, p + i * record_size, sizeof(Access));
+                swap_record(access);
+            } else { // widen a 32-bit record
+                NarrowAccess record;
+                memcpy(&record, p + i * record_size, sizeof(NarrowAccess));
+                swap_record(record);
+                access.address = record.address;
+                access.size = record.size;
+                access.op = record.op;
+                access.core = record.core;
+            }
+            if (access.op > ACCESS_IFETCH) {
+                cerr << "Invalid binary trace record" << endl;
+                return nullptr;
+            }
+            emit(access);
+        }
+        p += n * record_size;
+    } else {
+        while (p < end) {
+            const char * record = p;
+            uint32_t flags;
+            uint64_t delta;
+            uint64_t size = prev_size;
+            uint64_t core = prev_core;
+            uint32_t ignored;
+            if (!decode_varint(p, end, TRACE_TOKEN_FLAGS, flags, delta)
+                || ((flags & TRACE_TOKEN_SIZE) && !decode_varint(p, end, 0, ignored, size))
+                || ((flags & TRACE_TOKEN_CORE) && !decode_varint(p, end, 0, ignored, core))) {
+                p = record; // truncated record
+                break;
+            }
+            if ((flags & TRACE_TOKEN_OP) > ACCESS_IFETCH || size > 0xffff || core > 0xff) {
+                cerr << "Invalid binary trace record" << endl;
+                return nullptr;
+            }
+            // undo zigzag encoding
+            prev_address = (prev_address + ((delta >> 1) ^ (~(delta & 1) + 1))) & address_mask;
+            prev_size = (uint16_t) size;
+            prev_core = (uint8_t) core;
+
+            Access access;
+            access.address = prev_address;
+            access.size = prev_size;
+            access.op = flags & TRACE_TOKEN_OP;
+            access.core = prev_core;
+            emit(access);
+        }
+    }
+
+    if (is_final && p != end) {
+        cerr << "Truncated binary trace" << endl;
+        return nullptr;
+    }
+    return p;
+}
+
+/*
+ * Constructs a BinaryTraceWriter object and writes the trace header.
+ *
+ * Parameters:
+ *  fd - file descriptor to write to
+ *  encoding - TRACE_ENCODING_FIXED or TRACE_ENCODING_VARINT
+ *  address_bits - width of the trace's addresses (32 or 64)
+ *
+ * Returns:
+ *  a new BinaryTraceWriter object
+ */
+BinaryTraceWriter::BinaryTraceWriter(int fd, int encoding, int address_bits) {
+    this->fd = fd;
+    this->encoding = encoding;
+    this->address_bits = address_bits;
+    buffer.reserve(TRACE_WRITE_SIZE + 64);
+
+    BinaryTraceHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, 8);
+    header.version = TRACE_VERSION;
+    header.address_bits = address_bits;
+    header.encoding = encoding;
+    buffer.insert(buffer.end(), (const char *) &header, (const char *) (&header + 1));
+}
+
+/*
+ * Encodes a batch of accesses.
+ *
+ * Parameters:
+ *  accesses - first access to write
+ *  n - number of accesses
+ *
+ * Returns:
+ *  true if successful
+ *  false if writing failed or an address is wider than the trace's
+ *  addresses (reported to cerr)
+ */
+bool BinaryTraceWriter::write(const Access * accesses, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        const Access & access = accesses[i];
+        if (address_bits == 32 && access.address > UINT32_MAX) {
+            cerr << "Address does not fit in 32 bits" << endl;
+            return false;
+        }
+        if (encoding == TRACE_ENCODING_FIXED && address_bits == 32) {
+            NarrowAccess record;
+            record.address = (uint32_t) access.address;
+            record.size = access.size;
+            record.op = access.op;
+            record.core = access.core;
+            swap_record(record);
+            buffer.insert(buffer.end(), (const char *) &record, (const char *) (&record + 1));
+        } else if (encoding == TRACE_ENCODING_FIXED) {
+            Access record;
+            memset(&record, 0, sizeof(record)); // no stray bytes in the padding
+            record.address = access.address;
+            record.size = access.size;
+            record.op = access.op;
+            record.core = access.core;
+            swap_record(record);
+            buffer.insert(buffer.end(), (const char *) &record, (const char *) (&record + 1));
+        } else {
+            // zigzag-encode the signed distance from the previous address,
+            // which wraps around at 64 bits (32-bit addresses never do)
+            int64_t delta = (int64_t) (access.address - prev_address);
+            uint64_t zigzag = ((uint64_t) delta << 1) ^ (uint64_t) (delta >> 63);
+            bool size_changed = access.size != prev_size;
+            bool core_changed = access.core != prev_core;
+            uint32_t flags = (core_changed ? TRACE_TOKEN_CORE : 0) | (size_changed ? TRACE_TOKEN_SIZE : 0)
+                | (access.op & TRACE_TOKEN_OP);
+            encode_varint(buffer, TRACE_TOKEN_FLAGS, flags, zigzag);
+            if (size_changed) {
+                encode_varint(buffer, 0, 0, access.size);
+            }
+            if (core_changed) {
+                encode_varint(buffer, 0, 0, access.core);
+            }
+            prev_address = access.address;
+            prev_size = access.size;
+            prev_core = access.core;
+        }
+
+        if (buffer.size() >= TRACE_WRITE_SIZE && !finish()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Writes out any buffered bytes.
+ *
+ * Returns:
+ *  true if successful
+ *  false if writing failed
+ */
+bool BinaryTraceWriter::finish() {
+    size_t done = 0;
+    while (done < buffer.size()) {
+        ssize_t n = ::write(fd, buffer.data() + done, buffer.size() - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        done += n;
+    }
+    buffer.clear();
+    return true;
+}
+
+// bytes read at a time from inputs that cannot be memory-mapped
+#define TRACE_READ_SIZE (1 << 20)
+
+// accesses per streamed trace chunk and number of chunks buffered ahead of the consumer
+#define TRACE_CHUNK_SIZE 4096
+#define TRACE_QUEUE_CHUNKS 16
+
+/*
+ * Decodes a trace read in blocks from a source of bytes, carrying an
+ * incomplete last record over to the next block. Closes the queue when
+ * the trace ends.
+ *
+ * Parameters:
+ *  read_some - reads the next bytes into a buffer, as read(2) (0 at the
+ *              end, -1 on an error it has reported)
+ *  queue - queue to feed decoded accesses into
+ */
+static void decode_blocks(const std::function<ssize_t (char *, size_t)> & read_some, TraceQueue & queue) {
+    std::vector<char> buffer(TRACE_READ_SIZE);
+    std::unique_ptr<TraceDecoder> decoder;
+    size_t carry = 0;
+    while (true) {
+        if (carry == buffer.size()) { // a single line longer than the buffer
+            buffer.resize(buffer.size() * 2);
+        }
+        ssize_t n = read_some(buffer.data() + carry, buffer.size() - carry);
+        if (n < 0) {
+            queue.close(true);
+            return;
+        }
+
+        const char * begin = buffer.data();
+        const char * end = begin + carry + n;
+        if (!decoder) { // pick a decoder once the header could have arrived
+            if (n > 0 && end - begin < (ptrdiff_t) sizeof(BinaryTraceHeader)) {
+                carry += n;
+                continue;
+            }
+            const BinaryTraceHeader * header = binary_trace_header(begin, end);
+            if (header != nullptr) {
+                if (!is_supported(header)) {
+                    queue.close(true);
+                    return;
+                }
+                decoder.reset(new BinaryTraceDecoder(queue, header->encoding, header->address_bits));
+                begin += sizeof(BinaryTraceHeader);
+            } else {
+                decoder.reset(new TextTraceParser(queue));
+            }
+        }
+
+        const char * rest = decoder->parse(begin, end, n == 0);
+        if (rest == nullptr) {
+            queue.close(true);
+            return;
+        }
+        if (n == 0) {
+            break;
+        }
+        carry = end - rest;
+        memmove(buffer.data(), rest, carry);
+    }
+    decoder->flush();
+    queue.close(false);
+}
+
+/*
+ * Reads a text or binary memory trace, possibly compressed, and feeds it
+ * through a TraceQueue. Regular files are memory-mapped and decoded in
+ * place; other inputs are read in large blocks. Compressed traces are
+ * decompressed on threads of their own (see InflatedTrace) and decoded
+ * as they are inflated. Closes the queue when the trace ends.
+ *
+ * Parameters:
+ *  fd - file descriptor to read the trace from
+ *  queue - queue to feed decoded accesses into
+ */
+void read_trace(int fd, TraceQueue & queue) {
+    MappedFile file(fd);
+    if (file.is_mapped()) {
+        const char * begin = file.begin();
+        int compression = trace_compression(begin, file.end());
+        if (compression != COMPRESSION_NONE) {
+            InflatedTrace input(compression, begin, file.end() - begin, -1);
+            decode_blocks([&input](char * buffer, size_t size) { return input.read(buffer, size); }, queue);
+            return;
+        }
+
+        const BinaryTraceHeader * header = binary_trace_header(begin, file.end());
+        if (header != nullptr && !is_supported(header)) {
+            queue.close(true);
+            return;
+        }
+
+        TextTraceParser text(queue);
+        BinaryTraceDecoder binary(queue, header != nullptr ? header->encoding : 0,
+                                  header != nullptr ? header->address_bits : 64);
+        TraceDecoder & decoder = header != nullptr ? (TraceDecoder &) binary : (TraceDecoder &) text;
+        if (header != nullptr) {
+            begin += sizeof(BinaryTraceHeader);
+        }
+        if (decoder.parse(begin, file.end(), true) == nullptr) {
+            queue.close(true);
+            return;
+        }
+        decoder.flush();
+        queue.close(false);
+        return;
+    }
+
+    // not a regular file: read enough to recognize compression, then read blocks
+    auto read_fd = [fd](char * buffer, size_t size) -> ssize_t {
+        while (true) {
+            ssize_t n = read(fd, buffer, size);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0) {
+                cerr << "Could not read trace" << endl;
+            }
+            return n;
+        }
+    };
+    char prefix[COMPRESSION_SNIFF_SIZE];
+    size_t n_prefix = 0;
+    while (n_prefix < sizeof(prefix)) {
+        ssize_t n = read_fd(prefix + n_prefix, sizeof(prefix) - n_prefix);
+        if (n < 0) {
+            queue.close(true);
+            return;
+        }
+        if (n == 0) {
+            break;
+        }
+        n_prefix += n;
+    }
+
+    int compression = trace_compression(prefix, prefix + n_prefix);
+    if (compression != COMPRESSION_NONE) {
+        InflatedTrace input(compression, prefix, n_prefix, fd);
+        decode_blocks([&input](char * buffer, size_t size) { return input.read(buffer, size); }, queue);
+        return;
+    }
+    size_t prefix_left = n_prefix;
+    decode_blocks([&](char * buffer, size_t size) -> ssize_t {
+        if (prefix_left > 0) { // hand over the bytes already read first
+            size_t n = std::min(size, prefix_left);
+            memcpy(buffer, prefix + n_prefix - prefix_left, n);
+            prefix_left -= n;
+            return n;
+        }
+        return read_fd(buffer, size);
+    }, queue);
+}
+
+/*
+ * Checks the kind of every access in a batch of fixed-width records,
+ * which are replayed without being decoded. Reports a bad one to cerr.
+ *
+ * Parameters:
+ *  accesses - first access to check
+ *  n - number of accesses
+ *
+ * Returns:
+ *  true if every access is a load, store or instruction fetch
+ */
+static bool has_valid_ops(const Access * accesses, size_t n) {
+    uint8_t bad = 0;
+    for (size_t i = 0; i < n; i++) { // no early exit, so the loop vectorizes
+        bad |= accesses[i].op > ACCESS_IFETCH;
+    }
+    if (bad) {
+        cerr << "Invalid binary trace record" << endl;
+    }
+    return !bad;
+}
+
+/*
+ * Replays a trace in batches. A memory-mapped fixed-width binary trace is
+ * handed over in place (or widened in batches if its addresses are 32-bit);
+ * anything else is decoded by a reader thread and streamed through a
+ * bounded TraceQueue.
+ *
+ * Parameters:
+ *  fd - file descriptor to read the trace from
+ *  consume - called with each batch of accesses, in trace order
+ *
+ * Returns:
+ *  true if the whole trace was replayed
+ *  false if the trace could not be read
+ */
+bool replay_trace(int fd, const std::function<void (const Access *, size_t)> & consume) {
+    MappedFile input(fd);
+    size_t n_records;
+    int address_bits;
+    const char * records = fixed_trace_records(input, n_records, address_bits);
+    if (records != nullptr && address_bits == 64) {
+        // batches of TRACE_CHUNK_SIZE keep each batch cache-resident for consumers
+        // that replay it more than once
+        const Access * accesses = (const Access *) records;
+        for (size_t i = 0; i < n_records; i += TRACE_CHUNK_SIZE) {
+            size_t n = std::min((size_t) TRACE_CHUNK_SIZE, n_records - i);
+            if (!has_valid_ops(accesses + i, n)) {
+                return false;
+            }
+            consume(accesses + i, n);
+        }
+        return true;
+    }
+    if (records != nullptr) { // 32-bit records: widen a batch at a time, no reader thread needed
+        TraceChunk chunk(TRACE_CHUNK_SIZE);
+        for (size_t i = 0; i < n_records; i += TRACE_CHUNK_SIZE) {
+            size_t n = std::min((size_t) TRACE_CHUNK_SIZE, n_records - i);
+            for (size_t j = 0; j < n; j++) {
+                NarrowAccess record;
+                memcpy(&record, records + (i + j) * sizeof(NarrowAccess), sizeof(NarrowAccess));
+                chunk[j].address = record.address;
+                chunk[j].size = record.size;
+                chunk[j].op = record.op;
+                chunk[j].core = record.core;
+            }
+            if (!has_valid_ops(chunk.data(), n)) {
+                return false;
+            }
+            consume(chunk.data(), n);
+        }
+        return true;
+    }
+
+    TraceQueue queue(TRACE_CHUNK_SIZE, TRACE_QUEUE_CHUNKS);
+    std::thread reader(read_trace, fd, std::ref(queue));
+    TraceChunk chunk;
+    while (queue.pop(chunk)) {
+        consume(chunk.data(), chunk.size());
+    }
+    reader.join();
+    return !queue.failed();
+}
+
+/*
+ * Converts a trace (text or binary) to a binary trace.
+ *
+ * Parameters:
+ *  in_fd - file descriptor to read the trace from
+ *  out_fd - file descriptor to write the binary trace to
+ *  encoding - TRACE_ENCODING_FIXED or TRACE_ENCODING_VARINT
+ *  address_bits - width of the binary trace's addresses (32 or 64)
+ *
+ * Returns:
+ *  true if successful
+ *  false if the trace could not be read or written
+ */
+bool convert_trace(int in_fd, int out_fd, int encoding, int address_bits) {
+    BinaryTraceWriter writer(out_fd, encoding, address_bits);
+    bool write_ok = true;
+    bool read_ok = replay_trace(in_fd, [&](const Access * accesses, size_t n) {
+        if (write_ok && !writer.write(accesses, n)) {
+            cerr << "Could not write binary trace" << endl;
+            write_ok = false; // keep draining so the reader can finish
+        }
+    });
+
+    if (write_ok && !writer.finish()) {
+        cerr << "Could not write binary trace" << endl;
+        write_ok = false;
+    }
+    return read_ok && write_ok;
+}
@@ -0,0 +1,432 @@
+/*
+ * Cache simulator trace input
+ * CSF Assignment 3
+ */
+
+#ifndef __CSIM_TRACE_H__
+#define __CSIM_TRACE_H__
+#include <vector>
+#include <deque>
+#include <utility>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+#include <stdint.h>
+
+// kinds of memory access in a trace
+enum AccessOp {
+    ACCESS_LOAD = 0,
+    ACCESS_STORE = 1,
+    ACCESS_IFETCH = 2 // instruction fetch; a single cache treats it as a load
+};
+
+/*
+ * One memory access. The layout doubles as the fixed-width record of
+ * binary traces with 64-bit addresses, so they can be replayed straight
+ * from a mapping.
+ */
+struct Access {
+    uint64_t address;
+    uint16_t size; // bytes accessed (0 if the trace did not say)
+    uint8_t op;    // AccessOp
+    uint8_t core;  // core or thread that made the access (0 if the trace did not say)
+};
+
+// fixed-width record of binary traces with 32-bit addresses
+struct NarrowAccess {
+    uint32_t address;
+    uint16_t size;
+    uint8_t op;
+    uint8_t core;
+};
+
+// the record layouts are the file format
+static_assert(sizeof(Access) == 16, "Access must match the 64-bit fixed-width trace record");
+static_assert(sizeof(NarrowAccess) == 8, "NarrowAccess must match the 32-bit fixed-width trace record");
+
+// fixed-width records are little-endian; a big-endian host swaps them as it reads and writes them
+#define TRACE_HOST_IS_LITTLE_ENDIAN (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+
+// a batch of accesses
+typedef std::vector<Access> TraceChunk;
+
+/*
+ * Binary trace file header, followed by records in the given encoding:
+ *  TRACE_ENCODING_FIXED - one Access (NarrowAccess for 32-bit addresses)
+ *      per record, little-endian
+ *  TRACE_ENCODING_VARINT - per record, a LEB128 token holding
+ *      (zigzag(address delta) << 4) | (core changed << 3) | (size changed << 2) | op,
+ *      then the new size and the new core as LEB128 if they changed
+ */
+struct BinaryTraceHeader {
+    char magic[8];        // TRACE_MAGIC
+    uint8_t version;      // TRACE_VERSION
+    uint8_t address_bits; // 32 or 64 (addresses wrap around at this width)
+    uint8_t encoding;     // TRACE_ENCODING_FIXED or TRACE_ENCODING_VARINT
+    uint8_t reserved[5];
+};
+
+#define TRACE_MAGIC "CSIMTRC\x1a"
+#define TRACE_VERSION 1
+#define TRACE_ENCODING_FIXED 0
+#define TRACE_ENCODING_VARINT 1
+
+// low bits of a varint token
+#define TRACE_TOKEN_FLAGS 4  // number of flag bits
+#define TRACE_TOKEN_OP 0x3   // the op
+#define TRACE_TOKEN_SIZE 0x4 // set if the size changed
+#define TRACE_TOKEN_CORE 0x8 // set if the core changed
+
+/*
+ * Returns the binary trace header at the start of a buffer.
+ *
+ * Parameters:
+ *  begin - first byte of the trace
+ *  end - one past the last byte of the trace
+ *
+ * Returns:
+ *  the header if the buffer starts with a binary trace header
+ *  nullptr if it does not (e.g. a text trace)
+ */
+const BinaryTraceHeader * binary_trace_header(const char * begin, const char * end);
+
+/*
+ * Bounded queue of trace chunks handed from a trace reader thread
+ * to the simulation loop. At most max_chunks filled chunks are queued
+ * at once, so memory use stays constant no matter how long the trace is.
+ * Consumed chunks are recycled back to the producer to avoid reallocating.
+ */
+class TraceQueue {
+public:
+    /*
+     * Constructs a TraceQueue object.
+     *
+     * Parameters:
+     *  chunk_size - number of accesses per chunk
+     *  max_chunks - maximum number of filled chunks waiting to be simulated
+     *
+     * Returns:
+     *  a new TraceQueue object
+     */
+    TraceQueue(size_t chunk_size, size_t max_chunks);
+
+    /*
+     * Hands a filled chunk to the consumer, blocking while the queue is full.
+     * chunk is replaced with an empty (recycled) chunk to be filled next.
+     *
+     * Parameters:
+     *  chunk - chunk to enqueue
+     */
+    void push(TraceChunk & chunk);
+
+    /*
+     * Marks the end of the trace. No more chunks may be pushed.
+     *
+     * Parameters:
+     *  failed - true if the trace could not be read completely
+     */
+    void close(bool failed);
+
+    /*
+     * Takes the next filled chunk, blocking while the queue is empty.
+     * The chunk previously held in chunk is recycled.
+     *
+     * Parameters:
+     *  chunk - receives the next chunk
+     *
+     * Returns:
+     *  true if a chunk was taken
+     *  false if the trace has ended
+     */
+    bool pop(TraceChunk & chunk);
+
+    /*
+     * Returns true if the producer closed the queue because of an error.
+     */
+    bool failed();
+
+    /*
+     * Returns the number of accesses per chunk.
+     */
+    size_t get_chunk_size() const { return chunk_size; }
+
+private:
+    size_t chunk_size;
+    size_t max_chunks;
+    bool is_closed = false;
+    bool is_failed = false;
+
+    std::deque<TraceChunk> filled; // chunks waiting to be simulated
+    std::vector<TraceChunk> spare; // consumed chunks waiting to be refilled
+    std::mutex lock;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+};
+
+/*
+ * Read-only view of a whole file. Regular files are memory-mapped;
+ * anything else (pipes, terminals) is left unmapped so callers can
+ * fall back to reading it in blocks.
+ */
+class MappedFile {
+public:
+    /*
+     * Maps the file open on fd, if it is a regular file.
+     *
+     * Parameters:
+     *  fd - open file descriptor
+     *
+     * Returns:
+     *  a new MappedFile object
+     */
+    explicit MappedFile(int fd);
+
+    /*
+     * Unmaps the file.
+     */
+    ~MappedFile();
+
+    /*
+     * Returns true if the file was mapped (an empty regular file counts as mapped).
+     */
+    bool is_mapped() const { return mapped; }
+
+    /*
+     * Returns the first byte of the mapping.
+     */
+    const char * begin() const { return data; }
+
+    /*
+     * Returns one past the last byte of the mapping.
+     */
+    const char * end() const { return data + length; }
+
+private:
+    const char * data = nullptr;
+    size_t length = 0;
+    bool mapped = false;
+
+    MappedFile(const MappedFile &);
+    MappedFile & operator=(const MappedFile &);
+};
+
+/*
+ * Returns the records of a memory-mapped fixed-width binary trace. Records
+ * with 64-bit addresses are Access objects and can be replayed in place;
+ * 32-bit ones are NarrowAccess objects. Big-endian hosts get none, as
+ * the records must be byte-swapped by the decoder.
+ *
+ * Parameters:
+ *  file - mapped trace file
+ *  n - receives the number of records
+ *  address_bits - receives the width of the trace's addresses
+ *
+ * Returns:
+ *  the first record if file is a supported fixed-width binary trace
+ *  nullptr otherwise (text, varint-encoded, unmapped or malformed input,
+ *  or a big-endian host)
+ */
+const char * fixed_trace_records(const MappedFile & file, size_t & n, int & address_bits);
+
+/*
+ * Decodes trace bytes into accesses and feeds them through a TraceQueue.
+ */
+class TraceDecoder {
+public:
+    /*
+     * Constructs a TraceDecoder object.
+     *
+     * Parameters:
+     *  queue - queue to feed decoded accesses into
+     *
+     * Returns:
+     *  a new TraceDecoder object
+     */
+    explicit TraceDecoder(TraceQueue & queue);
+
+    virtual ~TraceDecoder() {}
+
+    /*
+     * Decodes every complete record in a buffer. Reports the first malformed
+     * record to cerr.
+     *
+     * Parameters:
+     *  p - first byte to decode
+     *  end - one past the last byte to decode
+     *  is_final - true if no more input follows, so a record cut off
+     *             at end is complete (text) or truncated (binary)
+     *
+     * Returns:
+     *  the start of the first record not yet decoded (end once everything was decoded)
+     *  nullptr if a record was malformed
+     */
+    virtual const char * parse(const char * p, const char * end, bool is_final) = 0;
+
+    /*
+     * Pushes any partially filled chunk to the queue.
+     */
+    void flush();
+
+protected:
+    TraceQueue & queue;
+    TraceChunk chunk;
+    size_t chunk_size;
+
+    /*
+     * Appends an access to the current chunk, pushing the chunk when full.
+     */
+    void emit(const Access & access) {
+        chunk.push_back(access);
+        if (chunk.size() == chunk_size) {
+            queue.push(chunk);
+        }
+    }
+};
+
+/*
+ * Decodes text trace lines ("l 0xDEADBEEF 4", with s for stores and
+ * i for instruction fetches, optionally followed by the core number)
+ * in place, without copying or allocating per line.
+ */
+class TextTraceParser : public TraceDecoder {
+public:
+    explicit TextTraceParser(TraceQueue & queue) : TraceDecoder(queue) {}
+
+    /*
+     * Decodes every complete line in a buffer. Reports the first malformed
+     * line (with its line number) to cerr.
+     */
+    const char * parse(const char * p, const char * end, bool is_final);
+
+private:
+    uint64_t line_no = 0;
+};
+
+/*
+ * Decodes the records of a binary trace (after its header).
+ */
+class BinaryTraceDecoder : public TraceDecoder {
+public:
+    /*
+     * Constructs a BinaryTraceDecoder object.
+     *
+     * Parameters:
+     *  queue - queue to feed decoded accesses into
+     *  encoding - TRACE_ENCODING_FIXED or TRACE_ENCODING_VARINT
+     *  address_bits - width of the trace's addresses (32 or 64)
+     *
+     * Returns:
+     *  a new BinaryTraceDecoder object
+     */
+    BinaryTraceDecoder(TraceQueue & queue, int encoding, int address_bits);
+
+    /*
+     * Decodes every complete record in a buffer.
+     */
+    const char * parse(const char * p, const char * end, bool is_final);
+
+private:
+    int encoding;
+    uint64_t address_mask; // bits of an address at the trace's width
+    size_t record_size; // bytes per fixed-width record
+    uint64_t prev_address = 0;
+    uint16_t prev_size = 0;
+    uint8_t prev_core = 0;
+};
+
+/*
+ * Encodes accesses as a binary trace and writes them to a file descriptor.
+ */
+class BinaryTraceWriter {
+public:
+    /*
+     * Constructs a BinaryTraceWriter object and writes the trace header.
+     *
+     * Parameters:
+     *  fd - file descriptor to write to
+     *  encoding - TRACE_ENCODING_FIXED or TRACE_ENCODING_VARINT
+     *  address_bits - width of the trace's addresses (32 or 64)
+     *
+     * Returns:
+     *  a new BinaryTraceWriter object
+     */
+    BinaryTraceWriter(int fd, int encoding, int address_bits);
+
+    /*
+     * Encodes a batch of accesses.
+     *
+     * Parameters:
+     *  accesses - first access to write
+     *  n - number of accesses
+     *
+     * Returns:
+     *  true if successful
+     *  false if writing failed or an address is wider than the trace's
+     *  addresses (reported to cerr)
+     */
+    bool write(const Access * accesses, size_t n);
+
+    /*
+     * Writes out any buffered bytes.
+     *
+     * Returns:
+     *  true if successful
+     *  false if writing failed
+     */
+    bool finish();
+
+private:
+    int fd;
+    int encoding;
+    int address_bits;
+    uint64_t prev_address = 0;
+    uint16_t prev_size = 0;
+    uint8_t prev_core = 0;
+    std::vector<char> buffer;
+};
+
+/*
+ * Reads a text or binary memory trace, possibly compressed, and feeds it
+ * through a TraceQueue. Regular files are memory-mapped and decoded in
+ * place; other inputs are read in large blocks. Compressed traces are
+ * decompressed on threads of their own (see InflatedTrace) and decoded
+ * as they are inflated. Closes the queue when the trace ends.
+ *
+ * Parameters:
+ *  fd - file descriptor to read the trace from
+ *  queue - queue to feed decoded accesses into
+ */
+void read_trace(int fd, TraceQueue & queue);
+
+/*
+ * Replays a trace in batches. A memory-mapped fixed-width binary trace is
+ * handed over in place (or widened in batches if its addresses are 32-bit);
+ * anything else is decoded by a reader thread and streamed through a
+ * bounded TraceQueue.
+ *
+ * Parameters:
+ *  fd - file descriptor to read the trace from
+ *  consume - called with each batch of accesses, in trace order
+ *
+ * Returns:
+ *  true if the whole trace was replayed
+ *  false if the trace could not be read
+ */
+bool replay_trace(int fd, const std::function<void (const Access *, size_t)> & consume);
+
+/*
+ * Converts a trace (text or binary) to a binary trace.
+ *
+ * Parameters:
+ *  in_fd - file descriptor to read the trace from
+ *  out_fd - file descriptor to write the binary trace to
+ *  encoding - TRACE_ENCODING_FIXED or TRACE_ENCODING_VARINT
+ *  address_bits - width of the binary trace's addresses (32 or 64)
+ *
+ * Returns:
+ *  true if successful
+ *  false if the trace could not be read or written
+ */
+bool convert_trace(int in_fd, int out_fd, int encoding, int address_bits);
+
+#endif